@@ -0,0 +1,320 @@
+//
+// => bench/arena_bench.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+// Compares loading, reading and freeing the nodes and keys of loaded models with one heap allocation per array, and with an arena per skeleton and per clip.
+// Synthetic rigs of 64, 256 and 1000 bones with four clips, and the model given on the command line, are first decoded by Model::fromFile(), reporting the
+// time to load and to free them and the heap allocations of a load, which do not include the blocks of the arenas. The allocations of each model are then
+// replayed: a node per skeleton node, and a position, rotation and scale key array per channel, with the average key count of its clip, for ModelCount models.
+// Usage: arena_bench [example directory] [model], the model defaulting to wolf.mdl in the example directory.
+// The meshes are not uploaded, so no OpenGL context is needed.
+
+#include "bench.h"
+#include "synthetic_model.h"
+
+#include <gcore/graphics/model/model.h>
+#include <gcore/graphics/model/animation.h>
+#include <gcore/util/arena.h>
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <new>
+#include <string>
+#include <vector>
+
+using namespace gcore;
+
+namespace {
+    
+    const uint32_t ModelCount = 64;
+    const uint32_t RigBoneCounts[] = { 64, 256, 1000 };
+    const int LoadRepeats = 5;
+    
+    std::atomic<uint64_t> allocationCount(0);
+    
+    struct ClipShape {
+        uint32_t channelCount;
+        uint32_t keysPerChannel;
+    };
+    
+    /*!
+     \brief The arrays allocated for all the models, which are read in the order they were allocated.
+     */
+    struct Allocations {
+        std::vector<SkeletonBone *> nodes;
+        std::vector<VectorKey *> vectorKeys;
+        std::vector<QuaternionKey *> rotationKeys;
+    };
+    
+    /*!
+     \brief Allocates the nodes and keys of \c ModelCount models with \c allocate , which returns uninitialized storage of the given size and alignment.
+     */
+    template <typename Allocate>
+    void allocateModels(uint32_t nodeCount, const std::vector<ClipShape> &clips, Allocations &out, Allocate &&allocate) {
+        for (uint32_t m = 0; m < ModelCount; m++) {
+            for (uint32_t n = 0; n < nodeCount; n++) {
+                out.nodes.push_back((SkeletonBone *)allocate(m, 0, sizeof(SkeletonBone), alignof(SkeletonBone)));
+            }
+            
+            for (size_t c = 0; c < clips.size(); c++) {
+                uint32_t keys = clips[c].keysPerChannel;
+                for (uint32_t i = 0; i < clips[c].channelCount; i++) {
+                    VectorKey *positions = (VectorKey *)allocate(m, c + 1, sizeof(VectorKey) * keys, alignof(VectorKey));
+                    QuaternionKey *rotations = (QuaternionKey *)allocate(m, c + 1, sizeof(QuaternionKey) * keys, alignof(QuaternionKey));
+                    VectorKey *scales = (VectorKey *)allocate(m, c + 1, sizeof(VectorKey) * keys, alignof(VectorKey));
+                    
+                    for (uint32_t k = 0; k < keys; k++) {
+                        positions[k].t = rotations[k].t = scales[k].t = (float)k;
+                    }
+                    out.vectorKeys.push_back(positions);
+                    out.rotationKeys.push_back(rotations);
+                    out.vectorKeys.push_back(scales);
+                }
+            }
+        }
+    }
+    
+    /*!
+     \brief Creates the arenas of \c ModelCount models, each sized exactly as the loader sizes them from the file.
+     */
+    void makeArenas(uint32_t nodeCount, const std::vector<ClipShape> &clips, std::vector<Arena> &arenas) {
+        arenas.clear();
+        arenas.reserve(ModelCount * (clips.size() + 1));
+        for (uint32_t m = 0; m < ModelCount; m++) {
+            arenas.emplace_back(nodeCount * sizeof(SkeletonBone));
+            for (const ClipShape &clip : clips) {
+                arenas.emplace_back((size_t)clip.channelCount * clip.keysPerChannel * (2 * sizeof(VectorKey) + sizeof(QuaternionKey)));
+            }
+        }
+    }
+    
+    void freeHeap(Allocations &allocations) {
+        for (SkeletonBone *node : allocations.nodes) {
+            ::operator delete(node);
+        }
+        for (VectorKey *keys : allocations.vectorKeys) {
+            ::operator delete(keys);
+        }
+        for (QuaternionKey *keys : allocations.rotationKeys) {
+            ::operator delete(keys);
+        }
+    }
+    
+    /*!
+     \brief Reads the time of every key, as a key search does.
+     */
+    float readKeys(const Allocations &allocations, const std::vector<ClipShape> &clips) {
+        float sum = 0.0f;
+        size_t vectorArray = 0, rotationArray = 0;
+        for (uint32_t m = 0; m < ModelCount; m++) {
+            for (const ClipShape &clip : clips) {
+                for (uint32_t i = 0; i < clip.channelCount; i++) {
+                    for (int a = 0; a < 2; a++) {
+                        const VectorKey *keys = allocations.vectorKeys[vectorArray++];
+                        for (uint32_t k = 0; k < clip.keysPerChannel; k++) {
+                            sum += keys[k].t;
+                        }
+                    }
+                    const QuaternionKey *keys = allocations.rotationKeys[rotationArray++];
+                    for (uint32_t k = 0; k < clip.keysPerChannel; k++) {
+                        sum += keys[k].t;
+                    }
+                }
+            }
+        }
+        return sum;
+    }
+    
+    struct LoadResult {
+        double loadTime = 1e30;
+        double freeTime = 1e30;
+        uint64_t allocations = 0;
+        uint32_t nodeCount = 0;
+        std::vector<ClipShape> clips;
+    };
+    
+    /*!
+     \brief Loads the model \c LoadRepeats times with the real loader, keeping the shortest load and free, and the shape of its skeleton and clips.
+     \return \c false if the model could not be loaded.
+     */
+    bool loadModel(const std::string &fileName, LoadResult &result) {
+        ModelLoadOptions options;
+        options.compressAnimations = false;
+        options.lazyAnimations = false;
+        options.uploadMeshes = false;
+        
+        for (int i = 0; i <= LoadRepeats; i++) {
+            uint64_t allocations = allocationCount.load(std::memory_order_relaxed);
+            auto start = std::chrono::steady_clock::now();
+            Model *model = Model::fromFile(fileName.c_str(), options);
+            auto loaded = std::chrono::steady_clock::now();
+            result.allocations = allocationCount.load(std::memory_order_relaxed) - allocations;
+            
+            if (!model || !model->getSkeleton()) {
+                fprintf(stderr, "Could not load an animated model from %s.\n", fileName.c_str());
+                delete model;
+                return false;
+            }
+            
+            if (result.clips.empty()) {
+                result.nodeCount = model->getSkeleton()->getNodesCount();
+                for (uint32_t animID = 0; animID < model->getAnimationCount(); animID++) {
+                    const Animation *animation = model->getAnimation(animID);
+                    if (animation && animation->getKeyChannelsCount()) {
+                        ClipShape clip;
+                        clip.channelCount = animation->getKeyChannelsCount();
+                        clip.keysPerChannel = std::max<uint32_t>(1, (uint32_t)(animation->getMemorySize() / clip.channelCount / (2 * sizeof(VectorKey) + sizeof(QuaternionKey))));
+                        result.clips.push_back(clip);
+                    }
+                }
+            }
+            
+            auto freeStart = std::chrono::steady_clock::now();
+            delete model;
+            auto freed = std::chrono::steady_clock::now();
+            
+            // The first load warms the caches up.
+            if (i > 0) {
+                result.loadTime = std::min(result.loadTime, std::chrono::duration<double>(loaded - start).count());
+                result.freeTime = std::min(result.freeTime, std::chrono::duration<double>(freed - freeStart).count());
+            }
+        }
+        return true;
+    }
+    
+    /*!
+     \brief Times allocating, reading and freeing the nodes and keys of \c ModelCount models of the given shape, with the heap and with arenas.
+     */
+    void benchPattern(const char *rig, uint32_t nodeCount, const std::vector<ClipShape> &clips) {
+        auto heapAllocate = [](uint32_t, size_t, size_t size, size_t) {
+            return ::operator new(size);
+        };
+        std::vector<Arena> arenas;
+        auto arenaAllocate = [&](uint32_t model, size_t arenaIndex, size_t size, size_t alignment) {
+            return arenas[model * (clips.size() + 1) + arenaIndex].allocate(size, alignment);
+        };
+        
+        // Loading and unloading all the models: one allocation per node and per key array freed one by one,
+        // against an arena for the skeleton and for each clip of each model, sized and freed at once as the loader does.
+        double heapCycle = bench::measure([&] {
+            Allocations allocations;
+            allocateModels(nodeCount, clips, allocations, heapAllocate);
+            freeHeap(allocations);
+        });
+        double arenaCycle = bench::measure([&] {
+            makeArenas(nodeCount, clips, arenas);
+            Allocations allocations;
+            allocateModels(nodeCount, clips, allocations, arenaAllocate);
+            arenas.clear();
+        });
+        
+        Allocations heap, arena;
+        allocateModels(nodeCount, clips, heap, heapAllocate);
+        makeArenas(nodeCount, clips, arenas);
+        allocateModels(nodeCount, clips, arena, arenaAllocate);
+        
+        volatile float sink = 0.0f;
+        double heapRead = bench::measure([&] { sink = sink + readKeys(heap, clips); });
+        double arenaRead = bench::measure([&] { sink = sink + readKeys(arena, clips); });
+        freeHeap(heap);
+        
+        printf("%-10s %16.3f %16.3f %12.3f %12.3f\n", rig, heapCycle * 1e3, arenaCycle * 1e3, heapRead * 1e3, arenaRead * 1e3);
+    }
+    
+}
+
+// Allocations of the process, counted to report those of a load.
+void *operator new(size_t size) {
+    allocationCount.fetch_add(1, std::memory_order_relaxed);
+    if (void *p = malloc(size ? size : 1)) {
+        return p;
+    }
+    throw std::bad_alloc();
+}
+
+void operator delete(void *p) noexcept {
+    free(p);
+}
+
+int main(int argc, const char *argv[]) {
+    struct Rig {
+        std::string name;
+        std::string fileName;
+        bool generated;
+        LoadResult result;
+    };
+    std::vector<Rig> rigs;
+    
+    for (uint32_t boneCount : RigBoneCounts) {
+        bench::SyntheticModel synthetic;
+        synthetic.boneCount = boneCount;
+        synthetic.vertexCount = 3;
+        synthetic.animationCount = 4;
+        
+        std::string name = "synth" + std::to_string(boneCount);
+        std::string fileName = "synthetic_" + std::to_string(boneCount) + ".mdl";
+        if (!bench::writeSyntheticModel(fileName, synthetic)) {
+            fprintf(stderr, "Could not write %s.\n", fileName.c_str());
+            return 1;
+        }
+        rigs.push_back({ name, fileName, true, LoadResult() });
+    }
+    std::string fileName = argc > 2 ? argv[2] : bench::exampleFile(argc, argv, "wolf.mdl");
+    rigs.push_back({ fileName.substr(fileName.find_last_of('/') + 1), fileName, false, LoadResult() });
+    
+    int status = 0;
+    printf("Loading with Model::fromFile(), arenas for the skeleton and each clip:\n");
+    printf("%-10s %6s %6s %9s %10s %10s %12s\n", "rig", "nodes", "clips", "channels", "load ms", "free ms", "allocations");
+    for (Rig &rig : rigs) {
+        if (!loadModel(rig.fileName, rig.result)) {
+            status = 1;
+            continue;
+        }
+        
+        uint32_t channelCount = 0;
+        for (const ClipShape &clip : rig.result.clips) {
+            channelCount += clip.channelCount;
+        }
+        printf("%-10s %6u %6zu %9u %10.3f %10.3f %12llu\n", rig.name.c_str(), rig.result.nodeCount, rig.result.clips.size(), channelCount,
+               rig.result.loadTime * 1e3, rig.result.freeTime * 1e3, (unsigned long long)rig.result.allocations);
+    }
+    
+    printf("\nThe same nodes and keys for %u models, with a heap allocation per array and with an arena per skeleton and per clip:\n", ModelCount);
+    printf("%-10s %16s %16s %12s %12s\n", "rig", "heap load+free", "arena load+free", "heap read", "arena read");
+    for (const Rig &rig : rigs) {
+        if (!rig.result.clips.empty()) {
+            benchPattern(rig.name.c_str(), rig.result.nodeCount, rig.result.clips);
+        }
+    }
+    
+    for (const Rig &rig : rigs) {
+        if (rig.generated) {
+            remove(rig.fileName.c_str());
+        }
+    }
+    return status;
+}
@@ -0,0 +1,107 @@
+//
+// => bench/bench.h
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef __graphcore_bench
+#define __graphcore_bench
+
+#include <gcore/window/window.h>
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <string>
+
+namespace bench {
+    
+    /*!
+     \brief Calls \c fn once to warm the caches up, then \c repeats times, and returns the shortest of the calls in seconds.
+     */
+    template <typename F>
+    double measure(F &&fn, int repeats = 5) {
+        fn();
+        
+        double best = 1e30;
+        for (int i = 0; i < repeats; i++) {
+            auto start = std::chrono::steady_clock::now();
+            fn();
+            best = std::min(best, std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count());
+        }
+        return best;
+    }
+    
+    /*!
+     \brief Returns the file of the example directory with the given name, the directory being the first argument of the bench or \c ../example .
+     */
+    inline std::string exampleFile(int argc, const char *argv[], const char *name) {
+        return std::string(argc > 1 ? argv[1] : "../example") + "/" + name;
+    }
+    
+    /*!
+     \brief A hidden window whose OpenGL context is current, as needed to upload meshes and run shaders. Models loaded without \c ModelLoadOptions::uploadMeshes need none.
+     */
+    class Context {
+        gcore::Window *window = nullptr;
+        bool ready = false;
+        
+    public:
+        Context() {
+            if (!glfwInit()) {
+                fprintf(stderr, "Could not initialize glfw.\n");
+                return;
+            }
+            
+            glfwWindowHint(GLFW_VISIBLE, GLFW_FALSE);
+            window = new gcore::Window("bench", 64, 64);
+            if (!window->make()) {
+                fprintf(stderr, "Could not create glfw window.\n");
+                return;
+            }
+            window->takeWindowContext();
+            
+            glewExperimental = true;
+            if (glewInit() != GLEW_OK) {
+                fprintf(stderr, "Could not initialize glew.\n");
+                return;
+            }
+            ready = true;
+        }
+        
+        ~Context() {
+            delete window;
+            glfwTerminate();
+        }
+        
+        Context(const Context &) = delete;
+        Context &operator=(const Context &) = delete;
+        
+        inline bool isReady() const {
+            return ready;
+        }
+    };
+    
+}
+
+#endif
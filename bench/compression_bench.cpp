@@ -0,0 +1,137 @@
+//
+// => bench/compression_bench.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+// Compares sampling the animations of a model from raw keys and from compressed tracks: key memory, sampling time and the error of the poses.
+// Usage: compression_bench [example directory] [model], the model defaulting to wolf.mdl in the example directory.
+// The meshes are not uploaded, so no OpenGL context is needed.
+
+#include "bench.h"
+
+#include <gcore/graphics/model/model.h>
+#include <gcore/graphics/model/animation.h>
+
+#include <cmath>
+#include <vector>
+
+using namespace gcore;
+
+namespace {
+    
+    const int SampleCount = 1000;
+    
+    Model *loadModel(const std::string &fileName, bool compress) {
+        ModelLoadOptions options;
+        options.compressAnimations = compress;
+        options.lazyAnimations = false;
+        options.uploadMeshes = false;
+        return Model::fromFile(fileName.c_str(), options);
+    }
+    
+    /*!
+     \brief Samples the whole animation at \c SampleCount evenly spaced times, playing it forward as an instance does.
+     */
+    void sampleAll(const Animation &animation, std::vector<KeyFrame> &cursors, Pose &pose) {
+        for (int s = 0; s < SampleCount; s++) {
+            pose.clear();
+            animation.sample(animation.getTotalDuration() * s / SampleCount, cursors.data(), pose);
+        }
+    }
+    
+    /*!
+     \brief Returns the largest difference between the components of the animated nodes of two poses, rotations being compared up to their sign.
+     */
+    float poseError(const Pose &a, const Pose &b) {
+        float error = 0.0f;
+        for (uint32_t node = 0; node < a.getCount(); node++) {
+            if (!a.isAnimated(node)) {
+                continue;
+            }
+            
+            float rotationSign = 0.0f;
+            for (uint32_t c = Pose::RotationX; c <= Pose::RotationW; c++) {
+                rotationSign += a.getComponent(c)[node] * b.getComponent(c)[node];
+            }
+            
+            for (uint32_t c = 0; c < Pose::ComponentCount; c++) {
+                float value = b.getComponent(c)[node];
+                if (c >= Pose::RotationX && c <= Pose::RotationW && rotationSign < 0.0f) {
+                    value = -value;
+                }
+                error = std::max(error, std::fabs(a.getComponent(c)[node] - value));
+            }
+        }
+        return error;
+    }
+    
+}
+
+int main(int argc, const char *argv[]) {
+    std::string fileName = argc > 2 ? argv[2] : bench::exampleFile(argc, argv, "wolf.mdl");
+    Model *raw = loadModel(fileName, false);
+    Model *compressed = loadModel(fileName, true);
+    if (!raw || !compressed || !raw->getSkeleton()) {
+        fprintf(stderr, "Could not load an animated model from %s.\n", fileName.c_str());
+        return 1;
+    }
+    
+    uint32_t nodeCount = raw->getSkeleton()->getNodesCount();
+    printf("%s, %u nodes\n", fileName.c_str(), nodeCount);
+    printf("%-6s %9s %12s %12s %10s %10s %10s\n", "anim", "channels", "raw bytes", "comp bytes", "raw ns", "comp ns", "max error");
+    
+    for (uint32_t animID = 0; animID < raw->getAnimationCount(); animID++) {
+        Animation *rawAnimation = raw->getAnimation(animID);
+        Animation *compressedAnimation = compressed->getAnimation(animID);
+        if (!rawAnimation || !compressedAnimation) {
+            continue;
+        }
+        
+        uint32_t channelCount = rawAnimation->getKeyChannelsCount();
+        std::vector<KeyFrame> rawCursors(channelCount), compressedCursors(channelCount);
+        Pose rawPose(nodeCount), compressedPose(nodeCount);
+        
+        double rawTime = bench::measure([&] { sampleAll(*rawAnimation, rawCursors, rawPose); });
+        double compressedTime = bench::measure([&] { sampleAll(*compressedAnimation, compressedCursors, compressedPose); });
+        
+        float error = 0.0f;
+        for (int s = 0; s <= SampleCount; s++) {
+            double t = rawAnimation->getTotalDuration() * s / SampleCount;
+            rawPose.clear();
+            compressedPose.clear();
+            rawAnimation->sample(t, rawCursors.data(), rawPose);
+            compressedAnimation->sample(t, compressedCursors.data(), compressedPose);
+            error = std::max(error, poseError(rawPose, compressedPose));
+        }
+        
+        // Times are per channel and per sample.
+        double scale = 1e9 / SampleCount / std::max(channelCount, 1u);
+        printf("%-6u %9u %12zu %12zu %10.1f %10.1f %10.2e\n", animID, channelCount, rawAnimation->getMemorySize(), compressedAnimation->getMemorySize(),
+               rawTime * scale, compressedTime * scale, error);
+    }
+    
+    delete raw;
+    delete compressed;
+    return 0;
+}
@@ -0,0 +1,181 @@
+//
+// => bench/pose_sampling_bench.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+// Compares sampling the animations of a model into a pose channel by channel, with KeyFrameChannel::sampleTransform() and Pose::setTransform(),
+// and with Animation::sample(), which interpolates baked frames in batches with SIMD and raw keys channel by channel. The rigs are synthetic
+// skeletons of 64, 256 and 1024 bones, and the model given on the command line, and the times are per bone of the rig and per sample.
+// FDMD stores the bone of each channel in a byte, so the 1024 bone rig animates its first 256 bones and the others keep their bind pose.
+// Usage: pose_sampling_bench [example directory] [model], the model defaulting to wolf.mdl in the example directory.
+// The meshes are not uploaded, so no OpenGL context is needed.
+
+#include "bench.h"
+#include "synthetic_model.h"
+
+#include <gcore/graphics/model/model.h>
+#include <gcore/graphics/model/animation.h>
+#include <gcore/math/simd_lanes.h>
+
+#include <cmath>
+#include <cstdio>
+#include <vector>
+
+using namespace gcore;
+
+namespace {
+    
+    const int SampleCount = 1000;
+    const float BakedFrameRate = 30.0f;
+    const uint32_t RigBoneCounts[] = { 64, 256, 1024 };
+    
+    void sampleChannels(const Animation &animation, double t, std::vector<KeyFrame> &cursors, Pose &pose) {
+        glm::vec3 position, scale;
+        glm::quat rotation;
+        
+        for (uint32_t i = 0; i < animation.getKeyChannelsCount(); i++) {
+            const KeyFrameChannel &channel = animation.getKeyChannel(i);
+            if (channel.sampleTransform(t, cursors[i], position, rotation, scale)) {
+                pose.setTransform(channel.getAffectedBone().getBoneID(), position, rotation, scale);
+            }
+        }
+    }
+    
+    float poseError(const Pose &a, const Pose &b) {
+        float error = 0.0f;
+        for (uint32_t node = 0; node < a.getCount(); node++) {
+            if (a.isAnimated(node) != b.isAnimated(node)) {
+                return INFINITY;
+            }
+            if (!a.isAnimated(node)) {
+                continue;
+            }
+            for (uint32_t c = 0; c < Pose::ComponentCount; c++) {
+                error = std::max(error, std::fabs(a.getComponent(c)[node] - b.getComponent(c)[node]));
+            }
+        }
+        return error;
+    }
+    
+    /*!
+     \brief Prints a row for each animation of the model, raw and baked at \c BakedFrameRate .
+     \return \c false if the model could not be loaded.
+     */
+    bool benchModel(const char *rig, const std::string &fileName) {
+        ModelLoadOptions options;
+        options.compressAnimations = false;
+        options.lazyAnimations = false;
+        options.uploadMeshes = false;
+        Model *model = Model::fromFile(fileName.c_str(), options);
+        
+        // Baked clips take their keys from two frames, so sampling them is all interpolation.
+        options.animationFrameRate = BakedFrameRate;
+        Model *baked = Model::fromFile(fileName.c_str(), options);
+        
+        if (!model || !baked || !model->getSkeleton()) {
+            fprintf(stderr, "Could not load an animated model from %s.\n", fileName.c_str());
+            delete model;
+            delete baked;
+            return false;
+        }
+        
+        uint32_t nodeCount = model->getSkeleton()->getNodesCount();
+        for (uint32_t animID = 0; animID < model->getAnimationCount(); animID++) {
+            const Animation *animations[2] = { model->getAnimation(animID), baked->getAnimation(animID) };
+            
+            for (const Animation *animation : animations) {
+                if (!animation || !animation->getKeyChannelsCount()) {
+                    continue;
+                }
+                
+                uint32_t channelCount = animation->getKeyChannelsCount();
+                std::vector<KeyFrame> scalarCursors(channelCount), batchCursors(channelCount);
+                Pose scalarPose(nodeCount), batchPose(nodeCount);
+                
+                double scalarTime = bench::measure([&] {
+                    for (int s = 0; s < SampleCount; s++) {
+                        scalarPose.clear();
+                        sampleChannels(*animation, animation->getTotalDuration() * s / SampleCount, scalarCursors, scalarPose);
+                    }
+                });
+                double batchTime = bench::measure([&] {
+                    for (int s = 0; s < SampleCount; s++) {
+                        batchPose.clear();
+                        animation->sample(animation->getTotalDuration() * s / SampleCount, batchCursors.data(), batchPose);
+                    }
+                });
+                
+                float error = 0.0f;
+                for (int s = 0; s <= SampleCount; s++) {
+                    double t = animation->getTotalDuration() * s / SampleCount;
+                    scalarPose.clear();
+                    batchPose.clear();
+                    sampleChannels(*animation, t, scalarCursors, scalarPose);
+                    animation->sample(t, batchCursors.data(), batchPose);
+                    error = std::max(error, poseError(scalarPose, batchPose));
+                }
+                
+                double scale = 1e9 / SampleCount / nodeCount;
+                printf("%-10s %6u %9u %5u %-6s %12.2f %12.2f %10.2e\n", rig, nodeCount, channelCount, animID, animation->isBaked() ? "baked" : "raw",
+                       scalarTime * scale, batchTime * scale, error);
+            }
+        }
+        
+        delete model;
+        delete baked;
+        return true;
+    }
+    
+}
+
+int main(int argc, const char *argv[]) {
+    printf("%d lanes, %d samples per row\n", GCORE_LANE_COUNT, SampleCount);
+    printf("%-10s %6s %9s %5s %-6s %12s %12s %10s\n", "rig", "bones", "channels", "anim", "keys", "scalar ns/b", "sample ns/b", "max error");
+    
+    int status = 0;
+    const std::string syntheticFile = "synthetic_rig.mdl";
+    for (uint32_t boneCount : RigBoneCounts) {
+        bench::SyntheticModel synthetic;
+        synthetic.boneCount = boneCount;
+        synthetic.vertexCount = 3;
+        synthetic.animationCount = 1;
+        if (!bench::writeSyntheticModel(syntheticFile, synthetic)) {
+            fprintf(stderr, "Could not write %s.\n", syntheticFile.c_str());
+            return 1;
+        }
+        
+        char rig[32];
+        snprintf(rig, sizeof(rig), "synth%u", boneCount);
+        if (!benchModel(rig, syntheticFile)) {
+            status = 1;
+        }
+    }
+    remove(syntheticFile.c_str());
+    
+    std::string fileName = argc > 2 ? argv[2] : bench::exampleFile(argc, argv, "wolf.mdl");
+    if (!benchModel(fileName.substr(fileName.find_last_of('/') + 1).c_str(), fileName)) {
+        status = 1;
+    }
+    return status;
+}
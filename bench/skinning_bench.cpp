@@ -0,0 +1,190 @@
+//
+// => bench/skinning_bench.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+// Compares skinning the meshes of a model on the CPU, with the scalar reference and with skinVertices() on one and on all the threads,
+// and on the GPU, with the vertex stage of skeleton.vsh reading the palettes from a stream buffer. The GPU time is measured with a timer
+// query around InstanceCount draws with rasterization disabled, so that only the vertex stage runs. The model is loaded without uploading its
+// meshes, so the CPU rows need no OpenGL context; the GPU row is skipped when none can be created.
+// Usage: skinning_bench [example directory] [model], the model defaulting to wolf.mdl in the example directory.
+
+#include "bench.h"
+
+#include <gcore/graphics/model/cpu_skinning.h>
+#include <gcore/graphics/model/model.h>
+#include <gcore/graphics/model/model_instance.h>
+#include <gcore/graphics/shaders/shaders.h>
+#include <gcore/util/thread_pool.h>
+
+#include <thread>
+#include <vector>
+
+using namespace gcore;
+
+namespace {
+    
+    const uint32_t InstanceCount = 256;
+    
+    /*!
+     \brief The time of the GPU commands issued by \c fn , in seconds.
+     */
+    template <typename F>
+    double gpuTime(F &&fn) {
+        GLuint query;
+        glGenQueries(1, &query);
+        glBeginQuery(GL_TIME_ELAPSED, query);
+        fn();
+        glEndQuery(GL_TIME_ELAPSED);
+        
+        GLuint64 nanoseconds = 0;
+        glGetQueryObjectui64v(query, GL_QUERY_RESULT, &nanoseconds);
+        glDeleteQueries(1, &query);
+        return nanoseconds * 1e-9;
+    }
+    
+}
+
+int main(int argc, const char *argv[]) {
+    std::string fileName = argc > 2 ? argv[2] : bench::exampleFile(argc, argv, "wolf.mdl");
+    ModelLoadOptions options;
+    options.keepMeshData = true;
+    options.lazyAnimations = false;
+    options.uploadMeshes = false;
+    Model *model = Model::fromFile(fileName.c_str(), options);
+    if (!model || !model->getSkeleton()) {
+        fprintf(stderr, "Could not load an animated model from %s.\n", fileName.c_str());
+        return 1;
+    }
+    
+    ModelInstance instance(*model);
+    instance.update(0.5);
+    
+    // The CPU takes the same palette as the GPU, as affine transforms.
+    uint32_t jointCount = model->getSkeleton()->getBonesCount();
+    std::vector<Affine3x4> joints(jointCount);
+    for (uint32_t j = 0; j < jointCount; j++) {
+        affineFromMat4(instance.getJoints()[j], joints[j]);
+    }
+    
+    std::vector<SkinningSource> sources;
+    size_t vertexCount = 0;
+    for (uint32_t mesh = 0; mesh < model->getMeshCount(); mesh++) {
+        if (const MeshData *meshData = model->getMeshData(mesh)) {
+            sources.push_back(SkinningSource::fromMeshData(*meshData, jointCount, model->getMeshQuantization(mesh)));
+            vertexCount += meshData->getVertexCount();
+        }
+    }
+    // Every instance has its own output, as if its vertices were uploaded for drawing.
+    std::vector<float> positions(InstanceCount * vertexCount * 3), normals(InstanceCount * vertexCount * 3);
+    
+    ThreadPool pool(std::max(std::thread::hardware_concurrency(), 1u));
+    auto skinInstance = [&](uint32_t i, bool reference, ThreadPool *threads) {
+        size_t first = i * vertexCount;
+        for (const SkinningSource &source : sources) {
+            if (reference) {
+                skinVerticesReference(source, joints.data(), 0, source.vertexCount, positions.data() + first * 3, normals.data() + first * 3);
+            } else {
+                skinVertices(source, joints.data(), positions.data() + first * 3, normals.data() + first * 3, threads);
+            }
+            first += source.vertexCount;
+        }
+    };
+    
+    printf("%s, %zu vertices, %u joints, %u instances, %u threads\n", fileName.c_str(), vertexCount, jointCount, InstanceCount, pool.getThreadCount());
+    printf("%-36s %12s %14s\n", "", "ms/frame", "Mvertices/s");
+    
+    auto report = [&](const char *name, double secondsPerFrame) {
+        printf("%-36s %12.3f %14.1f\n", name, secondsPerFrame * 1e3, InstanceCount * vertexCount / secondsPerFrame / 1e6);
+    };
+    report("cpu reference", bench::measure([&] {
+        for (uint32_t i = 0; i < InstanceCount; i++) {
+            skinInstance(i, true, nullptr);
+        }
+    }));
+    report("cpu simd, 1 thread", bench::measure([&] {
+        for (uint32_t i = 0; i < InstanceCount; i++) {
+            skinInstance(i, false, nullptr);
+        }
+    }));
+    report("cpu simd, chunks across threads", bench::measure([&] {
+        for (uint32_t i = 0; i < InstanceCount; i++) {
+            skinInstance(i, false, &pool);
+        }
+    }));
+    report("cpu simd, instances across threads", bench::measure([&] {
+        pool.parallelFor(InstanceCount, [&](size_t i) { skinInstance((uint32_t)i, false, nullptr); });
+    }));
+    
+    bench::Context context;
+    if (!context.isReady()) {
+        printf("%-36s %12s\n", "gpu vertex stage", "skipped, no OpenGL context");
+        delete model;
+        return 0;
+    }
+    model->uploadMeshes();
+    
+    ShaderProgram *program = ShaderProgram::fromSources(bench::exampleFile(argc, argv, "skeleton.vsh").c_str(), bench::exampleFile(argc, argv, "shader.fsh").c_str());
+    if (!program) {
+        fprintf(stderr, "Could not build the skinning shader.\n");
+        delete model;
+        return 1;
+    }
+    program->addUniform("boneJoints");
+    program->addUniform("paletteOffset");
+    program->addUniform("positionDequantization");
+    
+    StreamBuffer palettes(GL_TEXTURE_BUFFER, jointCount * sizeof(glm::mat4) + 4096, 3, GL_RGBA32F);
+    program->use();
+    glUniform1i(program->getUniform(0), 1);
+    glEnable(GL_RASTERIZER_DISCARD);
+    
+    auto drawAll = [&] {
+        // All the draws read the same palette: the vertex stage does the same work as with a palette per instance.
+        palettes.beginFrame();
+        instance.streamJoints(palettes);
+        palettes.flush();
+        palettes.bindTexture(GL_TEXTURE1);
+        
+        double seconds = gpuTime([&] {
+            for (uint32_t i = 0; i < InstanceCount; i++) {
+                instance.draw(palettes, program->getUniform(1), program->getUniform(2));
+            }
+        });
+        palettes.endFrame();
+        return seconds;
+    };
+    
+    drawAll();
+    double gpuSeconds = 1e30;
+    for (int i = 0; i < 5; i++) {
+        gpuSeconds = std::min(gpuSeconds, drawAll());
+    }
+    report("gpu vertex stage", gpuSeconds);
+    
+    glDisable(GL_RASTERIZER_DISCARD);
+    delete program;
+    delete model;
+    return 0;
+}
@@ -0,0 +1,138 @@
+//
+// => bench/stream_bench.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+// Compares the modes of BinaryInputStream on the whole load path: Model::fromFile() reading and decoding example/wolf.mdl,
+// and large synthetic models in the v1 layout (big endian records) and in the v2 layout (vertex data ready to be uploaded).
+// Usage: stream_bench [example directory] [size of the synthetic models in MB, 128 by default]
+// The meshes are not uploaded, so no OpenGL context is needed and the numbers are those of reading and decoding alone.
+// Each file is loaded once before timing, so the numbers are those of a file in the page cache.
+
+#include "bench.h"
+#include "synthetic_model.h"
+
+#include <gcore/graphics/model/model.h>
+#include <gcore/io/bin_istream.h>
+
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <vector>
+
+using namespace gcore;
+
+namespace {
+    
+    /*!
+     \brief The bytes of each vertex of a synthetic mesh in the v1 layout: position, normal, texture coordinates, bone IDs, weights and index.
+     */
+    const uint64_t SyntheticVertexSize = (3 + 3 + 2 + 4 + 4 + 1) * 4;
+    
+    uint64_t fileSize(const std::string &fileName) {
+        FILE *fp = fopen(fileName.c_str(), "rb");
+        if (!fp) {
+            return 0;
+        }
+        fseek(fp, 0, SEEK_END);
+        uint64_t size = (uint64_t)ftell(fp);
+        fclose(fp);
+        return size;
+    }
+    
+}
+
+int main(int argc, const char *argv[]) {
+    double syntheticMB = argc > 2 ? atof(argv[2]) : 128.0;
+    
+    bench::SyntheticModel synthetic;
+    synthetic.meshCount = 4;
+    synthetic.vertexCount = (uint32_t)(syntheticMB * 1e6 / SyntheticVertexSize / synthetic.meshCount);
+    synthetic.boneCount = 64;
+    synthetic.animationCount = 4;
+    
+    struct File {
+        std::string name;
+        bool generated;
+    };
+    std::vector<File> files = { { bench::exampleFile(argc, argv, "wolf.mdl"), false } };
+    
+    for (bool v2 : { false, true }) {
+        synthetic.v2 = v2;
+        std::string name = v2 ? "synthetic_v2.mdl" : "synthetic_v1.mdl";
+        if (!bench::writeSyntheticModel(name, synthetic)) {
+            fprintf(stderr, "Could not write %s.\n", name.c_str());
+            return 1;
+        }
+        files.push_back({ name, true });
+    }
+    
+    const struct {
+        const char *name;
+        BinaryInputStreamMode mode;
+    } modes[] = {
+        { "buffered", BinaryInputStreamBuffered },
+        { "mapped", BinaryInputStreamMapped },
+        { "prefetched", BinaryInputStreamPrefetched }
+    };
+    
+    ModelLoadOptions options;
+    options.uploadMeshes = false;
+    
+    printf("%-20s %8s", "file", "MB");
+    for (const auto &m : modes) {
+        printf(" %10s ms %7s", m.name, "MB/s");
+    }
+    printf("\n");
+    
+    int status = 0;
+    for (const File &file : files) {
+        uint64_t size = fileSize(file.name);
+        printf("%-20s %8.1f", file.name.substr(file.name.find_last_of('/') + 1).c_str(), size / 1e6);
+        
+        for (const auto &m : modes) {
+            bool loaded = true;
+            double time = bench::measure([&] {
+                Model *model = Model::fromFile(file.name.c_str(), BinaryInputStreamOptions(m.mode), options);
+                loaded = loaded && model;
+                delete model;
+            }, file.generated ? 3 : 5);
+            
+            if (!loaded) {
+                printf(" %13s %7s", "failed", "-");
+                status = 1;
+                continue;
+            }
+            printf(" %13.2f %7.0f", time * 1e3, size / time / 1e6);
+        }
+        printf("\n");
+    }
+    
+    for (const File &file : files) {
+        if (file.generated) {
+            remove(file.name.c_str());
+        }
+    }
+    return status;
+}
@@ -0,0 +1,396 @@
+//
+// => bench/synthetic_model.h
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef __graphcore_bench_synthetic_model
+#define __graphcore_bench_synthetic_model
+
+#include <gcore/graphics/model/animation.h>
+#include <gcore/graphics/model/fdmd_loader.h>
+#include <gcore/io/bin_ostream.h>
+#include <gcore/io/byte_order.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+#include <functional>
+#include <string>
+#include <vector>
+
+namespace bench {
+    
+    /*!
+     \brief The contents of a generated model file: meshes with random vertices skinned to a skeleton whose nodes are all bones, and animations keying every bone they can.
+     \note FDMD stores the bone of each animation channel in a byte, so animations key at most the first 256 bones.
+     */
+    struct SyntheticModel {
+        uint32_t meshCount = 1;
+        /*!
+         \brief The number of vertices of each mesh, each one in a triangle of its own.
+         */
+        uint32_t vertexCount = 0;
+        /*!
+         \brief The number of bones, laid out as a tree with four children per node, or 0 for a static model.
+         */
+        uint32_t boneCount = 0;
+        uint32_t animationCount = 0;
+        /*!
+         \brief The number of position, rotation and scale keys of each channel, at most 255.
+         */
+        uint32_t keyCount = 30;
+        /*!
+         \brief Whether the file is written in the v2 layout, with vertex data ready to be uploaded, rather than as a v1 stream of big endian records.
+         */
+        bool v2 = false;
+        
+        /*!
+         \brief Returns the number of channels of each animation.
+         */
+        inline uint32_t channelCount() const {
+            return std::min<uint32_t>(boneCount, 256);
+        }
+    };
+    
+    namespace synthetic {
+        
+        /*!
+         \brief A small deterministic generator, so that files with the same contents are generated on every run.
+         */
+        class Random {
+            uint32_t state;
+            
+        public:
+            explicit Random(uint32_t seed) : state(seed * 2654435761u + 1) {  }
+            
+            /*!
+             \brief Returns a number in [-1, 1].
+             */
+            inline float next() {
+                state = state * 1664525u + 1013904223u;
+                return (state >> 8) / 8388608.0f - 1.0f;
+            }
+        };
+        
+        /*!
+         \brief The vertex data of a mesh, laid out as the FDMD records store it.
+         */
+        struct Mesh {
+            std::vector<float> positions, normals, texCoords, weights;
+            std::vector<uint32_t> boneIDs, indices;
+            
+            Mesh(const SyntheticModel &model, uint32_t meshID) {
+                Random random(meshID);
+                uint32_t vertexCount = model.vertexCount;
+                
+                positions.resize((size_t)vertexCount * 3);
+                normals.resize((size_t)vertexCount * 3);
+                texCoords.resize((size_t)vertexCount * 2);
+                for (float &x : positions) {
+                    x = random.next();
+                }
+                for (uint32_t v = 0; v < vertexCount; v++) {
+                    normals[v * 3 + 1] = 1.0f;
+                    texCoords[v * 2] = random.next() * 0.5f + 0.5f;
+                    texCoords[v * 2 + 1] = random.next() * 0.5f + 0.5f;
+                }
+                
+                if (model.boneCount) {
+                    boneIDs.resize((size_t)vertexCount * MAX_WEIGHTS_PER_VERTEX);
+                    weights.resize((size_t)vertexCount * MAX_WEIGHTS_PER_VERTEX);
+                    for (size_t i = 0; i < boneIDs.size(); i++) {
+                        boneIDs[i] = (uint32_t)((random.next() * 0.5f + 0.5f) * (model.boneCount - 1));
+                        weights[i] = 1.0f / MAX_WEIGHTS_PER_VERTEX;
+                    }
+                }
+                
+                indices.resize(vertexCount / 3 * 3);
+                for (uint32_t i = 0; i < indices.size(); i++) {
+                    indices[i] = i;
+                }
+            }
+            
+            inline bool shortIndices() const {
+                return indices.size() <= UINT16_MAX;
+            }
+        };
+        
+        inline glm::mat4 translation(float x, float y, float z) {
+            glm::mat4 m(1.0f);
+            m[3] = glm::vec4(x, y, z, 1.0f);
+            return m;
+        }
+        
+        /*!
+         \brief Writes the node \c node of the skeleton and its children, the children of node \c i being the nodes \c 4i+1 to \c 4i+4 .
+         */
+        inline void writeNode(gcore::BinaryOutputStream &os, uint32_t node, uint32_t nodeCount, uint32_t depth) {
+            os.writeByte(gcore::FDMDSkeletonNodeBone);
+            os.writeInt32(node);
+            os.writeMat4(translation(0.0f, 0.1f, 0.0f));
+            os.writeMat4(translation(0.0f, -0.1f * (depth + 1), 0.0f));
+            
+            uint32_t first = node * 4 + 1;
+            uint32_t childrenCount = first < nodeCount ? std::min<uint32_t>(4, nodeCount - first) : 0;
+            os.writeInt32(childrenCount);
+            for (uint32_t i = 0; i < childrenCount; i++) {
+                writeNode(os, first + i, nodeCount, depth + 1);
+            }
+        }
+        
+        inline uint64_t skeletonSize(const SyntheticModel &model) {
+            return 8 + 64 + (uint64_t)model.boneCount * (1 + 4 + 64 + 64 + 4);
+        }
+        
+        inline void writeSkeleton(gcore::BinaryOutputStream &os, const SyntheticModel &model) {
+            os.writeInt32(model.boneCount);
+            os.writeInt32(model.boneCount);
+            os.writeMat4(glm::mat4(1.0f));
+            writeNode(os, 0, model.boneCount, 0);
+        }
+        
+        inline uint64_t animationSize(const SyntheticModel &model) {
+            return 1 + 4 + 4 + 1 + (uint64_t)model.channelCount() * (6 + model.keyCount * (16 + 20 + 16));
+        }
+        
+        inline void writeAnimation(gcore::BinaryOutputStream &os, const SyntheticModel &model, uint32_t animID) {
+            const float duration = 2.0f;
+            Random random(animID + 1000);
+            
+            os.writeByte((uint8_t)animID);
+            os.writeFloat(duration);
+            os.writeInt32(model.channelCount());
+            os.writeByte(0); // skeletal animation
+            
+            for (uint32_t channel = 0; channel < model.channelCount(); channel++) {
+                os.writeByte((uint8_t)channel);
+                os.writeByte(gcore::AnimationBehaviourConstant);
+                os.writeByte(gcore::AnimationBehaviourConstant);
+                
+                os.writeByte((uint8_t)model.keyCount);
+                for (uint32_t k = 0; k < model.keyCount; k++) {
+                    os.writeFloat(duration * k / std::max<uint32_t>(model.keyCount - 1, 1));
+                    os.writeFloat(random.next() * 0.1f);
+                    os.writeFloat(0.1f + random.next() * 0.1f);
+                    os.writeFloat(random.next() * 0.1f);
+                }
+                
+                os.writeByte((uint8_t)model.keyCount);
+                for (uint32_t k = 0; k < model.keyCount; k++) {
+                    float wxyz[4] = { 1.0f, random.next() * 0.3f, random.next() * 0.3f, random.next() * 0.3f };
+                    float norm = std::sqrt(wxyz[0] * wxyz[0] + wxyz[1] * wxyz[1] + wxyz[2] * wxyz[2] + wxyz[3] * wxyz[3]);
+                    os.writeFloat(duration * k / std::max<uint32_t>(model.keyCount - 1, 1));
+                    for (float x : wxyz) {
+                        os.writeFloat(x / norm);
+                    }
+                }
+                
+                os.writeByte((uint8_t)model.keyCount);
+                for (uint32_t k = 0; k < model.keyCount; k++) {
+                    os.writeFloat(duration * k / std::max<uint32_t>(model.keyCount - 1, 1));
+                    os.writeFloat(1.0f + random.next() * 0.05f);
+                    os.writeFloat(1.0f + random.next() * 0.05f);
+                    os.writeFloat(1.0f + random.next() * 0.05f);
+                }
+            }
+        }
+        
+        inline void writeMeshV1(gcore::BinaryOutputStream &os, const Mesh &mesh, uint32_t meshID, uint32_t vertexCount) {
+            os.writeByte(gcore::FDMDModelAttribMesh);
+            os.writeByte((uint8_t)meshID);
+            os.writeInt32(vertexCount);
+            
+            os.writeByte(gcore::FDMDModelVertexAttribPosition);
+            os.writeFloatArray(mesh.positions.data(), mesh.positions.size());
+            os.writeByte(gcore::FDMDModelVertexAttribNormal);
+            os.writeFloatArray(mesh.normals.data(), mesh.normals.size());
+            os.writeByte(gcore::FDMDModelVertexAttribTexCoord2);
+            os.writeByte(0); // texture index
+            os.writeFloatArray(mesh.texCoords.data(), mesh.texCoords.size());
+            
+            if (!mesh.boneIDs.empty()) {
+                os.writeByte(gcore::FDMDModelVertexAttribBoneID);
+                os.writeByte(MAX_WEIGHTS_PER_VERTEX);
+                os.writeInt32Array(mesh.boneIDs.data(), mesh.boneIDs.size());
+                os.writeByte(gcore::FDMDModelVertexAttribBoneWeight);
+                os.writeByte(MAX_WEIGHTS_PER_VERTEX);
+                os.writeFloatArray(mesh.weights.data(), mesh.weights.size());
+            }
+            
+            os.writeByte(gcore::FDMDModelVertexAttribIndex);
+            os.writeInt32((uint32_t)mesh.indices.size());
+            if (mesh.shortIndices()) {
+                std::vector<uint16_t> indices(mesh.indices.begin(), mesh.indices.end());
+                os.writeByte(sizeof(uint16_t));
+                os.writeInt16Array(indices.data(), indices.size());
+            } else {
+                os.writeByte(sizeof(uint32_t));
+                os.writeInt32Array(mesh.indices.data(), mesh.indices.size());
+            }
+            
+            os.writeByte(gcore::FDMDModelVertexAttribEndMesh);
+        }
+        
+        /*!
+         \brief A section of a v2 file, with the function writing its payload.
+         */
+        struct Section {
+            gcore::FDMDSectionEntry entry;
+            std::function<void(gcore::BinaryOutputStream &)> writePayload;
+            
+            Section(uint8_t type, uint32_t index, uint32_t count, uint64_t size, std::function<void(gcore::BinaryOutputStream &)> writePayload) : writePayload(writePayload) {
+                memset(&entry, 0, sizeof(gcore::FDMDSectionEntry));
+                entry.type = type;
+                entry.index = index;
+                entry.count = count;
+                entry.size = size;
+            }
+        };
+        
+        /*!
+         \brief Returns a vertex data section whose payload is \c values , written as little endian words of \c sizeof(T) bytes. The values must outlive the section.
+         */
+        template <typename T>
+        Section vertexSection(uint32_t meshID, uint32_t count, gcore::FDMDVertexAttrib attrib, gcore::FDMDComponentFormat format, uint8_t components, const std::vector<T> &values) {
+            Section section(gcore::FDMDSectionVertexData, meshID, count, values.size() * sizeof(T), [&values](gcore::BinaryOutputStream &os) {
+                std::vector<T> payload(values);
+                if (sizeof(T) == 2) {
+                    gcore::hostToLittleEndian16(payload.data(), payload.data(), payload.size());
+                } else {
+                    gcore::hostToLittleEndian32(payload.data(), payload.data(), payload.size());
+                }
+                os.write(payload.data(), payload.size() * sizeof(T));
+            });
+            section.entry.attrib = attrib;
+            section.entry.format = format;
+            section.entry.components = components;
+            return section;
+        }
+        
+    }
+    
+    /*!
+     \brief Writes a model with the given contents to \c fileName .
+     \return Whether the file has been written successfully.
+     */
+    inline bool writeSyntheticModel(const std::string &fileName, const SyntheticModel &model) {
+        using namespace gcore;
+        using namespace synthetic;
+        
+        std::vector<Mesh> meshes;
+        for (uint32_t i = 0; i < model.meshCount; i++) {
+            meshes.emplace_back(model, i);
+        }
+        
+        BinaryOutputStream os(fileName.c_str());
+        if (!os.good()) {
+            return false;
+        }
+        
+        if (!model.v2) {
+            os.writeByte((uint8_t)model.meshCount);
+            os.writeByte((uint8_t)model.animationCount);
+            for (uint32_t i = 0; i < model.meshCount; i++) {
+                writeMeshV1(os, meshes[i], i, model.vertexCount);
+            }
+            if (model.boneCount) {
+                os.writeByte(FDMDModelAttribSkeleton);
+                writeSkeleton(os, model);
+            }
+            for (uint32_t i = 0; i < model.animationCount; i++) {
+                os.writeByte(FDMDModelAttribAnimation);
+                writeAnimation(os, model, i);
+            }
+            os.writeByte(FDMDModelAttribEndFile);
+            return os.close();
+        }
+        
+        std::vector<std::vector<uint16_t>> shortIndices(model.meshCount);
+        std::vector<Section> sections;
+        for (uint32_t i = 0; i < model.meshCount; i++) {
+            const Mesh &mesh = meshes[i];
+            uint32_t vertexCount = model.vertexCount;
+            
+            sections.emplace_back(FDMDSectionMesh, i, vertexCount, 0, nullptr);
+            sections.push_back(vertexSection(i, vertexCount, FDMDModelVertexAttribPosition, FDMDFormatFloat32, 3, mesh.positions));
+            sections.push_back(vertexSection(i, vertexCount, FDMDModelVertexAttribNormal, FDMDFormatFloat32, 3, mesh.normals));
+            sections.push_back(vertexSection(i, vertexCount, FDMDModelVertexAttribTexCoord2, FDMDFormatFloat32, 2, mesh.texCoords));
+            if (!mesh.boneIDs.empty()) {
+                sections.push_back(vertexSection(i, vertexCount, FDMDModelVertexAttribBoneID, FDMDFormatUInt32, MAX_WEIGHTS_PER_VERTEX, mesh.boneIDs));
+                sections.push_back(vertexSection(i, vertexCount, FDMDModelVertexAttribBoneWeight, FDMDFormatFloat32, MAX_WEIGHTS_PER_VERTEX, mesh.weights));
+            }
+            if (mesh.shortIndices()) {
+                shortIndices[i].assign(mesh.indices.begin(), mesh.indices.end());
+                sections.push_back(vertexSection(i, (uint32_t)mesh.indices.size(), FDMDModelVertexAttribIndex, FDMDFormatUInt16, 1, shortIndices[i]));
+            } else {
+                sections.push_back(vertexSection(i, (uint32_t)mesh.indices.size(), FDMDModelVertexAttribIndex, FDMDFormatUInt32, 1, mesh.indices));
+            }
+        }
+        if (model.boneCount) {
+            sections.emplace_back(FDMDSectionSkeleton, 0, 0, skeletonSize(model), [&model](BinaryOutputStream &os) {
+                writeSkeleton(os, model);
+            });
+        }
+        for (uint32_t i = 0; i < model.animationCount; i++) {
+            sections.emplace_back(FDMDSectionAnimation, i, 0, animationSize(model), [&model, i](BinaryOutputStream &os) {
+                writeAnimation(os, model, i);
+            });
+        }
+        
+        FDMDHeader header;
+        memset(&header, 0, sizeof(FDMDHeader));
+        memcpy(header.magic, FDMD_MAGIC, 4);
+        header.version = FDMD_VERSION;
+        header.sectionCount = (uint32_t)sections.size();
+        header.meshCount = model.meshCount;
+        header.animCount = model.animationCount;
+        header.sectionTableOffset = sizeof(FDMDHeader);
+        
+        uint64_t offset = sizeof(FDMDHeader) + sizeof(FDMDSectionEntry) * sections.size();
+        for (Section &section : sections) {
+            offset = (offset + FDMD_SECTION_ALIGNMENT - 1) / FDMD_SECTION_ALIGNMENT * FDMD_SECTION_ALIGNMENT;
+            section.entry.offset = offset;
+            offset += section.entry.size;
+        }
+        
+        fdmdSwapToHost(header);
+        os.write(&header, sizeof(FDMDHeader));
+        for (const Section &section : sections) {
+            FDMDSectionEntry entry = section.entry;
+            fdmdSwapToHost(entry);
+            os.write(&entry, sizeof(FDMDSectionEntry));
+        }
+        for (const Section &section : sections) {
+            os.align(FDMD_SECTION_ALIGNMENT);
+            if (section.writePayload) {
+                section.writePayload(os);
+            }
+        }
+        return os.close();
+    }
+    
+}
+
+#endif
@@ -24,11 +24,18 @@
 // SOFTWARE.
 //
 
+#include <cmath>
+#include <functional>
+#include <iomanip>
 #include <iostream>
-#include <fstream>
 #include <string>
+#include <unordered_set>
+#include <vector>
 
-#include <netinet/in.h>
+#include <gcore/io/bin_ostream.h>
+#include <gcore/io/byte_order.h>
+#include <gcore/graphics/model/fdmd_loader.h>
+#include <gcore/graphics/model/vertex_packing.h>
 
 #include "scene.h"
 #include "Importer.hpp"
@@ -38,128 +45,504 @@
 
 using namespace std;
 using namespace Assimp;
+using namespace gcore;
 
-enum : unsigned int {
-    TYPE_ENDFILE = 0,
-    TYPE_MESH = 1,
+/*!
+ \brief A section of the output file, with the function writing its payload.
+ */
+struct OutputSection {
+    FDMDSectionEntry entry;
+    function<void(BinaryOutputStream &)> writePayload;
 };
 
-enum : unsigned int {
-    VERTEX_ATTRIB_ENDMESH = 0,
-    VERTEX_ATTRIB_POS = 1,
-    VERTEX_ATTRIB_NORMAL = 2,
-    VERTEX_ATTRIB_UV2 = 3,
-    VERTEX_ATTRIB_UV3 = 4,
-    VERTEX_ATTRIB_COLOR = 5
+inline uint64_t alignOffset(uint64_t offset) {
+    return (offset + FDMD_SECTION_ALIGNMENT - 1) / FDMD_SECTION_ALIGNMENT * FDMD_SECTION_ALIGNMENT;
+}
+
+/*!
+ \brief Writes the given 32-bit values as little endian, converting them in place if the host is big endian.
+ */
+template <typename T>
+void writeLittleEndian32(BinaryOutputStream &os, vector<T> &values) {
+    static_assert(sizeof(T) == 4, "32-bit values expected");
+    hostToLittleEndian32(values.data(), values.data(), values.size());
+    os.write(values.data(), values.size() * sizeof(T));
+}
+
+/*!
+ \brief Writes the given 16-bit values as little endian, converting them in place if the host is big endian.
+ */
+void writeLittleEndian16(BinaryOutputStream &os, vector<uint16_t> &values) {
+    hostToLittleEndian16(values.data(), values.data(), values.size());
+    os.write(values.data(), values.size() * sizeof(uint16_t));
+}
+
+/*!
+ \brief The vertex streams of a mesh, converted to the GraphCore coordinate system and ready to be written.
+ */
+struct MeshStreams {
+    uint32_t vertexCount = 0;
+    
+    vector<float> positions;
+    vector<float> normals;
+    vector<vector<float>> texCoords;
+    
+    /*!
+     \brief The triangle list indexing the vertices, or empty if the mesh is not indexed.
+     */
+    vector<uint32_t> indices;
 };
 
-void writeByte(ostream &os, uint8_t x) {
-    os.write((const char *)&x, 1);
+/*!
+ \brief Appends the attributes of the given vertex of the mesh to \c out , converting positions and normals to the GraphCore coordinate system (z, y, -x).
+ */
+void appendVertex(vector<float> &out, const aiMesh *mesh, uint32_t v, uint32_t texSets) {
+    if (mesh->HasPositions()) {
+        const aiVector3D &p = mesh->mVertices[v];
+        out.insert(out.end(), { p.z, p.y, -p.x });
+    }
+    if (mesh->HasNormals()) {
+        const aiVector3D &n = mesh->mNormals[v];
+        out.insert(out.end(), { n.z, n.y, -n.x });
+    }
+    for (uint32_t t = 0; t < texSets; t++) {
+        const aiVector3D &uv = mesh->mTextureCoords[t][v];
+        out.insert(out.end(), { uv.x, uv.y });
+    }
 }
 
-void writeInt16(ostream &os, uint16_t x) {
-    const uint8_t data[2] {
-        (uint8_t)((x >> 8) & 255),
-        (uint8_t)(x & 255)
-    };
+/*!
+ \brief Hash and equality of vertex records, comparing all the attributes of two vertices bit by bit.
+ */
+struct VertexRecords {
+    const vector<float> *records;
+    size_t stride;
+    
+    size_t operator()(uint32_t v) const {
+        const uint8_t *bytes = (const uint8_t *)(records->data() + v * stride);
+        uint64_t hash = 14695981039346656037ULL; // FNV-1a
+        for (size_t i = 0; i < stride * sizeof(float); i++) {
+            hash = (hash ^ bytes[i]) * 1099511628211ULL;
+        }
+        return (size_t)hash;
+    }
+    
+    bool operator()(uint32_t a, uint32_t b) const {
+        return !memcmp(records->data() + a * stride, records->data() + b * stride, stride * sizeof(float));
+    }
+};
+
+/*!
+ \brief Converts the vertices of the given mesh. If \c weld is set, the triangles of the mesh are indexed and the identical vertices are stored once.
+ */
+MeshStreams convertMesh(const aiMesh *mesh, bool weld) {
+    uint32_t texSets = 0;
+    while (mesh->HasTextureCoords(texSets)) {
+        texSets++;
+    }
+    
+    size_t stride = (mesh->HasPositions() ? 3 : 0) + (mesh->HasNormals() ? 3 : 0) + 2 * texSets;
+    
+    vector<float> records;
+    MeshStreams streams;
+    
+    if (weld && stride > 0) {
+        VertexRecords hasher { &records, stride };
+        unordered_set<uint32_t, VertexRecords, VertexRecords> unique(mesh->mNumVertices, hasher, hasher);
+        
+        records.reserve(mesh->mNumVertices * stride);
+        streams.indices.reserve((size_t)mesh->mNumFaces * 3);
+        
+        for (uint32_t f = 0; f < mesh->mNumFaces; f++) {
+            const aiFace &face = mesh->mFaces[f];
+            if (face.mNumIndices != 3) {
+                continue; // points and lines are not drawn
+            }
+            
+            for (uint32_t k = 0; k < 3; k++) {
+                uint32_t candidate = (uint32_t)(records.size() / stride);
+                appendVertex(records, mesh, face.mIndices[k], texSets);
+                
+                auto found = unique.insert(candidate);
+                if (!found.second) {
+                    records.resize(records.size() - stride); // already stored
+                }
+                streams.indices.push_back(*found.first);
+            }
+        }
+    } else {
+        for (uint32_t v = 0; v < mesh->mNumVertices; v++) {
+            appendVertex(records, mesh, v, texSets);
+        }
+    }
     
-    os.write((const char *)data, 2);
+    // Split the records in one stream per attribute.
+    uint32_t vertexCount = streams.vertexCount = stride > 0 ? (uint32_t)(records.size() / stride) : mesh->mNumVertices;
+    streams.texCoords.resize(texSets);
+    
+    for (uint32_t v = 0; v < vertexCount; v++) {
+        const float *record = records.data() + v * stride;
+        
+        if (mesh->HasPositions()) {
+            streams.positions.insert(streams.positions.end(), record, record + 3);
+            record += 3;
+        }
+        if (mesh->HasNormals()) {
+            streams.normals.insert(streams.normals.end(), record, record + 3);
+            record += 3;
+        }
+        for (uint32_t t = 0; t < texSets; t++) {
+            streams.texCoords[t].insert(streams.texCoords[t].end(), record, record + 2);
+            record += 2;
+        }
+    }
+    
+    return streams;
+}
+
+OutputSection vertexSection(uint32_t meshID, uint32_t count, FDMDVertexAttrib attrib, FDMDComponentFormat format, uint8_t components, uint64_t size, function<void(BinaryOutputStream &)> writePayload) {
+    OutputSection section;
+    memset(&section.entry, 0, sizeof(FDMDSectionEntry));
+    
+    section.entry.type = FDMDSectionVertexData;
+    section.entry.attrib = attrib;
+    section.entry.format = format;
+    section.entry.components = components;
+    section.entry.index = meshID;
+    section.entry.count = count;
+    section.entry.size = size;
+    section.writePayload = writePayload;
+    return section;
+}
+
+OutputSection floatSection(uint32_t meshID, FDMDVertexAttrib attrib, uint8_t components, vector<float> &values) {
+    uint32_t vertexCount = (uint32_t)(values.size() / components);
+    return vertexSection(meshID, vertexCount, attrib, FDMDFormatFloat32, components, values.size() * sizeof(float), [&values](BinaryOutputStream &os) {
+        writeLittleEndian32(os, values);
+    });
+}
+
+
+/*!
+ \brief Computes the quantization mapping the positions of the mesh into [-1, 1].
+ */
+FDMDMeshQuantization positionQuantization(const vector<float> &positions) {
+    FDMDMeshQuantization quantization;
+    computeQuantizationRange(positions.data(), positions.size() / 3, 3, quantization.positionOffset, quantization.positionScale);
+    return quantization;
 }
 
-void writeInt32(ostream &os, uint32_t x) {
-    const uint8_t data[4] = {
-        (uint8_t)((x >> 24) & 255),
-        (uint8_t)((x >> 16) & 255),
-        (uint8_t)((x >> 8) & 255),
-        (uint8_t)(x & 255)
-    };
-    os.write((const char *)data, 4);
+/*!
+ \brief Encodes the given positions in [-1, 1] as four 16-bit values per vertex, either half floats or signed normalized integers. The fourth value is always zero and keeps the vertex size a multiple of 4 bytes.
+ */
+vector<uint16_t> packPositions(const vector<float> &positions, const FDMDMeshQuantization &quantization, bool half) {
+    vector<uint16_t> packed;
+    packed.reserve(positions.size() / 3 * 4);
+    
+    for (size_t i = 0; i < positions.size(); i += 3) {
+        for (size_t c = 0; c < 3; c++) {
+            float x = (positions[i + c] - quantization.positionOffset[c]) / quantization.positionScale[c];
+            packed.push_back(half ? floatToHalf(x) : (uint16_t)packSNorm16(x));
+        }
+        packed.push_back(0);
+    }
+    return packed;
 }
 
-void writeFloat(ostream &os, float x) {
-    uint32_t ix = *((uint32_t *)&x);
-    const uint8_t data[4] = {
-        (uint8_t)((ix >> 24) & 255),
-        (uint8_t)((ix >> 16) & 255),
-        (uint8_t)((ix >> 8) & 255),
-        (uint8_t)(ix & 255)
-    };
-    os.write((const char *)data, 4);
+float unpackPosition(uint16_t x, const FDMDMeshQuantization &quantization, size_t c, bool half) {
+    return quantization.positionOffset[c] + quantization.positionScale[c] * (half ? halfToFloat(x) : unpackSNorm16((int16_t)x));
 }
 
-inline void writeVec3(ostream &os, float x, float y, float z) {
-    writeFloat(os, z);
-    writeFloat(os, y);
-    writeFloat(os, -x);
+vector<uint32_t> packNormals(const vector<float> &normals) {
+    vector<uint32_t> packed;
+    packed.reserve(normals.size() / 3);
+    
+    for (size_t i = 0; i < normals.size(); i += 3) {
+        packed.push_back(packSNorm2_10_10_10(normals[i], normals[i + 1], normals[i + 2]));
+    }
+    return packed;
 }
 
-inline void writeVec2(ostream &os, float x, float y) {
-    writeFloat(os, x);
-    writeFloat(os, y);
+/*!
+ \brief Returns whether all the given texture coordinates are in [0, 1], so that they can be stored as unsigned normalized integers.
+ */
+bool isUnitRange(const vector<float> &texCoords) {
+    for (float x : texCoords) {
+        if (x < 0.0f || x > 1.0f) {
+            return false;
+        }
+    }
+    return true;
+}
+
+/*!
+ \brief Encodes the given texture coordinates as 16-bit values, either unsigned normalized integers or, if they are not all in [0, 1], half floats.
+ */
+vector<uint16_t> packTexCoords(const vector<float> &texCoords, bool unorm) {
+    vector<uint16_t> packed;
+    packed.reserve(texCoords.size());
+    
+    for (float x : texCoords) {
+        packed.push_back(unorm ? packUNorm16(x) : floatToHalf(x));
+    }
+    return packed;
+}
+
+/*!
+ \brief Maximum and root mean square of the errors introduced by an encoding.
+ */
+struct ErrorStats {
+    double max = 0;
+    double sumSquares = 0;
+    size_t count = 0;
+    
+    void add(double error) {
+        max = std::max(max, error);
+        sumSquares += error * error;
+        count++;
+    }
+    
+    void print(const char *name, const char *unit) const {
+        cout << "  " << left << setw(36) << name << " max " << setw(12) << max << " rms " << setw(12) << (count ? sqrt(sumSquares / count) : 0.0) << unit << endl;
+    }
+};
+
+/*!
+ \brief Prints the error each packed encoding would introduce on the attributes of the given mesh.
+ */
+void reportEncodingErrors(uint32_t meshID, const MeshStreams &mesh) {
+    cout << "Mesh " << meshID << " (" << mesh.vertexCount << " vertices)" << endl;
+    
+    if (!mesh.positions.empty()) {
+        FDMDMeshQuantization quantization = positionQuantization(mesh.positions);
+        double diagonal = 2 * sqrt(quantization.positionScale[0] * quantization.positionScale[0] + quantization.positionScale[1] * quantization.positionScale[1] + quantization.positionScale[2] * quantization.positionScale[2]);
+        
+        for (bool half : { false, true }) {
+            vector<uint16_t> packed = packPositions(mesh.positions, quantization, half);
+            ErrorStats stats;
+            for (size_t v = 0; v < mesh.positions.size() / 3; v++) {
+                double squared = 0;
+                for (size_t c = 0; c < 3; c++) {
+                    double d = unpackPosition(packed[v * 4 + c], quantization, c, half) - mesh.positions[v * 3 + c];
+                    squared += d * d;
+                }
+                stats.add(sqrt(squared));
+            }
+            stats.print(half ? "position float16 (mesh range)" : "position snorm16 (mesh range)", " units");
+        }
+        cout << "  (bounding box diagonal " << diagonal << " units)" << endl;
+    }
+    
+    if (!mesh.normals.empty()) {
+        vector<uint32_t> packed = packNormals(mesh.normals);
+        ErrorStats stats;
+        for (size_t v = 0; v < packed.size(); v++) {
+            float n[4];
+            unpackSNorm2_10_10_10(packed[v], n);
+            
+            const float *original = &mesh.normals[v * 3];
+            double length = sqrt(n[0] * n[0] + n[1] * n[1] + n[2] * n[2]) * sqrt(original[0] * original[0] + original[1] * original[1] + original[2] * original[2]);
+            double cosine = length > 0 ? (n[0] * original[0] + n[1] * original[1] + n[2] * original[2]) / length : 1.0;
+            stats.add(acos(fmin(fmax(cosine, -1.0), 1.0)) * 180.0 / M_PI);
+        }
+        stats.print("normal snorm 2_10_10_10", " degrees");
+    }
+    
+    for (const vector<float> &texCoords : mesh.texCoords) {
+        for (bool unorm : { true, false }) {
+            if (unorm && !isUnitRange(texCoords)) {
+                cout << "  texcoord unorm16 not applicable, coordinates outside [0, 1]" << endl;
+                continue;
+            }
+            
+            vector<uint16_t> packed = packTexCoords(texCoords, unorm);
+            ErrorStats stats;
+            for (size_t i = 0; i < packed.size(); i++) {
+                stats.add(fabs((unorm ? unpackUNorm16(packed[i]) : halfToFloat(packed[i])) - texCoords[i]));
+            }
+            stats.print(unorm ? "texcoord unorm16" : "texcoord float16", "");
+        }
+    }
+    
+    size_t floatSize = (mesh.positions.empty() ? 0 : 12) + (mesh.normals.empty() ? 0 : 12) + 8 * mesh.texCoords.size();
+    size_t packedSize = (mesh.positions.empty() ? 0 : 8) + (mesh.normals.empty() ? 0 : 4) + 4 * mesh.texCoords.size();
+    cout << "  vertex size: " << floatSize << " bytes as floats, " << packedSize << " bytes packed" << endl;
 }
 
 
 int main(int argc, const char * argv[]) {
     
-    if (argc < 2) {
+    BinaryOutputStreamOptions outputOptions;
+    bool weld = true;
+    bool quantize = true;
+    bool halfPositions = false;
+    bool reportErrors = false;
+    const char *inputFile = nullptr;
+    
+    for (int i = 1; i < argc; i++) {
+        string arg = argv[i];
+        
+        if (arg == "--writev") {
+            outputOptions.mode = BinaryOutputStreamVectored;
+        } else if (arg == "--mmap") {
+            outputOptions.mode = BinaryOutputStreamMapped;
+        } else if (arg == "--no-index") {
+            weld = false;
+        } else if (arg == "--no-quantize") {
+            quantize = false;
+        } else if (arg == "--half-positions") {
+            halfPositions = true;
+        } else if (arg == "--report-error") {
+            reportErrors = true;
+        } else {
+            inputFile = argv[i];
+        }
+    }
+    
+    if (!inputFile) {
         cout << "File name not specified." << endl;
+        cout << "Usage: collada2bin [--writev | --mmap] [--no-index] [--no-quantize | --half-positions] [--report-error] <file>" << endl;
+        cout << "  --report-error  prints the error introduced by each packed vertex encoding, without writing the output" << endl;
         return 0;
     }
     
     Importer imp;
-    const aiScene *scene = imp.ReadFile(argv[1], aiProcess_OptimizeMeshes | aiProcess_OptimizeGraph);
+    const aiScene *scene = imp.ReadFile(inputFile, aiProcess_Triangulate | aiProcess_OptimizeMeshes | aiProcess_OptimizeGraph);
     
-    ofstream os(std::string(argv[1]) + ".mdl", ios::binary);
+    if (!scene) {
+        cout << "Could not import " << inputFile << ": " << imp.GetErrorString() << endl;
+        return 1;
+    }
     
-    writeByte(os, scene->mNumMeshes);
-    writeByte(os, 0); // animations count
+    vector<MeshStreams> meshes(scene->mNumMeshes);
+    vector<OutputSection> sections;
     
-    for (int i = 0; i < scene->mNumMeshes; i++) {
-        aiMesh *mesh = scene->mMeshes[i];
-        
+    if (reportErrors) {
+        for (uint32_t i = 0; i < scene->mNumMeshes; i++) {
+            reportEncodingErrors(i, convertMesh(scene->mMeshes[i], weld));
+        }
+        return 0;
+    }
+    
+    for (uint32_t i = 0; i < scene->mNumMeshes; i++) {
+        MeshStreams &mesh = meshes[i] = convertMesh(scene->mMeshes[i], weld);
         
-        writeByte(os, TYPE_MESH); // Type = MESH
-        writeByte(os, i); // MeshID
-        writeInt32(os, mesh->mNumVertices); // Number of vertices
+        OutputSection meshSection;
+        memset(&meshSection.entry, 0, sizeof(FDMDSectionEntry));
+        meshSection.entry.type = FDMDSectionMesh;
+        meshSection.entry.index = i;
+        meshSection.entry.count = mesh.vertexCount;
         
-        if (mesh->HasPositions()) {
-            writeByte(os, VERTEX_ATTRIB_POS); // VertexAttrib = POSITION
-
-            for (int j = 0; j < mesh->mNumVertices; j++) {
-                aiVector3D &vertex = mesh->mVertices[j];
-                
-                writeVec3(os, vertex.x, vertex.y, vertex.z);
+        if (quantize && !mesh.positions.empty()) {
+            FDMDMeshQuantization quantization = positionQuantization(mesh.positions);
+            
+            meshSection.entry.size = sizeof(FDMDMeshQuantization);
+            meshSection.writePayload = [quantization](BinaryOutputStream &os) {
+                FDMDMeshQuantization payload = quantization;
+                hostToLittleEndian32(&payload, &payload, sizeof(FDMDMeshQuantization) / 4);
+                os.write(&payload, sizeof(FDMDMeshQuantization));
+            };
+            sections.push_back(meshSection);
+            
+            sections.push_back(vertexSection(i, mesh.vertexCount, FDMDModelVertexAttribPosition, halfPositions ? FDMDFormatFloat16 : FDMDFormatSNorm16, 4, (size_t)mesh.vertexCount * 4 * sizeof(uint16_t), [&mesh, quantization, halfPositions](BinaryOutputStream &os) {
+                vector<uint16_t> packed = packPositions(mesh.positions, quantization, halfPositions);
+                writeLittleEndian16(os, packed);
+            }));
+        } else {
+            sections.push_back(meshSection);
+            
+            if (!mesh.positions.empty()) {
+                sections.push_back(floatSection(i, FDMDModelVertexAttribPosition, 3, mesh.positions));
             }
         }
         
-        if (mesh->HasNormals()) {
-            writeByte(os, VERTEX_ATTRIB_NORMAL); // VertexAttrib = NORMAL
+        if (quantize && !mesh.normals.empty()) {
+            sections.push_back(vertexSection(i, mesh.vertexCount, FDMDModelVertexAttribNormal, FDMDFormatSNorm2_10_10_10, 4, (size_t)mesh.vertexCount * sizeof(uint32_t), [&mesh](BinaryOutputStream &os) {
+                vector<uint32_t> packed = packNormals(mesh.normals);
+                writeLittleEndian32(os, packed);
+            }));
+        } else if (!mesh.normals.empty()) {
+            sections.push_back(floatSection(i, FDMDModelVertexAttribNormal, 3, mesh.normals));
+        }
+        
+        for (uint32_t texIndex = 0; texIndex < mesh.texCoords.size(); texIndex++) {
+            vector<float> &texCoords = mesh.texCoords[texIndex];
+            OutputSection uvSection;
             
-            for (int j = 0; j < mesh->mNumVertices; j++) {
-                aiVector3D &normal = mesh->mNormals[j];
-                
-                writeVec3(os, normal.x, normal.y, normal.z);
+            if (quantize) {
+                bool unorm = isUnitRange(texCoords);
+                uvSection = vertexSection(i, mesh.vertexCount, FDMDModelVertexAttribTexCoord2, unorm ? FDMDFormatUNorm16 : FDMDFormatFloat16, 2, texCoords.size() * sizeof(uint16_t), [&texCoords, unorm](BinaryOutputStream &os) {
+                    vector<uint16_t> packed = packTexCoords(texCoords, unorm);
+                    writeLittleEndian16(os, packed);
+                });
+            } else {
+                uvSection = floatSection(i, FDMDModelVertexAttribTexCoord2, 2, texCoords);
             }
+            uvSection.entry.set = texIndex;
+            sections.push_back(uvSection);
         }
         
-        
-        int texIndex = 0;
-        while (mesh->HasTextureCoords(texIndex)) {
-            writeByte(os, VERTEX_ATTRIB_UV2); // VertexAttrib = UV2
-            writeByte(os, texIndex); // TextureIndex
+        if (!mesh.indices.empty()) {
+            vector<uint32_t> &indices = mesh.indices;
             
-            for (int j = 0; j < mesh->mNumVertices; j++) {
-                aiVector3D &texCoords = mesh->mTextureCoords[texIndex][j];
-                
-                writeVec2(os, texCoords.x, texCoords.y);
+            if (mesh.vertexCount <= 65536) {
+                sections.push_back(vertexSection(i, (uint32_t)indices.size(), FDMDModelVertexAttribIndex, FDMDFormatUInt16, 1, indices.size() * sizeof(uint16_t), [&indices](BinaryOutputStream &os) {
+                    vector<uint16_t> shortIndices(indices.begin(), indices.end());
+                    writeLittleEndian16(os, shortIndices);
+                }));
+            } else {
+                sections.push_back(vertexSection(i, (uint32_t)indices.size(), FDMDModelVertexAttribIndex, FDMDFormatUInt32, 1, indices.size() * sizeof(uint32_t), [&indices](BinaryOutputStream &os) {
+                    writeLittleEndian32(os, indices);
+                }));
             }
             
-            texIndex++;
+            cout << "Mesh " << i << ": " << scene->mMeshes[i]->mNumVertices << " vertices welded to " << mesh.vertexCount << ", " << indices.size() << " indices" << endl;
         }
-        
-        writeByte(os, VERTEX_ATTRIB_ENDMESH);
     }
-    writeByte(os, TYPE_ENDFILE);
+    
+    // Lay out the sections after the header and the section table.
+    FDMDHeader header;
+    memset(&header, 0, sizeof(FDMDHeader));
+    memcpy(header.magic, FDMD_MAGIC, 4);
+    header.version = FDMD_VERSION;
+    header.sectionCount = (uint32_t)sections.size();
+    header.meshCount = scene->mNumMeshes;
+    header.animCount = 0;
+    header.sectionTableOffset = sizeof(FDMDHeader);
+    
+    uint64_t offset = sizeof(FDMDHeader) + sizeof(FDMDSectionEntry) * sections.size();
+    for (OutputSection &section : sections) {
+        section.entry.offset = offset = alignOffset(offset);
+        offset += section.entry.size;
+    }
+    
+    BinaryOutputStream os((std::string(inputFile) + ".mdl").c_str(), outputOptions);
+    
+    if (!os.good()) {
+        cout << "Could not create the output file." << endl;
+        return 1;
+    }
+    
+    fdmdSwapToHost(header);
+    os.write(&header, sizeof(FDMDHeader));
+    
+    for (OutputSection &section : sections) {
+        FDMDSectionEntry entry = section.entry;
+        fdmdSwapToHost(entry);
+        os.write(&entry, sizeof(FDMDSectionEntry));
+    }
+    
+    for (OutputSection &section : sections) {
+        if (section.writePayload) {
+            os.align(FDMD_SECTION_ALIGNMENT);
+            section.writePayload(os);
+        }
+    }
+    
+    if (!os.close()) {
+        cout << "Could not write the output file." << endl;
+        return 1;
+    }
 
     return 0;
 }
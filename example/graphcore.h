@@ -33,10 +33,14 @@
     
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
+
+#include <vector>
     
+#include <gcore/graphics/render_queue.h>
 #include <gcore/graphics/shaders/shaders.h>
 #include <gcore/graphics/model/textures.h>
 #include <gcore/graphics/model/model.h>
+#include <gcore/graphics/model/model_instance.h>
     
 class GraphCore : public gcore::WindowDrawer {
     
@@ -45,12 +49,28 @@ class GraphCore : public gcore::WindowDrawer {
     
     gcore::Model *myModel;
     
-    glm::mat4 mvp;
-    glm::mat4 normalMatrix;
+    // A grid of instances of the model, drawn with an instanced draw call per mesh.
+    std::vector<gcore::ModelInstance *> crowd;
+    std::vector<glm::mat4> crowdMatrices;
+    gcore::InstanceBatch *crowdBatch;
+    
+    gcore::StreamBuffer *palettes;
+    
+    gcore::RenderQueue renderQueue;
+    
+    glm::mat4 viewProjection;
     GLuint charizardTexture;
     
     float t, r;
     
+    // Sets the uniforms of a mesh of the crowd, queued with the GraphCore as object.
+    static void setCrowdUniforms(const gcore::RenderItem &item) {
+        const GraphCore *self = (const GraphCore *)item.object;
+        
+        glUniform1i(self->skeletonProgram->getUniform(4), self->crowdBatch->getInstanceOffset(*self->palettes));
+        glUniform3fv(self->skeletonProgram->getUniform(3), 2, self->myModel->getMeshQuantization(item.index).positionOffset);
+    }
+    
 public:
     
     GraphCore(gcore::Window &window) : gcore::WindowDrawer(window) {  }
@@ -65,18 +85,33 @@ public:
         
         glClearColor(1.0, 1.0, 0.0, 0.0);
 
-        skeletonProgram = gcore::ShaderProgram::fromSources("skeleton.vsh", "shader.fsh");
-        skeletonProgram->addUniform("mvp");
-        skeletonProgram->addUniform("normalMatrix");
+        skeletonProgram = gcore::ShaderProgram::fromSources("skeleton_instanced.vsh", "shader.fsh");
+        skeletonProgram->addUniform("viewProjection");
         skeletonProgram->addUniform("boneJoints");
         skeletonProgram->addUniform("texSampler");
+        skeletonProgram->addUniform("positionDequantization");
+        skeletonProgram->addUniform("instanceOffset");
+        
+        palettes = new gcore::StreamBuffer(GL_TEXTURE_BUFFER, 4 * 1024 * 1024, 3, GL_RGBA32F);
         
         
         myModel = gcore::Model::fromFile("wolf.mdl");
+        crowdBatch = new gcore::InstanceBatch(*myModel);
+        
+        const int crowdSide = 32;
+        for (int i = 0; i < crowdSide * crowdSide; i++) {
+            gcore::ModelInstance *instance = new gcore::ModelInstance(*myModel);
+            instance->update(i * 0.037); // out of step
+            crowd.push_back(instance);
+            
+            glm::vec3 position(3.0f * (i % crowdSide - crowdSide / 2), 3.0f * (i / crowdSide - crowdSide / 2), 0.0f);
+            crowdMatrices.push_back(glm::translate(glm::mat4(1.0f), position));
+        }
+        
         charizardTexture = gcore::loadTexture("charizard.tga");
         
         t = 0;
-        r = 5;
+        r = 60;
     }
     
     void doResize() {
@@ -85,11 +120,9 @@ public:
     
     void doUpdate(double dt) {
         
-        glm::mat4 modelMatrix = glm::mat4(1.0f);
-        glm::mat4 viewMatrix = glm::lookAt(glm::vec3(r*cos(t), r*sin(t), 0), glm::vec3(0, 0, 0), glm::vec3(0, 0, 1));
-        glm::mat4 projectionMatrix = glm::perspective((float)3.14/4, getTargetWindow().getAspectRatio(), 0.1f, 100.0f);
-        mvp = projectionMatrix * viewMatrix * modelMatrix;
-        normalMatrix = glm::transpose(glm::inverse(modelMatrix));
+        glm::mat4 viewMatrix = glm::lookAt(glm::vec3(r*cos(t), r*sin(t), r*0.5f), glm::vec3(0, 0, 0), glm::vec3(0, 0, 1));
+        glm::mat4 projectionMatrix = glm::perspective((float)3.14/4, getTargetWindow().getAspectRatio(), 0.1f, 500.0f);
+        viewProjection = projectionMatrix * viewMatrix;
         
         
         if (getTargetWindow().isKeyPressed(GLFW_KEY_LEFT)) {
@@ -107,7 +140,9 @@ public:
             r += 10 * dt;
         }
         
-        myModel->update(dt);
+        for (gcore::ModelInstance *instance : crowd) {
+            instance->update(dt);
+        }
         
     }
     
@@ -116,14 +151,26 @@ public:
         
         skeletonProgram->use();
         
-        glActiveTexture(GL_TEXTURE0);
-        glBindTexture(GL_TEXTURE_2D, charizardTexture);
+        glUniformMatrix4fv(skeletonProgram->getUniform(0), 1, 0, &viewProjection[0][0]);
+        glUniform1i(skeletonProgram->getUniform(2), 0); // texSampler
+        glUniform1i(skeletonProgram->getUniform(1), 1); // boneJoints
         
-        glUniformMatrix4fv(skeletonProgram->getUniform(0), 1, 0, &mvp[0][0]);
-        glUniformMatrix4fv(skeletonProgram->getUniform(1), 1, 0, &normalMatrix[0][0]);
-        glUniform1i(skeletonProgram->getUniform(3), 0); // texSampler
+        palettes->beginFrame();
+        crowdBatch->stream(*palettes, crowd.data(), crowdMatrices.data(), (uint32_t)crowd.size());
+        palettes->flush();
+        palettes->bindTexture(GL_TEXTURE1);
         
-        myModel->draw(skeletonProgram->getUniform(2));
+        gcore::RenderItem crowdItem;
+        crowdItem.program = skeletonProgram;
+        crowdItem.texture = charizardTexture;
+        crowdItem.instanceCount = (GLsizei)crowdBatch->getInstanceCount();
+        crowdItem.setUniforms = setCrowdUniforms;
+        crowdItem.object = this;
+        
+        renderQueue.clear();
+        myModel->queueMeshes(renderQueue, crowdItem);
+        renderQueue.submit();
+        palettes->endFrame();
         
         glBindVertexArray(0);
 
@@ -132,6 +179,12 @@ public:
     void doDestroy() {
         
         delete skeletonProgram;
+        delete palettes;
+        
+        for (gcore::ModelInstance *instance : crowd) {
+            delete instance;
+        }
+        delete crowdBatch;
         
     }
     
@@ -0,0 +1,259 @@
+//
+// => gcore/graphics/asset_cache.h
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#ifndef __graphcore_graphics_asset_cache
+#define __graphcore_graphics_asset_cache
+
+#include <gcore/graphics/model/model.h>
+#include <gcore/graphics/model/model_loader.h>
+#include <gcore/graphics/model/textures.h>
+#include <gcore/graphics/shaders/shaders.h>
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <unordered_map>
+
+namespace gcore {
+    
+    typedef enum : uint8_t {
+        AssetKindModel,
+        AssetKindTexture,
+        AssetKindShader
+    } AssetKind;
+    
+    typedef enum : uint8_t {
+        AssetStateLoading,
+        AssetStateReady,
+        AssetStateFailed
+    } AssetState;
+    
+    /*!
+     \brief An asset kept by an \c AssetCache , shared by all the handles to it.
+     */
+    class AssetEntry {
+        friend class AssetCache;
+        
+        std::string key;
+        AssetKind kind;
+        
+        std::atomic<AssetState> state;
+        std::atomic<uint32_t> refCount;
+        
+        void *asset = nullptr;
+        
+        /*!
+         \brief The load in progress of a model loaded through a \c ModelLoader .
+         */
+        std::shared_ptr<ModelRequest> request;
+        
+        size_t cpuSize = 0;
+        size_t gpuSize = 0;
+        uint64_t lastUse = 0;
+        
+    public:
+        AssetEntry(const std::string &key, AssetKind kind) : key(key), kind(kind), state(AssetStateLoading), refCount(0) {  }
+        
+        inline AssetState getState() const {
+            return state.load(std::memory_order_acquire);
+        }
+        
+        inline void retain() {
+            refCount.fetch_add(1, std::memory_order_relaxed);
+        }
+        
+        inline void release() {
+            refCount.fetch_sub(1, std::memory_order_acq_rel);
+        }
+        
+        inline void *getAsset() const {
+            return getState() == AssetStateReady ? asset : nullptr;
+        }
+        
+    };
+    
+    /*!
+     \brief A reference to an asset of an \c AssetCache . The asset is kept loaded while any handle to it exists.
+     \note Handles can be copied and dropped on any thread. The asset is destroyed by the cache, on the thread owning the OpenGL context.
+     */
+    template <typename T>
+    class AssetHandle {
+        
+        friend class AssetCache;
+        
+        AssetEntry *entry = nullptr;
+        
+        /*!
+         \brief Takes over a reference already retained by the cache.
+         */
+        AssetHandle(AssetEntry *entry, bool) : entry(entry) {  }
+        
+    public:
+        AssetHandle() {  }
+        
+        explicit AssetHandle(AssetEntry *entry) : entry(entry) {
+            if (entry) {
+                entry->retain();
+            }
+        }
+        
+        AssetHandle(const AssetHandle &other) : AssetHandle(other.entry) {  }
+        
+        AssetHandle(AssetHandle &&other) : entry(other.entry) {
+            other.entry = nullptr;
+        }
+        
+        AssetHandle &operator=(AssetHandle other) {
+            std::swap(entry, other.entry);
+            return *this;
+        }
+        
+        ~AssetHandle() {
+            if (entry) {
+                entry->release();
+            }
+        }
+        
+        /*!
+         \brief Returns the state of the asset, which is \c AssetStateFailed for an empty handle.
+         */
+        inline AssetState getState() const {
+            return entry ? entry->getState() : AssetStateFailed;
+        }
+        
+        inline bool isReady() const {
+            return getState() == AssetStateReady;
+        }
+        
+        /*!
+         \brief Returns the asset, or \c nullptr if it is not loaded (yet).
+         */
+        inline T *get() const {
+            return entry ? (T *)entry->getAsset() : nullptr;
+        }
+        
+        inline T *operator->() const {
+            return get();
+        }
+        
+    };
+    
+    /*!
+     \brief A cache of models, textures and shader programs, keyed by the canonical path of their files and the options they are loaded with.
+     \note Requesting an asset that is loaded, or being loaded, returns a handle to the same asset. Assets no longer referenced by any handle stay cached until the memory budget is exceeded, then they are destroyed least recently requested first.
+     \warning Textures and shader programs are loaded when requested, and assets are destroyed in \c update() , so these must be called on the thread owning the OpenGL context.
+     */
+    class AssetCache {
+        
+        ModelLoader *loader;
+        
+        mutable std::mutex mutex;
+        std::unordered_map<std::string, std::unique_ptr<AssetEntry>> entries;
+        uint64_t clock = 0;
+        
+        size_t cpuBudget = 0;
+        size_t gpuBudget = 0;
+        size_t cpuMemory = 0;
+        size_t gpuMemory = 0;
+        
+        /*!
+         \brief Returns the entry with the given key, creating it if needed.
+         \param created Set to whether the entry was created, in which case the caller must load the asset.
+         */
+        AssetEntry *acquire(const std::string &key, AssetKind kind, bool &created);
+        
+        /*!
+         \brief Marks the load of an entry as completed, with \c asset being \c nullptr if it failed.
+         */
+        void complete(AssetEntry *entry, void *asset);
+        
+        static void measure(AssetEntry *entry);
+        
+        static void destroy(AssetEntry *entry);
+        
+        /*!
+         \brief Destroys unreferenced assets, least recently requested first, until the memory used fits the budget. The mutex must be held.
+         */
+        void evict();
+        
+    public:
+        /*!
+         \brief Creates an empty cache.
+         \param loader The loader used to load models in the background, or \c nullptr to load them when requested.
+         */
+        explicit AssetCache(ModelLoader *loader = nullptr) : loader(loader) {  }
+        
+        /*!
+         \brief Destroys all the cached assets, whether referenced or not.
+         \warning No handle to the assets of the cache may be used after it is destroyed.
+         */
+        ~AssetCache();
+        
+        AssetCache(const AssetCache &) = delete;
+        AssetCache &operator=(const AssetCache &) = delete;
+        
+        AssetHandle<Model> getModel(const char *fileName, const ModelLoadOptions &options = ModelLoadOptions());
+        
+        AssetHandle<Texture> getTexture(const char *fileName);
+        
+        AssetHandle<ShaderProgram> getShader(const char *vShaderPath, const char *fShaderPath);
+        
+        /*!
+         \brief Sets the memory budgets, in bytes, for the assets kept in main memory and in video memory. A budget of 0 (the default) never evicts assets.
+         */
+        void setBudget(size_t cpuBytes, size_t gpuBytes);
+        
+        /*!
+         \brief Completes the models loaded in the background, uploading their meshes within \c uploadBudgetSeconds , then updates the memory used by the assets and evicts the unreferenced ones exceeding the budget.
+         \note This should be called once per frame.
+         */
+        void update(double uploadBudgetSeconds = 0.0);
+        
+        inline size_t getCPUMemory() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return cpuMemory;
+        }
+        
+        inline size_t getGPUMemory() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return gpuMemory;
+        }
+        
+        /*!
+         \brief Returns the number of assets in the cache, referenced or not.
+         */
+        inline size_t getAssetCount() const {
+            std::lock_guard<std::mutex> lock(mutex);
+            return entries.size();
+        }
+        
+    };
+    
+}
+
+#endif
@@ -28,10 +28,13 @@
 #define __graphcore_graphics_model_animations
 
 #include <gcore/graphics/model/skeleton.h>
+#include <gcore/graphics/model/pose.h>
+#include <gcore/util/arena.h>
 
 #include <glm/glm.hpp>
 
 #include <cstdint>
+#include <vector>
 
 namespace gcore {
     
@@ -54,7 +57,49 @@ namespace gcore {
         float t;
     };
     
+    /*!
+     \brief Compressed vector keys: each key is three 16-bit values quantized in the range of the track, and a 16-bit time normalized over the animation duration.
+     */
+    struct CompressedVectorTrack {
+        uint16_t *times = nullptr;
+        uint16_t *values = nullptr;
+        
+        /*!
+         \brief The smallest value of each component, restored from 0.
+         */
+        glm::vec3 rangeMin;
+        /*!
+         \brief The difference between the largest and the smallest value of each component, restored from 65535.
+         */
+        glm::vec3 rangeExtent;
+    };
+    
+    /*!
+     \brief Compressed quaternion keys: each key is a 16-bit normalized time and a quaternion in 48 bits with the smallest-three encoding.
+     \note The three smallest components, in the cyclic order following the largest one, are stored in the low 15 bits of three words; the top bits of the first two words hold the index of the largest component, which is restored as positive from the unit length.
+     */
+    struct CompressedQuaternionTrack {
+        uint16_t *times = nullptr;
+        uint16_t *values = nullptr;
+    };
+    
     
+    /*!
+     \brief The keys around a time in each track of a channel, and the factor interpolating each pair. A track without keys has its default value in both keys.
+     */
+    struct KeySample {
+        glm::vec3 position[2];
+        glm::quat rotation[2];
+        glm::vec3 scale[2];
+        
+        float positionFactor;
+        float rotationFactor;
+        float scaleFactor;
+    };
+    
+    /*!
+     \brief The position of the playback in the keys of a channel, kept by each \c ModelInstance so that a channel seeks from the keys it sampled last. Each index is the first key after the time last sampled.
+     */
     struct KeyFrame {
         uint32_t nextPosKey = 0;
         uint32_t nextRotKey = 0;
@@ -62,8 +107,13 @@ namespace gcore {
     };
     
     
+    /*!
+     \brief The keys animating a node of a skeleton.
+     \note Channels and their keys live in the arena of their animation.
+     */
     class KeyFrameChannel {
         friend class Model;
+        friend class Animation;
         
         Animation &animation;
         
@@ -73,54 +123,155 @@ namespace gcore {
         AnimationBehaviour postState;
         
         
-        uint32_t posKeyCount;
-        uint32_t rotKeyCount;
-        uint32_t scalKeyCount;
+        uint32_t posKeyCount = 0;
+        uint32_t rotKeyCount = 0;
+        uint32_t scalKeyCount = 0;
         
-        VectorKey *posKeys;
-        QuaternionKey *rotKeys;
-        VectorKey *scalKeys;
-    
-        KeyFrame currentKeyFrame;
+        VectorKey *posKeys = nullptr;
+        QuaternionKey *rotKeys = nullptr;
+        VectorKey *scalKeys = nullptr;
+        
+        /*!
+         \brief Whether the keys are stored in the compressed tracks rather than in the key arrays.
+         */
+        bool compressed = false;
+        
+        CompressedVectorTrack posTrack;
+        CompressedQuaternionTrack rotTrack;
+        CompressedVectorTrack scalTrack;
         
-        void refreshNextKeyFrames(double t);
+        float posKeyTime(uint32_t i) const;
+        float rotKeyTime(uint32_t i) const;
+        float scalKeyTime(uint32_t i) const;
         
+        glm::vec3 posKeyValue(uint32_t i) const;
+        glm::quat rotKeyValue(uint32_t i) const;
+        glm::vec3 scalKeyValue(uint32_t i) const;
+        
+        /*!
+         \brief Finds the keys to interpolate at time \c t , applying the pre and post states out of the keys of the channel.
+         \return \c false if the affected bone is in its bind pose at time \c t , in which case \c sample is not set.
+         */
+        bool sampleKeys(double t, KeyFrame &cursor, KeySample &sample) const;
+        
+        /*!
+         \brief Replaces the keys of the channel with compressed tracks allocated in the given arena, which are decompressed when the channel is sampled.
+         \note Compression is lossy: rotations keep about 15 bits per component, translations and scales 16 bits of their range, times 16 bits of the animation duration.
+         */
+        void compress(Arena &arena);
+        
+        /*!
+         \brief Returns the size of the arena holding the compressed tracks of the channel.
+         */
+        size_t getCompressedArenaSize() const;
         
     public:
         KeyFrameChannel(Animation &animation, SkeletonBone &affectedBone) : animation(animation), affectedBone(affectedBone) {  }
         
-        ~KeyFrameChannel() {
-            if (posKeys) delete posKeys;
-            if (rotKeys) delete rotKeys;
-            if (scalKeys) delete scalKeys;
+        inline bool isCompressed() const {
+            return compressed;
         }
         
+        /*!
+         \brief Returns the size in bytes of the keys of the channel.
+         */
+        size_t getMemorySize() const;
+        
         inline SkeletonBone &getAffectedBone() const {
             return affectedBone;
         }
         
-        glm::mat4 interpolateJoint(double t);
+        /*!
+         \brief Returns the time of the first key of the channel.
+         */
+        float getStartTime() const;
+        
+        /*!
+         \brief Returns the time of the last key of the channel.
+         */
+        float getEndTime() const;
+        
+        /*!
+         \brief Interpolates the keys of the channel at time \c t , linearly for positions and scales and spherically for rotations. Out of the keys of the channel, the pre and post states apply.
+         \param cursor The keys found at the previous sample, from which the keys around \c t are searched. The result does not depend on it, only the cost of the search does.
+         \return \c false if the affected bone is in its bind pose at time \c t , in which case the transform is not set.
+         */
+        bool sampleTransform(double t, KeyFrame &cursor, glm::vec3 &position, glm::quat &rotation, glm::vec3 &scale) const;
+        
+        /*!
+         \brief Returns the transform of the affected bone at time \c t relative to its parent.
+         \see sampleTransform()
+         */
+        glm::mat4 interpolateJoint(double t, KeyFrame &cursor) const;
         
     };
     
+    /*!
+     \brief A clip animating the nodes of a skeleton. Clips are shared by the instances of a model and never modified by playback.
+     \note The channels and keys of the clip are allocated contiguously in its arena, and freed at once with the clip.
+     */
     class Animation {
         friend class Model;
+        friend class KeyFrameChannel;
         
         uint32_t animID;
         
-        double elapsed = 0;
         float totalDuration;
         
-        uint32_t keyChannelsCount;
-        KeyFrameChannel **keyChannels = nullptr;
+        Arena arena;
+        
+        uint32_t keyChannelsCount = 0;
+        KeyFrameChannel *keyChannels = nullptr;
+        
+        bool compressed = false;
+        
+        /*!
+         \brief Whether the channels have been resampled to \c frames , in which case they hold no keys.
+         */
+        bool baked = false;
+        uint32_t frameCount = 0;
+        /*!
+         \brief The number of frames per second, such that the last frame is at the end of the animation.
+         */
+        float frameRate = 0.0f;
+        /*!
+         \brief The length of each component array of a frame, which is the number of channels rounded up to a batch of lanes.
+         */
+        uint32_t frameStride = 0;
+        /*!
+         \brief The baked frames, one after the other. Each frame has the \c Pose::ComponentCount arrays of a pose, with a value for each channel rather than for each node.
+         */
+        float *frames = nullptr;
+        /*!
+         \brief Whether each channel is animated at each frame, rather than in its bind pose.
+         */
+        uint8_t *frameAnimated = nullptr;
+        
+        /*!
+         \brief The transform of each channel at time 0, which additive blending takes as the rest pose of the clip. Identity for channels in their bind pose at time 0.
+         \note The transforms are stored as the \c Pose::ComponentCount arrays of a pose, with a value for each channel.
+         */
+        std::vector<float> reference;
+        
+        /*!
+         \brief Samples the reference pose from the current keys or frames of the channels.
+         */
+        void computeReference();
+        
+        /*!
+         \brief Returns the frame preceding time \c t and the factor interpolating it with the next one.
+         */
+        void framePair(double t, uint32_t &frame, float &factor) const;
+        
+        /*!
+         \brief Returns the two frames of a channel around time \c t as keys.
+         \return \c false if the channel is in its bind pose at time \c t .
+         */
+        bool frameKeys(uint32_t channel, double t, KeySample &sample) const;
         
     public:
         Animation(uint32_t animID, float totalDuration) : animID(animID), totalDuration(totalDuration) {  }
         
-        ~Animation() {
-            delete keyChannels;
-        }
-        
         inline uint32_t getAnimationID() const {
             return animID;
         }
@@ -129,7 +280,64 @@ namespace gcore {
             return totalDuration;
         }
         
-        void update(double dt);
+        inline uint32_t getKeyChannelsCount() const {
+            return keyChannelsCount;
+        }
+        
+        /*!
+         \brief Returns a channel of the animation, which can be sampled on its own with \c KeyFrameChannel::sampleTransform() .
+         */
+        inline const KeyFrameChannel &getKeyChannel(uint32_t i) const {
+            return keyChannels[i];
+        }
+        
+        /*!
+         \brief Samples every channel at time \c t , in [0, duration], blending the transform of each animated node into \c pose .
+         \note A baked animation takes the two frames around \c t as keys, without searching, and interpolates all the channels in batches with SIMD. Raw and compressed keys are searched and interpolated channel by channel, as with \c KeyFrameChannel::sampleTransform() : the search costs more than the interpolation, and gathering the keys for SIMD made them slower to sample, so bake the animations sampled most.
+         \param cursors The \c KeyFrame of each channel, advanced to time \c t .
+         \param pose The pose receiving the transforms, with a node for each node of the skeleton. Nodes in their bind pose are left untouched.
+         \param weight The weight of the transforms, scaled by \c mask for each node.
+         \param mode How the transforms are blended. Additive transforms are taken relative to the pose of the animation at time 0.
+         \param mask If not \c nullptr , the weight of each node. The keys of the nodes with weight 0 are not searched.
+         */
+        void sample(double t, KeyFrame *cursors, Pose &pose, float weight = 1.0f, PoseBlendMode mode = PoseBlendWeighted, const BoneMask *mask = nullptr) const;
+        
+        /*!
+         \brief Compresses the keys of all the channels of the animation, moving the channels to a new arena sized for the compressed tracks.
+         \note Compression is lossy: rotations keep about 15 bits per component, translations and scales 16 bits of their range, times 16 bits of the animation duration.
+         */
+        void compress();
+        
+        inline bool isCompressed() const {
+            return compressed;
+        }
+        
+        /*!
+         \brief Resamples all the channels at a fixed rate into dense frames, replacing their keys, so that sampling indexes two frames and interpolates them without any key search.
+         \note The frames take more memory than the keys they replace unless the keys are as dense. Baking is lossy: motion between the frames is interpolated, and baking a baked animation resamples its frames. Baked animations are not compressed.
+         \param frameRate The number of frames per second, rounded up so that a frame falls on the end of the animation.
+         */
+        void bake(float frameRate);
+        
+        inline bool isBaked() const {
+            return baked;
+        }
+        
+        /*!
+         \brief Returns the number of frames per second of a baked animation, or 0 if the animation is not baked.
+         */
+        inline float getFrameRate() const {
+            return frameRate;
+        }
+        
+        inline uint32_t getFrameCount() const {
+            return frameCount;
+        }
+        
+        /*!
+         \brief Returns the size in bytes of the keys of all the channels of the animation, or of its frames if it is baked, and of its reference pose.
+         */
+        size_t getMemorySize() const;
         
     };
     
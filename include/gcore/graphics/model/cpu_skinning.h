@@ -0,0 +1,96 @@
+//
+// => gcore/graphics/model/cpu_skinning.h
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#ifndef __graphcore_graphics_model_cpu_skinning
+#define __graphcore_graphics_model_cpu_skinning
+
+#include <gcore/graphics/model/mesh_data.h>
+#include <gcore/graphics/model/model.h>
+#include <gcore/math/affine.h>
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gcore {
+    
+    class ThreadPool;
+    
+    /*!
+     \brief The vertex streams of a mesh skinned on the CPU, in any of the formats written by the FDMD loader.
+     \note Positions are restored with \c quantization , as the shaders do. Bone IDs and weights are read as \c MAX_WEIGHTS_PER_VERTEX values per vertex.
+     */
+    struct SkinningSource {
+        size_t vertexCount = 0;
+        /*!
+         \brief The number of joints in the palettes the vertices are skinned with. Bone IDs past the last joint are clamped to it as they are decoded.
+         */
+        uint32_t jointCount = 0;
+        
+        VertexStream positions;
+        /*!
+         \brief The normals of the vertices, or a stream without data if only the positions are skinned.
+         */
+        VertexStream normals;
+        VertexStream boneIDs;
+        VertexStream boneWeights;
+        
+        MeshQuantization quantization;
+        
+        /*!
+         \brief Returns the streams of the given mesh, which must outlive the source.
+         \param jointCount The number of joints of the skeleton the mesh is bound to.
+         */
+        static SkinningSource fromMeshData(const MeshData &mesh, uint32_t jointCount, const MeshQuantization &quantization = MeshQuantization());
+    };
+    
+    /*!
+     \brief The number of vertices skinned by each task when the vertices are split across threads.
+     */
+    static constexpr size_t SkinningChunkSize = 4096;
+    
+    /*!
+     \brief Skins a range of vertices one at a time with scalar code, blending the joints of each vertex as affine matrices.
+     \note This is the reference \c skinVertices() is checked against. Normals are transformed by the blended matrix, which is exact for rigid and uniformly scaled joints, and renormalized.
+     \param joints The joint palette, as computed by \c Skeleton::computeJoints() , with \c source.jointCount joints. Nothing is skinned if the source has no joints.
+     \param positions The skinned positions of the range, 3 floats per vertex.
+     \param normals The skinned normals of the range, 3 floats per vertex, or \c nullptr to skip the normals.
+     */
+    void skinVerticesReference(const SkinningSource &source, const Affine3x4 *joints, size_t first, size_t count, float *positions, float *normals);
+    
+    /*!
+     \brief Skins all the vertices of \c source with SIMD, splitting them in chunks of \c SkinningChunkSize vertices across the threads of \c pool .
+     \note The streams are decoded a block at a time, and the palette is transposed once per call into columns, so that each vertex blends its joints and transforms its position with vector multiply-adds only.
+     \param joints The joint palette, with \c source.jointCount joints. Nothing is skinned if the source has no joints.
+     \param positions The skinned positions, 3 floats per vertex.
+     \param normals The skinned normals, 3 floats per vertex, or \c nullptr to skip the normals.
+     \param pool The pool running the chunks, or \c nullptr to skin all the vertices on the calling thread.
+     */
+    void skinVertices(const SkinningSource &source, const Affine3x4 *joints, float *positions, float *normals, ThreadPool *pool = nullptr);
+    
+}
+
+#endif
@@ -27,6 +27,8 @@
 #ifndef __graphcore_graphics_fdmd_format
 #define __graphcore_graphics_fdmd_format
 
+#include <gcore/io/byte_order.h>
+
 #include <cstdint>
 
 /*!
@@ -34,6 +36,19 @@
  */
 #define MAX_WEIGHTS_PER_VERTEX 4
 
+/*!
+ \brief The four bytes every FDMD file starting from version 2 begins with.
+ */
+#define FDMD_MAGIC "FDMD"
+/*!
+ \brief The latest version of the FDMD file format.
+ */
+#define FDMD_VERSION 2
+/*!
+ \brief The alignment in bytes of every section in a FDMD v2 file.
+ */
+#define FDMD_SECTION_ALIGNMENT 16
+
 namespace gcore {
     
     /*!
@@ -59,7 +74,11 @@ namespace gcore {
         FDMDModelVertexAttribTexCoord3 = 4,
         FDMDModelVertexAttribColor = 5,
         FDMDModelVertexAttribBoneID = 6,
-        FDMDModelVertexAttribBoneWeight = 7
+        FDMDModelVertexAttribBoneWeight = 7,
+        /*!
+         \brief The triangle list indexing the vertices of the mesh. In v1 files the record is the number of indices (4 bytes), the size of each index (1 byte, either 2 or 4) and the indices; in v2 files it is a vertex data section whose \c count is the number of indices.
+         */
+        FDMDModelVertexAttribIndex = 8
     } FDMDVertexAttrib;
     
     /*!
@@ -72,6 +91,186 @@ namespace gcore {
     } FDMDSkeletonNode;
     
     
+    /*!
+     \brief Values indicating the contents of a section in a FDMD v2 file.
+     \warning NEVER CHANGE THE VALUES SINCE THEY CONFORM TO THE FDMD FILE FORMAT SPECIFICATION.
+     */
+    typedef enum : uint8_t {
+        /*!
+         \brief Declares the mesh with ID \c index and \c count vertices. The vertex data is stored in the \c FDMDSectionVertexData sections with the same \c index ; the payload, if any, is a \c FDMDMeshQuantization .
+         */
+        FDMDSectionMesh = 1,
+        /*!
+         \brief The skeleton of the model, encoded as the v1 skeleton record (big endian).
+         */
+        FDMDSectionSkeleton = 2,
+        /*!
+         \brief The animation with ID \c index , encoded as the v1 animation record (big endian).
+         */
+        FDMDSectionAnimation = 3,
+        /*!
+         \brief A tightly packed, little endian array with the values of the vertex attribute \c attrib for the \c count vertices of the mesh \c index , ready to be uploaded as it is.
+         */
+        FDMDSectionVertexData = 4
+    } FDMDSectionType;
+    
+    /*!
+     \brief Values indicating the type of each component of the values stored in a FDMD v2 vertex data section.
+     \warning NEVER CHANGE THE VALUES SINCE THEY CONFORM TO THE FDMD FILE FORMAT SPECIFICATION.
+     */
+    typedef enum : uint8_t {
+        FDMDFormatFloat32 = 0,
+        FDMDFormatUInt32 = 1,
+        FDMDFormatUInt16 = 2,
+        /*!
+         \brief IEEE 754 half-precision floats.
+         */
+        FDMDFormatFloat16 = 3,
+        /*!
+         \brief 16-bit signed integers, mapped to [-1, 1].
+         */
+        FDMDFormatSNorm16 = 4,
+        /*!
+         \brief 16-bit unsigned integers, mapped to [0, 1].
+         */
+        FDMDFormatUNorm16 = 5,
+        FDMDFormatUInt8 = 6,
+        /*!
+         \brief 8-bit unsigned integers, mapped to [0, 1].
+         */
+        FDMDFormatUNorm8 = 7,
+        /*!
+         \brief Four components packed in a 32-bit word: 10 bits each for the first three, 2 bits for the fourth, all signed and mapped to [-1, 1]. \c components is always 4.
+         */
+        FDMDFormatSNorm2_10_10_10 = 8
+    } FDMDComponentFormat;
+    
+    /*!
+     \brief Returns the size in bytes of the words of the given format, which is what their byte order is swapped by.
+     */
+    inline size_t fdmdFormatWordSize(uint8_t format) {
+        switch (format) {
+            case FDMDFormatUInt16:
+            case FDMDFormatFloat16:
+            case FDMDFormatSNorm16:
+            case FDMDFormatUNorm16:
+                return 2;
+            case FDMDFormatUInt8:
+            case FDMDFormatUNorm8:
+                return 1;
+            default:
+                return 4;
+        }
+    }
+    
+    /*!
+     \brief The payload of a FDMD v2 mesh section whose positions are quantized (little endian). Positions are stored in [-1, 1] and restored as \c offset + \c scale * \c position .
+     \note Mesh sections without a payload have positions stored as they are.
+     \warning NEVER CHANGE THE LAYOUT SINCE IT CONFORMS TO THE FDMD FILE FORMAT SPECIFICATION.
+     */
+    struct FDMDMeshQuantization {
+        float positionOffset[3];
+        float positionScale[3];
+    };
+    
+    /*!
+     \brief The header at the beginning of a FDMD v2 file. All the fields are little endian.
+     \warning NEVER CHANGE THE LAYOUT SINCE IT CONFORMS TO THE FDMD FILE FORMAT SPECIFICATION.
+     */
+    struct FDMDHeader {
+        /*!
+         \brief Always \c FDMD_MAGIC .
+         */
+        char magic[4];
+        uint16_t version;
+        uint16_t flags;
+        uint32_t sectionCount;
+        uint32_t meshCount;
+        uint32_t animCount;
+        uint32_t reserved;
+        /*!
+         \brief The offset of the section table from the beginning of the header.
+         */
+        uint64_t sectionTableOffset;
+    };
+    
+    /*!
+     \brief An entry of the section table of a FDMD v2 file. All the fields are little endian.
+     \warning NEVER CHANGE THE LAYOUT SINCE IT CONFORMS TO THE FDMD FILE FORMAT SPECIFICATION.
+     */
+    struct FDMDSectionEntry {
+        /*!
+         \brief One of the \c FDMDSectionType values.
+         */
+        uint8_t type;
+        /*!
+         \brief For vertex data sections, one of the \c FDMDVertexAttrib values.
+         */
+        uint8_t attrib;
+        /*!
+         \brief For vertex data sections, one of the \c FDMDComponentFormat values.
+         */
+        uint8_t format;
+        /*!
+         \brief For vertex data sections, the number of components of each value.
+         */
+        uint8_t components;
+        /*!
+         \brief The ID of the mesh or animation the section belongs to.
+         */
+        uint32_t index;
+        /*!
+         \brief The number of vertices of the mesh the section belongs to, or the number of indices for index data.
+         */
+        uint32_t count;
+        /*!
+         \brief For vertex data sections, the set the attribute belongs to (e.g. the texture index of texture coordinates).
+         */
+        uint32_t set;
+        /*!
+         \brief The offset of the section payload from the beginning of the header. Always a multiple of \c FDMD_SECTION_ALIGNMENT .
+         */
+        uint64_t offset;
+        /*!
+         \brief The size in bytes of the section payload.
+         */
+        uint64_t size;
+    };
+    
+    static_assert(sizeof(FDMDHeader) == 32, "FDMD v2 header must be 32 bytes long");
+    static_assert(sizeof(FDMDSectionEntry) == 32, "FDMD v2 section entries must be 32 bytes long");
+    static_assert(sizeof(FDMDMeshQuantization) == 24, "FDMD v2 mesh quantization must be 24 bytes long");
+    
+    /*!
+     \brief Converts the fields of the given header between little endian and the byte order of the host.
+     */
+    inline void fdmdSwapToHost(FDMDHeader &header) {
+        if (isLittleEndianHost()) {
+            return;
+        }
+        header.version = byteSwap16(header.version);
+        header.flags = byteSwap16(header.flags);
+        header.sectionCount = byteSwap32(header.sectionCount);
+        header.meshCount = byteSwap32(header.meshCount);
+        header.animCount = byteSwap32(header.animCount);
+        header.reserved = byteSwap32(header.reserved);
+        header.sectionTableOffset = byteSwap64(header.sectionTableOffset);
+    }
+    
+    /*!
+     \brief Converts the fields of the given section entry between little endian and the byte order of the host.
+     */
+    inline void fdmdSwapToHost(FDMDSectionEntry &entry) {
+        if (isLittleEndianHost()) {
+            return;
+        }
+        entry.index = byteSwap32(entry.index);
+        entry.count = byteSwap32(entry.count);
+        entry.set = byteSwap32(entry.set);
+        entry.offset = byteSwap64(entry.offset);
+        entry.size = byteSwap64(entry.size);
+    }
+    
     class FDMDLoader {
         
         
@@ -0,0 +1,149 @@
+//
+// => gcore/graphics/model/mesh_data.h
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef __graphcore_graphics_model_mesh_data
+#define __graphcore_graphics_model_mesh_data
+
+#include <gcore/graphics/opengl.h>
+#include <gcore/io/bin_istream.h>
+
+#include <vector>
+
+namespace gcore {
+    
+    /*!
+     \brief The values of a vertex attribute as laid out in a vertex buffer.
+     */
+    struct VertexStream {
+        /*!
+         \brief The value of the first vertex, or \c nullptr if the mesh has no such attribute.
+         */
+        const void *data = nullptr;
+        GLint components = 0;
+        GLenum type = GL_FLOAT;
+        GLboolean normalized = GL_FALSE;
+        /*!
+         \brief The distance in bytes between the values of two consecutive vertices.
+         */
+        size_t stride = 0;
+    };
+    
+    /*!
+     \brief The vertex data of a mesh on the CPU side, collected while the mesh is decoded and uploaded to a \c VertexArrayObject afterwards.
+     \note Everything but \c upload() makes no OpenGL calls, so meshes can be decoded on any thread and uploaded later by the thread owning the context.
+     */
+    class MeshData {
+        
+        struct Stream {
+            GLuint location;
+            GLint components;
+            GLenum type;
+            GLboolean normalized;
+            bool integer;
+            const void *data;
+            std::vector<byte_t> storage;
+            
+            inline size_t elementSize() const {
+                return glAttribSize(components, type);
+            }
+            
+            inline const byte_t *bytes() const {
+                return data ? (const byte_t *)data : storage.data();
+            }
+        };
+        
+        /*!
+         \brief A vertex buffer ready to be uploaded.
+         */
+        struct Buffer {
+            VertexLayout layout;
+            const void *data;
+            std::vector<byte_t> storage;
+            
+            inline const void *bytes() const {
+                return data ? data : storage.data();
+            }
+        };
+        
+        size_t vertexCount;
+        
+        std::vector<Stream> streams;
+        std::vector<Buffer> buffers;
+        
+        size_t indexCount = 0;
+        GLenum indexType = GL_UNSIGNED_INT;
+        const void *indexData = nullptr;
+        std::vector<byte_t> indexStorage;
+        
+    public:
+        explicit MeshData(size_t vertexCount) : vertexCount(vertexCount) {  }
+        
+        inline size_t getVertexCount() const {
+            return vertexCount;
+        }
+        
+        /*!
+         \brief Adds an attribute stream to the mesh.
+         \param data The vertex data, which must stay valid until \c upload() is called, or \c nullptr to let the mesh allocate it.
+         \return The storage of the stream, to be filled by the caller, or \c nullptr if \c data was given.
+         */
+        void *addAttrib(GLuint location, GLint components, GLenum type, GLboolean normalized, bool integer, const void *data = nullptr);
+        
+        /*!
+         \brief Sets the index buffer of the mesh, with the same ownership rules as \c addAttrib() .
+         */
+        void *setIndices(size_t count, GLenum type, const void *data = nullptr);
+        
+        /*!
+         \brief Lays out the attribute streams in the vertex buffers to upload: a single interleaved buffer if \c interleave is set, a buffer per stream otherwise.
+         */
+        void build(bool interleave);
+        
+        /*!
+         \brief Uploads the vertex buffers laid out by \c build() and the index buffer to the given vertex array, binding it.
+         */
+        void upload(VertexArrayObject &theVAO) const;
+        
+        /*!
+         \brief Returns the size in bytes of the vertex and index buffers laid out by \c build() .
+         */
+        size_t getUploadSize() const;
+        
+        /*!
+         \brief Returns the values of the attribute at the given location, in the streams added to the mesh or in the buffers laid out by \c build() .
+         */
+        VertexStream getAttrib(GLuint location) const;
+        
+        /*!
+         \brief Copies into the mesh the vertex and index data it refers to, so that the mesh can be kept once the stream it was decoded from is closed.
+         */
+        void detach();
+        
+    };
+    
+}
+
+#endif
@@ -28,49 +28,335 @@
 #define __graphcore_graphics_model
 
 #include <gcore/graphics/opengl.h>
+#include <gcore/graphics/render_queue.h>
 #include <gcore/graphics/model/skeleton.h>
 #include <gcore/graphics/model/animation.h>
+#include <gcore/graphics/model/mesh_data.h>
+#include <gcore/io/bin_istream.h>
 
 #include <vector>
 
 namespace gcore {
     
+    class ThreadPool;
+    class ModelLoader;
+    
+    /*!
+     \brief Options controlling how the data of a model is uploaded when the model is loaded.
+     */
+    struct ModelLoadOptions {
+        /*!
+         \brief Whether the vertex attributes of each mesh are interleaved into a single vertex buffer, rather than being uploaded to a buffer each.
+         \note Interleaved vertices need fewer buffers and binds per mesh and are fetched with better locality, at the cost of a copy at load time.
+         */
+        bool interleaveVertices = true;
+        
+        /*!
+         \brief Whether bone IDs and weights stored as 32-bit values are packed to 8-bit integers and 8-bit normalized weights when uploaded.
+         \note Bone IDs are packed only if they all fit in a byte.
+         */
+        bool packBoneData = true;
+        
+        /*!
+         \brief Whether the key frames of the animations are stored compressed and decompressed when they are sampled.
+         \see Animation::compress()
+         */
+        bool compressAnimations = true;
+        
+        /*!
+         \brief Whether the animations are only located when the model is loaded, and read the first time they are requested with \c Model::getAnimation() .
+         \note Only models loaded with \c Model::fromFile() load animations on demand, since the model keeps the file open to read them.
+         */
+        bool lazyAnimations = true;
+        
+        /*!
+         \brief If greater than 0, the number of frames per second at which the animations are resampled when they are loaded, replacing their keys. Baked animations are not compressed.
+         \note The rate can be changed for each animation with \c Model::setAnimationFrameRate() .
+         \see Animation::bake()
+         */
+        float animationFrameRate = 0.0f;
+        
+        /*!
+         \brief Whether the decoded vertex data of each mesh is kept once the mesh is uploaded, e.g. to skin the meshes on the CPU.
+         \see Model::getMeshData()
+         */
+        bool keepMeshData = false;
+        
+        /*!
+         \brief Whether the meshes are uploaded to the GPU as the model is loaded by \c Model::fromFile() or \c Model::fromStream() . Otherwise no OpenGL call is issued until \c Model::uploadMeshes() , so that a model can be loaded without a current context, e.g. to skin it on the CPU or to time the decoding alone.
+         \note \c ModelLoader always uploads the meshes, in its own time.
+         */
+        bool uploadMeshes = true;
+    };
+    
+    /*!
+     \brief Parameters restoring the positions of a mesh stored in [-1, 1] as \c positionOffset + \c positionScale * \c position .
+     \note The two vectors are contiguous so that they can be uploaded to a \c vec3[2] uniform at once.
+     */
+    struct MeshQuantization {
+        GLfloat positionOffset[3] = { 0.0f, 0.0f, 0.0f };
+        GLfloat positionScale[3] = { 1.0f, 1.0f, 1.0f };
+    };
+    
     /*!
-     \brief Class implementing an imported model, keeping all the data needed to draw, as well as methods for drawing the model in the current context.
+     \brief Class implementing an imported model, keeping all the data needed to draw it: the vertex buffers, the skeleton and the animations.
+     \note A model is a resource shared by all the \c ModelInstance objects drawing it, which keep the animation state. Playing an animation never modifies the model.
      */
     class Model {
         
         uint32_t meshCount;
         VertexArrayObject **vaos;
+        MeshQuantization *quantizations = nullptr;
         
+        /*!
+         \brief The decoded vertex data of each mesh, kept until the mesh is uploaded.
+         */
+        std::vector<MeshData> meshData;
+        uint32_t uploadedMeshes = 0;
+        size_t gpuMemory = 0;
+    
+        Skeleton *_skeleton = nullptr;
+        JointPaletteFormat jointPaletteFormat = JointPaletteMat4;
         
+        uint32_t _animCount = 0;
+        Animation **_animations = nullptr;
         
+        /*!
+         \brief The position of each animation in \c animationSource , or 0 if the animation was loaded with the model.
+         */
+        uint64_t *_animationOffsets = nullptr;
+        /*!
+         \brief The value of \c animationClock when each animation was last requested.
+         */
+        uint64_t *_animationLastUse = nullptr;
+        uint64_t animationClock = 0;
+        /*!
+         \brief The rate at which each animation is baked when it is loaded, or 0 if it keeps its keys.
+         */
+        float *_animationFrameRates = nullptr;
         
+        BinaryInputStream *animationSource = nullptr;
+        ModelLoadOptions loadOptions;
         
+        size_t animationBudget = 0;
+        size_t animationMemory = 0;
         
+        Model() {  }
         
-        Skeleton *_skeleton;
+        static Model *read(BinaryInputStream &is, const ModelLoadOptions &options);
         
-        uint32_t _animCount;
-        Animation **_animations;
+        /*!
+         \brief Decodes the model from the stream without issuing any OpenGL call, so that it can run on any thread.
+         \param pool If not \c nullptr , the meshes and animations of a v2 file are decoded in parallel on the pool.
+         \warning Meshes may refer to the mapping of the stream until they are uploaded, so the stream must be kept open until then.
+         */
+        static Model *decode(BinaryInputStream &is, const ModelLoadOptions &options, ThreadPool *pool);
         
-        Model() {  }
+        static Model *decodeV1(BinaryInputStream &is, const ModelLoadOptions &options);
+        
+        static Model *decodeV2(BinaryInputStream &is, const ModelLoadOptions &options, ThreadPool *pool);
+        
+        /*!
+         \brief Uploads the next decoded mesh to a new VAO, freeing its decoded data.
+         \return Whether there are meshes left to upload.
+         */
+        bool uploadNextMesh();
+        
+        /*!
+         \brief Takes ownership of the stream the model was decoded from if animations are left to load from it or meshes are left to upload, which may point into its mapping, deleting it otherwise.
+         */
+        void adoptAnimationSource(BinaryInputStream *is);
+        
+        static Skeleton *readSkeleton(BinaryInputStream &is);
+        
+        static Animation *readAnimation(BinaryInputStream &is, Skeleton *skel);
+        
+        /*!
+         \brief Skips the v1 animation record at the current position of the stream.
+         \param arenaSize If not \c nullptr , receives the size of the arena holding the decoded animation.
+         \return The ID of the skipped animation.
+         */
+        static uint32_t skipAnimation(BinaryInputStream &is, size_t *arenaSize = nullptr);
+        
+        /*!
+         \brief Bakes a newly read animation at \c frameRate if it is greater than 0, and compresses it otherwise if the options say so.
+         */
+        static void prepareAnimation(Animation &anim, const ModelLoadOptions &options, float frameRate);
+        
+        /*!
+         \brief Unloads the least recently requested animations until the ones loaded on demand fit the budget, never unloading \c keep .
+         */
+        void evictAnimations(uint32_t keep);
+        
+        friend class ModelLoader;
         
     public:
         ~Model() {
-            delete vaos;
+            for (uint32_t i = 0; i < meshCount; i++) {
+                delete vaos[i];
+            }
+            delete[] vaos;
+            delete[] quantizations;
             
+            delete _skeleton;
             
-
-            delete _animations;
+            for (uint32_t i = 0; i < _animCount; i++) {
+                delete _animations[i];
+            }
+            delete[] _animations;
+            delete[] _animationOffsets;
+            delete[] _animationLastUse;
+            delete[] _animationFrameRates;
+            delete animationSource;
+        }
+        
+        /*!
+         \brief Draws all the meshes of the model with the current shader program, in the pose whose joints are currently uploaded.
+         \param positionDequantizationUniform The location of the \c vec3[2] uniform receiving the \c MeshQuantization of each mesh, or -1 if the shader does not restore quantized positions. Meshes with quantized positions, as written by default by collada2bin, need it.
+         \see ModelInstance::draw()
+         */
+        void drawMeshes(GLint positionDequantizationUniform) const;
+        
+        /*!
+         \brief Draws \c instanceCount instances of all the meshes of the model with the current shader program, with an instanced draw call per mesh.
+         \param positionDequantizationUniform The location of the \c vec3[2] uniform receiving the \c MeshQuantization of each mesh, or -1 if the shader does not restore quantized positions. Meshes with quantized positions, as written by default by collada2bin, need it.
+         \see InstanceBatch
+         */
+        void drawMeshesInstanced(GLsizei instanceCount, GLint positionDequantizationUniform) const;
+        
+        /*!
+         \brief Adds a draw of each uploaded mesh of the model to \c queue , as a copy of \c item with the vertex array of the mesh and the index of the mesh as \c RenderItem::index .
+         \note The uniforms of each mesh, such as its \c MeshQuantization , are set by \c item.setUniforms .
+         */
+        void queueMeshes(RenderQueue &queue, const RenderItem &item, float depth = 0.0f) const;
+        
+        /*!
+         \brief Returns the skeleton of the model, or \c nullptr if the model is static.
+         */
+        inline const Skeleton *getSkeleton() const {
+            return _skeleton;
+        }
+        
+        /*!
+         \brief Sets the format of the joint palettes of the instances of the model, which the shaders drawing the model must read. Instances switch format at their next update.
+         \note Smaller formats cut the palette upload: 3x4 affine matrices by 25%, dual quaternions by 50%, at the cost of the scale of the joints.
+         */
+        inline void setJointPaletteFormat(JointPaletteFormat format) {
+            jointPaletteFormat = format;
+        }
+        
+        inline JointPaletteFormat getJointPaletteFormat() const {
+            return jointPaletteFormat;
+        }
+        
+        inline uint32_t getMeshCount() const {
+            return meshCount;
         }
         
-        void update(double dt);
+        /*!
+         \brief Returns the decoded vertex data of a mesh, or \c nullptr once the mesh is uploaded unless the model was loaded with \c ModelLoadOptions::keepMeshData .
+         */
+        inline const MeshData *getMeshData(uint32_t mesh) const {
+            return mesh < meshData.size() && meshData[mesh].getVertexCount() > 0 ? &meshData[mesh] : nullptr;
+        }
+        
+        /*!
+         \brief Returns the parameters restoring the quantized positions of a mesh.
+         */
+        inline const MeshQuantization &getMeshQuantization(uint32_t mesh) const {
+            return quantizations[mesh];
+        }
+        
+        /*!
+         \brief Returns whether all the meshes of the model have been uploaded to the GPU.
+         */
+        inline bool isUploaded() const {
+            return uploadedMeshes == meshCount;
+        }
+        
+        /*!
+         \brief Uploads the meshes left to upload, for a model loaded without \c ModelLoadOptions::uploadMeshes . An OpenGL context must be current.
+         */
+        void uploadMeshes();
+        
+        inline uint32_t getAnimationCount() const {
+            return _animCount;
+        }
+        
+        /*!
+         \brief Returns the animation with the given ID, reading it from the model file if it is not loaded yet.
+         \warning If an animation budget is set, requesting an animation may unload others: pointers to animations other than the returned one can be invalidated.
+         \return The animation, or \c nullptr if the model has no animation with that ID or the animation could not be read.
+         */
+        Animation *getAnimation(uint32_t animID);
+        
+        /*!
+         \brief Returns whether the animation with the given ID is loaded in memory.
+         */
+        inline bool isAnimationLoaded(uint32_t animID) const {
+            return animID < _animCount && _animations[animID];
+        }
+        
+        /*!
+         \brief Sets the memory budget, in bytes, for the animations loaded on demand. When they exceed it, the least recently requested ones are unloaded, to be read again when requested.
+         \note A budget of 0 (the default) keeps every animation loaded once requested.
+         */
+        void setAnimationBudget(size_t bytes);
+        
+        inline size_t getAnimationBudget() const {
+            return animationBudget;
+        }
+        
+        /*!
+         \brief Sets the number of frames per second at which the animation with the given ID is baked, or 0 to keep its keys.
+         \note An animation loaded on demand is unloaded, to be read and baked at the new rate when requested again. Other animations are baked in place, resampling their current keys or frames, and keep their frames when the rate is set to 0.
+         \warning Pointers to the animation can be invalidated.
+         */
+        void setAnimationFrameRate(uint32_t animID, float frameRate);
+        
+        inline float getAnimationFrameRate(uint32_t animID) const {
+            return animID < _animCount ? _animationFrameRates[animID] : 0.0f;
+        }
+        
+        /*!
+         \brief Returns the memory currently used by the key frames of the animations loaded on demand.
+         */
+        inline size_t getAnimationMemory() const {
+            return animationMemory;
+        }
+        
+        /*!
+         \brief Returns the memory used by the vertex and index buffers uploaded so far.
+         */
+        inline size_t getGPUMemorySize() const {
+            return gpuMemory;
+        }
+        
+        /*!
+         \brief Returns the memory used by the key frames of all the animations currently loaded, whether on demand or with the model.
+         */
+        size_t getCPUMemorySize() const;
+        
         
-        void draw(GLint jointsUniform);
+        /*!
+         \brief Loads the model stored in the FDMD file at the given path, reading it through a memory mapped stream.
+         \return The newly loaded model, or \c nullptr if the file could not be opened.
+         */
+        static Model *fromFile(const char *fileName, const ModelLoadOptions &options = ModelLoadOptions());
         
+        /*!
+         \brief Loads the model stored in the FDMD file at the given path, reading it through a stream opened with \c streamOptions , which the model keeps to load its animations on demand.
+         \return The newly loaded model, or \c nullptr if the file could not be opened.
+         */
+        static Model *fromFile(const char *fileName, const BinaryInputStreamOptions &streamOptions, const ModelLoadOptions &options = ModelLoadOptions());
         
-        static Model *fromFile(const char *fileName);
+        /*!
+         \brief Loads the model stored in FDMD format from the given stream, starting at its current position.
+         \note Use this to choose how the file is read (e.g. a prefetched stream for cold loads) and to inspect the stream stall time afterwards. All the animations are loaded, since the stream is not owned by the model.
+         \warning Without \c ModelLoadOptions::uploadMeshes , the meshes may point into the mapping of the stream until they are uploaded, so the stream must be kept open until then.
+         \return The newly loaded model, or \c nullptr if the stream is not ready to be read.
+         */
+        static Model *fromStream(BinaryInputStream &is, const ModelLoadOptions &options = ModelLoadOptions());
         
     };
     
@@ -0,0 +1,262 @@
+//
+// => gcore/graphics/model/model_instance.h
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef __graphcore_graphics_model_model_instance
+#define __graphcore_graphics_model_model_instance
+
+#include <gcore/graphics/opengl.h>
+#include <gcore/graphics/model/model.h>
+
+#include <glm/glm.hpp>
+
+#include <vector>
+
+namespace gcore {
+    
+    /*!
+     \brief A clip played by a \c ModelInstance , blended into the pose left by the layers below it.
+     */
+    struct AnimationLayer {
+        uint32_t animID = 0;
+        double elapsed = 0;
+        /*!
+         \brief The position in the keys of each channel of the clip.
+         */
+        std::vector<KeyFrame> cursors;
+        
+        /*!
+         \brief The clip fading out while \c fade goes from 0 to 1 during a crossfade.
+         */
+        uint32_t previousAnimID = 0;
+        double previousElapsed = 0;
+        std::vector<KeyFrame> previousCursors;
+        float fade = 1.0f;
+        /*!
+         \brief The change of \c fade per second.
+         */
+        float fadeSpeed = 0.0f;
+        
+        float weight = 1.0f;
+        /*!
+         \brief The weight reached at \c weightSpeed per second, when the weight is faded.
+         */
+        float targetWeight = 1.0f;
+        float weightSpeed = 0.0f;
+        
+        PoseBlendMode mode = PoseBlendWeighted;
+        /*!
+         \brief The weight of the layer for each node, or \c nullptr to affect all the nodes. The mask must outlive the layer.
+         */
+        const BoneMask *mask = nullptr;
+    };
+    
+    /*!
+     \brief An occurrence of a model in the scene, keeping only the state of its animation: the layers of clips being played and the joint palette.
+     \note Any number of instances can share a model, which must outlive them. Instances of the same model must be updated from one thread at a time, since animations may be loaded on demand.
+     */
+    class ModelInstance {
+        
+        Model &model;
+        
+        /*!
+         \brief The layers, blended from the first one up. An instance starts with a layer playing animation 0.
+         */
+        std::vector<AnimationLayer> layers;
+        /*!
+         \brief The joint palette streamed by \c streamJoints() , as \c jointPaletteTexels() \c vec4 per bone.
+         */
+        std::vector<glm::vec4> palette;
+        JointPaletteFormat paletteFormat = JointPaletteMat4;
+        /*!
+         \brief The offset of the palette in the region of the frame of the \c StreamBuffer it was last streamed to.
+         */
+        size_t paletteOffset = 0;
+        
+        /*!
+         \brief Computes the joint palette of the given pose in the palette format of the model.
+         */
+        void computePalette(const Affine3x4 *nodeTransforms);
+        
+    public:
+        explicit ModelInstance(Model &model);
+        
+        inline Model &getModel() const {
+            return model;
+        }
+        
+        /*!
+         \brief Returns the ID of the animation played by the first layer.
+         */
+        inline uint32_t getAnimationID() const {
+            return layers[0].animID;
+        }
+        
+        inline double getElapsed() const {
+            return layers[0].elapsed;
+        }
+        
+        inline uint32_t getLayerCount() const {
+            return (uint32_t)layers.size();
+        }
+        
+        inline const AnimationLayer &getLayer(uint32_t layer) const {
+            return layers[layer];
+        }
+        
+        /*!
+         \brief Starts playing the animation with the given ID from the beginning on a layer, replacing its clip at once.
+         */
+        void play(uint32_t animID, uint32_t layer = 0);
+        
+        /*!
+         \brief Starts playing the animation with the given ID from the beginning on a layer, fading out the clip it plays over \c duration seconds.
+         \note The two clips keep playing during the fade, and are blended with the layer as a single clip. A crossfade started during another one drops the clip fading out.
+         */
+        void crossfade(uint32_t animID, double duration, uint32_t layer = 0);
+        
+        /*!
+         \brief Adds a layer on top of the others, playing the animation with the given ID from the beginning.
+         \param mask The weight of the layer for each node, or \c nullptr to affect all the nodes. The mask must outlive the layer.
+         \return The index of the new layer.
+         */
+        uint32_t addLayer(uint32_t animID, PoseBlendMode mode = PoseBlendWeighted, float weight = 1.0f, const BoneMask *mask = nullptr);
+        
+        /*!
+         \brief Removes a layer, moving down the layers above it. The first layer cannot be removed.
+         */
+        void removeLayer(uint32_t layer);
+        
+        /*!
+         \brief Sets the weight of a layer, reaching it linearly over \c duration seconds.
+         */
+        void setLayerWeight(uint32_t layer, float weight, double duration = 0);
+        
+        /*!
+         \brief Advances the layers by \c dt seconds and updates the joint palette, blending the clips of all the layers in a single pass over a pose.
+         \note Clips loop. Layers with weight 0 are not sampled.
+         */
+        void update(double dt);
+        
+        /*!
+         \brief Writes the joint palette of the instance to the current frame of \c palettes , to be drawn with \c draw(const StreamBuffer &, GLint, GLint) .
+         \note The palettes of all the instances drawn in a frame share the stream, so they are uploaded at once; stream them all before drawing any.
+         */
+        void streamJoints(StreamBuffer &palettes);
+        
+        /*!
+         \brief Draws the meshes of the model with the current shader program, reading the joint palette last streamed to \c palettes .
+         \note The shader reads the palette from the buffer texture of \c palettes , bound by the caller once per frame, as \c jointPaletteTexels() \c vec4 texels per joint.
+         \param paletteOffsetUniform The location of the \c int uniform receiving the index of the first texel of the palette.
+         \param positionDequantizationUniform The location of the \c vec3[2] uniform receiving the \c MeshQuantization of each mesh, or -1 if the shader does not restore quantized positions. Meshes with quantized positions, as written by default by collada2bin, need it.
+         */
+        void draw(const StreamBuffer &palettes, GLint paletteOffsetUniform, GLint positionDequantizationUniform) const;
+        
+        /*!
+         \brief Returns the joint palette as matrices, holding a matrix for each bone of the skeleton, or \c nullptr if the palette is in another format.
+         */
+        inline const glm::mat4 *getJoints() const {
+            return paletteFormat == JointPaletteMat4 ? reinterpret_cast<const glm::mat4 *>(palette.data()) : nullptr;
+        }
+        
+        /*!
+         \brief Returns the joint palette, as \c jointPaletteTexels() \c vec4 for each bone in the format returned by \c getPaletteFormat() .
+         */
+        inline const glm::vec4 *getPalette() const {
+            return palette.data();
+        }
+        
+        inline JointPaletteFormat getPaletteFormat() const {
+            return paletteFormat;
+        }
+        
+        /*!
+         \brief Returns the offset of the palette in the region of the current frame of the \c StreamBuffer it was last streamed to.
+         */
+        inline size_t getPaletteOffset() const {
+            return paletteOffset;
+        }
+        
+        /*!
+         \brief Returns the memory used by the instance, in bytes.
+         */
+        size_t getMemorySize() const;
+        
+    };
+    
+    /*!
+     \brief Instances of the same model drawn together, with an instanced draw call per mesh of the model rather than a draw per mesh and instance.
+     \note Each instance has a record of \c RecordTexels texels in the \c StreamBuffer receiving the palettes: the three rows of its model matrix as an \c Affine3x4 , then the offset of its palette from the first record, in texels, as the first component. The shaders fetch the record at \c instanceOffset + \c gl_InstanceID * \c RecordTexels . Offsets are relative so that they stay valid if the buffer grows during the frame.
+     */
+    class InstanceBatch {
+        
+        Model &model;
+        
+        uint32_t instanceCount = 0;
+        /*!
+         \brief The offset of the first record in the region of the frame of the \c StreamBuffer the batch was last streamed to.
+         */
+        size_t recordsOffset = 0;
+        
+    public:
+        static constexpr uint32_t RecordTexels = 4;
+        
+        explicit InstanceBatch(Model &model) : model(model) {  }
+        
+        inline Model &getModel() const {
+            return model;
+        }
+        
+        inline uint32_t getInstanceCount() const {
+            return instanceCount;
+        }
+        
+        /*!
+         \brief Returns the index of the texel of the first record in \c palettes , to which the instances were last streamed.
+         */
+        inline GLint getInstanceOffset(const StreamBuffer &palettes) const {
+            return (GLint)((palettes.getRegionOffset() + recordsOffset) / sizeof(glm::vec4));
+        }
+        
+        /*!
+         \brief Streams the joint palette of each instance and the records of the batch to the current frame of \c palettes , replacing the instances streamed before.
+         \param instances The instances to draw, all instances of the model of the batch.
+         \param modelMatrices The transform of each instance relative to the world, taken as affine.
+         */
+        void stream(StreamBuffer &palettes, ModelInstance *const *instances, const glm::mat4 *modelMatrices, uint32_t count);
+        
+        /*!
+         \brief Draws the instances last streamed to \c palettes with the current shader program.
+         \note As with \c ModelInstance::draw(const StreamBuffer &, GLint, GLint) , the buffer texture of \c palettes is bound by the caller once per frame.
+         \param instanceOffsetUniform The location of the \c int uniform receiving the index of the texel of the first record.
+         \param positionDequantizationUniform The location of the \c vec3[2] uniform receiving the \c MeshQuantization of each mesh, or -1 if the shader does not restore quantized positions. Meshes with quantized positions, as written by default by collada2bin, need it.
+         */
+        void draw(const StreamBuffer &palettes, GLint instanceOffsetUniform, GLint positionDequantizationUniform) const;
+        
+    };
+    
+}
+
+#endif
@@ -0,0 +1,152 @@
+//
+// => gcore/graphics/model/model_loader.h
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#ifndef __graphcore_graphics_model_model_loader
+#define __graphcore_graphics_model_model_loader
+
+#include <gcore/graphics/model/model.h>
+#include <gcore/util/thread_pool.h>
+
+#include <atomic>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <string>
+
+namespace gcore {
+    
+    typedef enum : uint8_t {
+        ModelRequestDecoding,   // The file is being read and decoded on the thread pool.
+        ModelRequestUploading,  // The model is decoded and waits for its meshes to be uploaded.
+        ModelRequestReady,      // The model is uploaded and can be taken.
+        ModelRequestFailed      // The file could not be opened or decoded.
+    } ModelRequestState;
+    
+    /*!
+     \brief The state of a model requested to a \c ModelLoader .
+     */
+    class ModelRequest {
+        
+        std::string fileName;
+        ModelLoadOptions options;
+        
+        std::atomic<ModelRequestState> state;
+        
+        /*!
+         \brief The stream the model was decoded from, kept open until the meshes are uploaded since they may point into its mapping.
+         */
+        BinaryInputStream *stream = nullptr;
+        Model *model = nullptr;
+        
+        friend class ModelLoader;
+        
+    public:
+        ModelRequest(const char *fileName, const ModelLoadOptions &options)
+        : fileName(fileName), options(options), state(ModelRequestDecoding) {  }
+        
+        ~ModelRequest() {
+            delete model;
+            delete stream;
+        }
+        
+        ModelRequest(const ModelRequest &) = delete;
+        ModelRequest &operator=(const ModelRequest &) = delete;
+        
+        inline const std::string &getFileName() const {
+            return fileName;
+        }
+        
+        inline ModelRequestState getState() const {
+            return state.load(std::memory_order_acquire);
+        }
+        
+        /*!
+         \brief Returns whether the request completed, successfully or not.
+         */
+        inline bool isDone() const {
+            ModelRequestState current = getState();
+            return current == ModelRequestReady || current == ModelRequestFailed;
+        }
+        
+        /*!
+         \brief Hands the loaded model over to the caller.
+         \return The model, or \c nullptr if it is not ready or was already taken.
+         */
+        Model *takeModel();
+        
+    };
+    
+    /*!
+     \brief Loads models in the background: files are decoded on a thread pool, while the OpenGL uploads are queued and carried out by \c processUploads() on the thread owning the context, within a time budget per call.
+     */
+    class ModelLoader {
+        
+        /*!
+         \brief The decoded models waiting to be uploaded. It is shared with the decoding tasks, so that they never refer to the loader itself.
+         */
+        struct UploadQueue {
+            std::mutex mutex;
+            std::deque<std::shared_ptr<ModelRequest>> requests;
+        };
+        
+        ThreadPool &pool;
+        std::shared_ptr<UploadQueue> uploads;
+        
+        /*!
+         \brief The request whose meshes are being uploaded, only accessed by the thread calling \c processUploads() .
+         */
+        std::shared_ptr<ModelRequest> current;
+        
+    public:
+        explicit ModelLoader(ThreadPool &pool) : pool(pool), uploads(std::make_shared<UploadQueue>()) {  }
+        
+        ModelLoader(const ModelLoader &) = delete;
+        ModelLoader &operator=(const ModelLoader &) = delete;
+        
+        /*!
+         \brief Starts loading the model stored in the FDMD file at the given path. The meshes and animations of v2 files are decoded in parallel on the pool.
+         \return The request tracking the load. Dropping it does not cancel the load, but discards its result.
+         */
+        std::shared_ptr<ModelRequest> load(const char *fileName, const ModelLoadOptions &options = ModelLoadOptions());
+        
+        /*!
+         \brief Uploads the meshes of the decoded models until \c budgetSeconds have elapsed. At least one mesh is uploaded per call if any is waiting, so that loads always progress.
+         \warning This must be called on the thread owning the OpenGL context, typically once per frame.
+         \return The number of meshes uploaded.
+         */
+        size_t processUploads(double budgetSeconds);
+        
+        /*!
+         \brief Returns whether decoded models are waiting to be uploaded.
+         */
+        bool hasPendingUploads() const;
+        
+    };
+    
+}
+
+#endif
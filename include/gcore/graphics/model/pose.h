@@ -0,0 +1,195 @@
+//
+// => gcore/graphics/model/pose.h
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef __graphcore_graphics_model_pose
+#define __graphcore_graphics_model_pose
+
+#include <gcore/math/affine.h>
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+#include <vector>
+
+namespace gcore {
+    
+    class SkeletonBone;
+    
+    /*!
+     \brief How a transform is combined with the transform a node already has in a pose.
+     */
+    typedef enum : uint8_t {
+        /*!
+         \brief The transforms blended into a node are averaged by their weights, so that the weights need not sum to 1. If they sum to less than 1, the rest is taken from the bind pose of the pose, so that a clip faded in by its weight is lerped from the bind pose.
+         */
+        PoseBlendWeighted = 0,
+        /*!
+         \brief The transform is interpolated with the current one by its weight, replacing it at weight 1. A node not animated yet is interpolated from the bind pose of the pose.
+         */
+        PoseBlendOverride = 1,
+        /*!
+         \brief The transform is a difference, applied on top of the current one scaled by its weight. Nodes not animated yet are left in their bind pose.
+         */
+        PoseBlendAdditive = 2
+    } PoseBlendMode;
+    
+    /*!
+     \brief A weight in [0, 1] for each node of a skeleton, scaling how much an animation layer affects the node.
+     \note The channels of nodes with weight 0 are not sampled at all.
+     */
+    class BoneMask {
+        
+        std::vector<float> weights;
+        
+    public:
+        explicit BoneMask(uint32_t count, float weight = 1.0f) : weights(count, weight) {  }
+        
+        inline uint32_t getCount() const {
+            return (uint32_t)weights.size();
+        }
+        
+        inline float getWeight(uint32_t node) const {
+            return weights[node];
+        }
+        
+        inline void setWeight(uint32_t node, float weight) {
+            weights[node] = weight;
+        }
+        
+        /*!
+         \brief Sets the weight of a node and of all its descendants, e.g. to select the upper body from the spine.
+         */
+        void setSubtree(const SkeletonBone &node, float weight);
+        
+    };
+    
+    /*!
+     \brief The transforms of the nodes of a skeleton relative to their parents, stored as structure of arrays: each component of the translations, rotations and scales has an array of its own, so that batches of nodes can be processed with SIMD.
+     \note Only the nodes with a weight hold a transform; the others are in their bind pose.
+     */
+    class Pose {
+        
+        uint32_t count = 0;
+        /*!
+         \brief The length of each component array, rounded up to a multiple of 8.
+         */
+        uint32_t stride = 0;
+        
+        /*!
+         \brief The component arrays: translation x, y, z, rotation x, y, z, w, scale x, y, z.
+         */
+        std::vector<float> components;
+        /*!
+         \brief The total weight of the transforms blended into each node, 0 for nodes in their bind pose.
+         */
+        std::vector<float> weights;
+        
+        /*!
+         \brief The transforms the nodes are blended from, or \c nullptr to take the blended transforms as they are.
+         */
+        const Pose *bindPose = nullptr;
+        
+        /*!
+         \brief Lerps a node from its bind pose by its weight if its weighted transforms sum to less than 1, or seeds it with its bind pose if it is not animated, and gives it weight 1.
+         */
+        void settle(uint32_t node);
+        
+    public:
+        enum : uint32_t {
+            TranslationX, TranslationY, TranslationZ,
+            RotationX, RotationY, RotationZ, RotationW,
+            ScaleX, ScaleY, ScaleZ,
+            ComponentCount
+        };
+        
+        explicit Pose(uint32_t count = 0) {
+            resize(count);
+        }
+        
+        /*!
+         \brief Sets the number of nodes of the pose, putting all of them in their bind pose.
+         */
+        void resize(uint32_t newCount);
+        
+        inline uint32_t getCount() const {
+            return count;
+        }
+        
+        /*!
+         \brief Returns the array of the given component, holding a value for each node.
+         */
+        inline float *getComponent(uint32_t component) {
+            return components.data() + component * stride;
+        }
+        
+        inline const float *getComponent(uint32_t component) const {
+            return components.data() + component * stride;
+        }
+        
+        inline bool isAnimated(uint32_t node) const {
+            return weights[node] > 0;
+        }
+        
+        inline float getWeight(uint32_t node) const {
+            return weights[node];
+        }
+        
+        /*!
+         \brief Puts all the nodes in their bind pose.
+         */
+        void clear();
+        
+        /*!
+         \brief Sets the transform of every node in the bind pose, as given by \c Skeleton::getBindTransforms() , which weighted and overriding transforms are blended from.
+         \note Without it, a node takes the first transform blended into it whatever its weight, and a transform blended with weight less than 1 pops in.
+         */
+        inline void setBindPose(const Pose *pose) {
+            bindPose = pose;
+        }
+        
+        /*!
+         \brief Replaces the transform of a node, with weight 1.
+         */
+        void setTransform(uint32_t node, const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale);
+        
+        /*!
+         \brief Blends a transform into a node. A node in its bind pose takes the transform as it is, unless it is additive.
+         \note Rotations are blended with a normalized lerp along the shortest arc. An additive transform is relative to the reference pose of its animation.
+         */
+        void blendTransform(uint32_t node, const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale, float weight, PoseBlendMode mode);
+        
+        /*!
+         \brief Writes the transform of every animated node to \c nodeTransforms , leaving the other transforms untouched.
+         \note The nodes whose weighted transforms sum to less than 1 are first lerped from the bind pose. The transforms are composed in batches of nodes with SIMD.
+         */
+        void toAffine(Affine3x4 *nodeTransforms);
+        
+    };
+    
+}
+
+#endif
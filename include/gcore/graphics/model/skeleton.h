@@ -27,8 +27,12 @@
 #ifndef __graphcore_graphics_model_skeleton
 #define __graphcore_graphics_model_skeleton
 
+#include <gcore/math/affine.h>
+#include <gcore/math/dual_quaternion.h>
+#include <gcore/graphics/model/pose.h>
+#include <gcore/util/arena.h>
+
 #include <cstdint>
-#include <vector>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/type_ptr.hpp>
@@ -40,6 +44,42 @@ namespace gcore {
     class Skeleton;
     class Animation;
     
+    /*!
+     \brief How each joint of a palette is stored, and uploaded to the shaders.
+     */
+    typedef enum : uint8_t {
+        /*!
+         \brief A \c glm::mat4 , read as \c mat4 .
+         */
+        JointPaletteMat4 = 0,
+        /*!
+         \brief An \c Affine3x4 , 25% smaller, read as \c mat3x4 that transforms \c vec4(p, 1) from the right.
+         */
+        JointPaletteAffine = 1,
+        /*!
+         \brief A \c DualQuaternion , 50% smaller, read as two \c vec4 . Dual quaternions keep no scale, so the joints must be rigid.
+         */
+        JointPaletteDualQuaternion = 2
+    } JointPaletteFormat;
+    
+    /*!
+     \brief Returns the number of \c vec4 taken by a joint in the given palette format.
+     */
+    inline uint32_t jointPaletteTexels(JointPaletteFormat format) {
+        switch (format) {
+            case JointPaletteAffine:
+                return 3;
+            case JointPaletteDualQuaternion:
+                return 2;
+            default:
+                return 4;
+        }
+    }
+    
+    /*!
+     \brief A node of the hierarchy of a skeleton. Nodes with an ID lower than the bone count of the skeleton are bones, which deform the vertices bound to them.
+     \note The nodes are immutable once loaded: the transforms of an animated skeleton are kept by each \c ModelInstance . Nodes live in the arena of their skeleton.
+     */
     class SkeletonBone {
         friend class Skeleton;
         
@@ -48,85 +88,118 @@ namespace gcore {
         uint32_t boneID;
         
         glm::mat4 bindPose;
-        glm::mat4 transform;
         glm::mat4 offsetMatrix;
         
         SkeletonBone *parent = nullptr;
-        std::vector<SkeletonBone *> children;
+        
+        uint32_t childrenCount = 0;
+        SkeletonBone **children = nullptr;
         
     public:
-        inline SkeletonBone(Skeleton &skeleton, uint32_t boneID, glm::mat4 transform) : skeleton(skeleton), boneID(boneID), transform(transform), bindPose(transform) {  }
+        inline SkeletonBone(Skeleton &skeleton, uint32_t boneID, glm::mat4 bindPose) : skeleton(skeleton), boneID(boneID), bindPose(bindPose) {  }
 
         inline Skeleton &getSkeleton() const {
             return skeleton;
         }
         
-        inline glm::mat4 &joint() {
-            return transform;
-        }
-        
         inline uint32_t getBoneID() const {
             return boneID;
         }
         
-        inline const glm::mat4 &getNodeTransform() const {
-            return transform;
-        }
-        
         inline const glm::mat4 &getOffsetMatrix() const {
             return offsetMatrix;
         }
         
+        /*!
+         \brief Returns the transform of the node relative to its parent when the skeleton is not animated.
+         */
         inline const glm::mat4 &getBindPose() const {
             return bindPose;
         }
         
-        inline void setTransform(glm::mat4 newTransform) {
-            transform = bindPose * newTransform;
-        }
-        
         inline SkeletonBone *getParent() const {
             return parent;
         }
         
-        inline const std::vector<SkeletonBone *> &getChildren() const {
-            return children;
+        inline uint32_t getChildrenCount() const {
+            return childrenCount;
         }
         
-        inline void addChild(SkeletonBone *newChild) {
-            children.push_back(newChild);
-            newChild->parent = this;
+        inline SkeletonBone *getChild(uint32_t i) const {
+            return children[i];
         }
         
     };
     
+    /*!
+     \brief The hierarchy of nodes shared by all the instances of a model.
+     \note A pose of the skeleton is given as the transform of each node relative to its parent, indexed by node ID.
+     \note All the nodes are allocated in a single arena sized when the skeleton is created, and freed with it. The hierarchy is also kept flat, sorted so that parents come before their children, to compute the joints in a single linear pass.
+     */
     class Skeleton {
         friend class Model;
         
-        SkeletonBone *rootBone;
+        SkeletonBone *rootBone = nullptr;
         
         uint32_t bonesCount;
+        uint32_t nodesCount;
+        
+        Arena arena;
         SkeletonBone **bones;
-        glm::mat4 *joints;
+        
+        /*!
+         \brief The IDs of the nodes reachable from the root, each after its parent.
+         */
+        uint32_t sortedCount = 0;
+        uint32_t *sortedNodes = nullptr;
+        /*!
+         \brief The ID of the parent of each node in \c sortedNodes , or \c NoParent for the root.
+         */
+        uint32_t *sortedParents = nullptr;
+        /*!
+         \brief The bind pose of each node and the offset matrix of each bone, contiguous.
+         */
+        Affine3x4 *bindPoses = nullptr;
+        Affine3x4 *offsetMatrices = nullptr;
+        /*!
+         \brief The bind pose of each node decomposed into translation, rotation and scale.
+         */
+        Pose bindTransforms;
         
         glm::mat4 finalTransform;
         
         
         SkeletonBone *readNode(BinaryInputStream &is);
         
+        /*!
+         \brief Computes the transform of every node relative to the model in the given pose, in a buffer shared by the skeletons on the calling thread.
+         */
+        const Affine3x4 *computeModelTransforms(const Affine3x4 *nodeTransforms) const;
+        
+        /*!
+         \brief Flattens the hierarchy under the root breadth first into the sorted arrays, and gathers the bind poses and the offset matrices of the nodes.
+         */
+        void sortNodes();
+        
     public:
-        Skeleton(uint32_t bonesCount, uint32_t nodesCount) : bonesCount(bonesCount) {
-            bones = new SkeletonBone *[nodesCount];
-            joints = new glm::mat4[bonesCount];
-        }
+        static constexpr uint32_t NoParent = UINT32_MAX;
         
-        ~Skeleton() {
-            delete[] bones;
-            delete[] joints;
-        }
+        Skeleton(uint32_t bonesCount, uint32_t nodesCount);
         
+        /*!
+         \brief Sets the root of the hierarchy, whose nodes must all be attached, and sorts its nodes.
+         */
         inline void setRootBone(SkeletonBone *bone) {
             rootBone = bone;
+            sortNodes();
+        }
+        
+        inline uint32_t getBonesCount() const {
+            return bonesCount;
+        }
+        
+        inline uint32_t getNodesCount() const {
+            return nodesCount;
         }
         
         inline const glm::mat4 &getFinalTransform() const {
@@ -137,9 +210,43 @@ namespace gcore {
             return bones[boneID];
         }
         
-        void resetJoint(uint32_t boneID);
+        /*!
+         \brief Writes the bind pose of every node to \c nodeTransforms , which holds \c getNodesCount() matrices.
+         */
+        void getBindPose(Affine3x4 *nodeTransforms) const;
+        
+        /*!
+         \brief Returns the bind pose of every node as a pose, from which the clips blended into a \c Pose are lerped by their weight.
+         \see Pose::setBindPose()
+         */
+        inline const Pose &getBindTransforms() const {
+            return bindTransforms;
+        }
         
-        void resetAllJoints();
+        /*!
+         \brief Computes the joint matrix of every bone in the given pose.
+         \note The transform of each node relative to the model is computed once, from its parent's, in the sorted order. Node transforms, offsets and the final transform are taken as affine.
+         \param nodeTransforms The transform of each node relative to its parent.
+         \param joints The palette receiving \c getBonesCount() matrices.
+         */
+        void computeJoints(const Affine3x4 *nodeTransforms, glm::mat4 *joints) const;
+        
+        /*!
+         \brief Computes the joint of every bone in the given pose as a 3x4 affine matrix.
+         \see computeJoints(const Affine3x4 *, glm::mat4 *)
+         */
+        void computeJoints(const Affine3x4 *nodeTransforms, Affine3x4 *joints) const;
+        
+        /*!
+         \brief Computes the joint of every bone in the given pose as a dual quaternion, dropping any scale.
+         \see computeJoints(const Affine3x4 *, glm::mat4 *)
+         */
+        void computeJoints(const Affine3x4 *nodeTransforms, DualQuaternion *joints) const;
+        
+        /*!
+         \brief Computes the joint palette of the given pose in the given format, as \c jointPaletteTexels() \c vec4 per bone.
+         */
+        void computeJoints(const Affine3x4 *nodeTransforms, JointPaletteFormat format, glm::vec4 *palette) const;
         
     };
     
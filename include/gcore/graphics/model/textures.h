@@ -39,10 +39,36 @@ namespace gcore {
         
         GLuint _texid;
         
+        /*!
+         \brief The size in bytes of the base level of the texture, assuming 4 bytes per texel.
+         */
+        size_t memorySize = 0;
         
     public:
         Texture(const char *texPath);
         
+        ~Texture() {
+            glDeleteTextures(1, &_texid);
+        }
+        
+        Texture(const Texture &) = delete;
+        Texture &operator=(const Texture &) = delete;
+        
+        /*!
+         \brief Returns whether the image could be loaded into the texture.
+         */
+        inline bool good() const {
+            return _texid != 0;
+        }
+        
+        inline GLuint getID() const {
+            return _texid;
+        }
+        
+        inline size_t getMemorySize() const {
+            return memorySize;
+        }
+        
     };
     
 }
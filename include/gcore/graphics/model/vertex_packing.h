@@ -0,0 +1,82 @@
+//
+// => gcore/graphics/model/vertex_packing.h
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef __graphcore_graphics_model_vertex_packing
+#define __graphcore_graphics_model_vertex_packing
+
+#include <cstddef>
+#include <cstdint>
+
+namespace gcore {
+    
+    /*!
+     \brief Converts the given float to a IEEE 754 half-precision float, rounding to the nearest representable value.
+     */
+    uint16_t floatToHalf(float x);
+    
+    /*!
+     \brief Converts the given IEEE 754 half-precision float to a float.
+     */
+    float halfToFloat(uint16_t h);
+    
+    /*!
+     \brief Encodes a value in [-1, 1] as a 16-bit signed normalized integer, as read by OpenGL from a normalized \c GL_SHORT attribute.
+     */
+    int16_t packSNorm16(float x);
+    
+    float unpackSNorm16(int16_t x);
+    
+    /*!
+     \brief Encodes a value in [0, 1] as a 16-bit unsigned normalized integer, as read by OpenGL from a normalized \c GL_UNSIGNED_SHORT attribute.
+     */
+    uint16_t packUNorm16(float x);
+    
+    float unpackUNorm16(uint16_t x);
+    
+    /*!
+     \brief Encodes a vector with components in [-1, 1] into a word, as read by OpenGL from a normalized \c GL_INT_2_10_10_10_REV attribute: 10 bits each for x, y and z, 2 bits for w.
+     */
+    uint32_t packSNorm2_10_10_10(float x, float y, float z, float w = 0.0f);
+    
+    void unpackSNorm2_10_10_10(uint32_t packed, float *out);
+    
+    /*!
+     \brief Computes the offset and scale mapping the given vectors into [-1, 1], so that each of them can be packed as \c (v - offset) / scale .
+     \param values \c count vectors with \c components floats each.
+     \param offset The center of the bounding box of the vectors, \c components floats.
+     \param scale The half-extent of the bounding box of the vectors, \c components floats, never zero.
+     */
+    void computeQuantizationRange(const float *values, size_t count, size_t components, float *offset, float *scale);
+    
+    /*!
+     \brief Encodes \c count groups of \c components bone weights as 8-bit unsigned normalized integers.
+     \note The weights of each group are renormalized so that they still sum up to exactly 1 once unpacked.
+     */
+    void packBoneWeights(uint8_t *dst, const float *weights, size_t count, size_t components);
+    
+}
+
+#endif
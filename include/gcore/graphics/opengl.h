@@ -49,11 +49,78 @@ namespace gcore {
             OGLVertexAttribBoneWeight = 4
         } OGLVertexAttrib;
         
+        /*!
+         \brief Description of a vertex attribute inside a vertex buffer.
+         */
+        struct VertexAttribFormat {
+            /*!
+             \brief The location of the attribute in the shaders, usually one of the \c OGLVertexAttrib values.
+             */
+            GLuint location;
+            GLint components;
+            GLenum type;
+            /*!
+             \brief Whether integer values are normalized to [0, 1] (or [-1, 1] if signed) when converted to floating point.
+             */
+            GLboolean normalized;
+            /*!
+             \brief Whether the attribute is read by the shaders as integer (e.g. \c ivec4 ), in which case it is bound with \c glVertexAttribIPointer .
+             */
+            bool integer;
+            /*!
+             \brief The offset in bytes of the attribute from the beginning of the vertex.
+             */
+            GLuint offset;
+        };
+        
+        /*!
+         \brief Returns the size in bytes of a single component of the given OpenGL type.
+         */
+        GLuint glTypeSize(GLenum type);
+        
+        /*!
+         \brief Returns the size in bytes of a vertex attribute with \c components values of the given OpenGL type.
+         \note Packed types such as \c GL_INT_2_10_10_10_REV store all the components in a single word.
+         */
+        GLuint glAttribSize(GLint components, GLenum type);
+        
+        /*!
+         \brief Descriptor of the vertex format of a single vertex buffer: the attributes it contains, their offset and the stride between two consecutive vertices.
+         \note A layout with one attribute describes a tightly packed buffer, a layout with more attributes describes an interleaved buffer.
+         */
+        class VertexLayout {
+            
+            std::vector<VertexAttribFormat> attribs;
+            
+            GLuint stride = 0;
+            
+        public:
+            /*!
+             \brief Appends an attribute after the ones already in the layout. Each attribute starts at a 4-byte boundary, as OpenGL implementations prefer.
+             */
+            VertexLayout &add(GLuint location, GLint components, GLenum type, GLboolean normalized = GL_FALSE, bool integer = false);
+            
+            inline const std::vector<VertexAttribFormat> &getAttribs() const {
+                return attribs;
+            }
+            
+            /*!
+             \brief Returns the size in bytes of a vertex, which is the distance between two consecutive vertices in the buffer.
+             */
+            inline GLuint getStride() const {
+                return stride;
+            }
+            
+        };
+        
         
         class VertexArrayObject {
             
             size_t vertexCount;
             
+            size_t indexCount = 0;
+            GLenum indexType = GL_UNSIGNED_INT;
+            
             GLuint vaoID;
             
             std::vector<GLuint> buffersID;
@@ -75,19 +142,203 @@ namespace gcore {
                 glBindVertexArray(vaoID);
             }
             
+            inline GLuint getID() const {
+                return vaoID;
+            }
+            
             inline size_t getVertexCount() const {
                 return vertexCount;
             }
             
-            void bindPositions(GLfloat *data);
+            /*!
+             \brief Returns whether the vertices are drawn through an index buffer, bound with \c bindIndices() .
+             */
+            inline bool isIndexed() const {
+                return indexCount > 0;
+            }
+            
+            inline size_t getIndexCount() const {
+                return indexCount;
+            }
+            
+            /*!
+             \brief Returns the type of the indices in the index buffer, either \c GL_UNSIGNED_SHORT or \c GL_UNSIGNED_INT .
+             */
+            inline GLenum getIndexType() const {
+                return indexType;
+            }
+            
+            /*!
+             \brief Draws the triangles of the vertex array, through the index buffer if there is one.
+             \note The vertex array must be bound.
+             */
+            inline void drawTriangles() const {
+                if (indexCount > 0) {
+                    glDrawElements(GL_TRIANGLES, (GLsizei)indexCount, indexType, BUFFER_OFFSET(0));
+                } else {
+                    glDrawArrays(GL_TRIANGLES, 0, (GLsizei)vertexCount);
+                }
+            }
+            
+            /*!
+             \brief Draws \c instanceCount instances of the triangles of the vertex array with a single draw call, the shaders telling them apart by \c gl_InstanceID .
+             \note The vertex array must be bound.
+             */
+            inline void drawTrianglesInstanced(GLsizei instanceCount) const {
+                if (indexCount > 0) {
+                    glDrawElementsInstanced(GL_TRIANGLES, (GLsizei)indexCount, indexType, BUFFER_OFFSET(0), instanceCount);
+                } else {
+                    glDrawArraysInstanced(GL_TRIANGLES, 0, (GLsizei)vertexCount, instanceCount);
+                }
+            }
             
-            void bindNormals(GLfloat *data);
+            /*!
+             \brief Uploads a vertex buffer whose vertices are laid out as described by \c layout , and binds all the attributes of the layout to it.
+             \note With an interleaved layout a mesh needs a single buffer and the attributes of a vertex are fetched together.
+             */
+            void bindInterleaved(const void *data, const VertexLayout &layout);
             
-            void bindTexCoords2D(GLfloat *data);
+            void bindPositions(const GLfloat *data);
             
-            void bindBoneIDs(GLuint *data, GLint weightsPerVertex);
+            void bindNormals(const GLfloat *data);
             
+            void bindTexCoords2D(const GLfloat *data);
             
+            void bindBoneIDs(const GLuint *data, GLint weightsPerVertex);
+            
+            void bindBoneWeights(const GLfloat *data, GLint weightsPerVertex);
+            
+            /*!
+             \brief Uploads the index buffer of the vertex array. \c type is either \c GL_UNSIGNED_SHORT or \c GL_UNSIGNED_INT .
+             */
+            void bindIndices(const void *data, size_t count, GLenum type);
+            
+            
+            
+        };
+        
+        /*!
+         \brief A buffer receiving data written by the CPU at every frame, such as joint palettes, split in a ring of regions so that the CPU writes a frame while the GPU still reads the previous ones.
+         \note The region of a frame is fenced when the frame ends, and waited for before it is written again. The buffer is persistently mapped when \c GL_ARB_buffer_storage is available; otherwise the region is mapped unsynchronized, which the fences make safe.
+         \note Data is allocated at offsets relative to the region of the frame, which stay valid if the buffer grows during the frame. All the data of a frame should be written before the draws reading it.
+         */
+        class StreamBuffer {
+            
+            GLenum target;
+            GLuint bufferID = 0;
+            
+            /*!
+             \brief The buffer texture over the whole buffer, if it was created with a texture format.
+             */
+            GLuint textureID = 0;
+            GLenum textureFormat;
+            
+            size_t regionSize;
+            uint32_t regionCount;
+            uint32_t region = 0;
+            /*!
+             \brief The size of the data allocated in the region of the current frame.
+             */
+            size_t head = 0;
+            /*!
+             \brief The alignment of every allocation, which is the uniform buffer offset alignment for uniform buffers.
+             */
+            size_t minAlignment = 16;
+            
+            bool persistent;
+            /*!
+             \brief The persistent mapping of the whole buffer, or \c nullptr .
+             */
+            uint8_t *storage = nullptr;
+            /*!
+             \brief Where the start of the region of the current frame is mapped, or \c nullptr if it is not.
+             */
+            uint8_t *mapping = nullptr;
+            /*!
+             \brief The offset in the region from which it is mapped, when it is not persistently mapped.
+             */
+            size_t mappedFrom = 0;
+            
+            /*!
+             \brief The fence of the last frame written to each region, or \c nullptr .
+             */
+            std::vector<GLsync> fences;
+            
+            /*!
+             \brief Replaces the buffer with a new one with regions of the given size, copying the data of the current frame on the GPU.
+             */
+            void resize(size_t newRegionSize);
+            
+            /*!
+             \brief Maps the region of the current frame from offset \c from , discarding its previous content, when the buffer is not persistently mapped.
+             */
+            void mapRegion(size_t from);
+            
+        public:
+            /*!
+             \param target The target to which the buffer is bound, e.g. \c GL_UNIFORM_BUFFER or \c GL_TEXTURE_BUFFER .
+             \param regionSize The initial size of the data of a frame, grown as needed.
+             \param regionCount The number of frames the CPU can write ahead of the GPU, plus one.
+             \param textureFormat If not \c GL_NONE , the format of a buffer texture created over the buffer, e.g. \c GL_RGBA32F .
+             */
+            StreamBuffer(GLenum target, size_t regionSize, uint32_t regionCount = 3, GLenum textureFormat = GL_NONE);
+            
+            ~StreamBuffer();
+            
+            StreamBuffer(const StreamBuffer &) = delete;
+            StreamBuffer &operator=(const StreamBuffer &) = delete;
+            
+            /*!
+             \brief Moves to the next region of the ring, waiting for the GPU to finish reading it if needed.
+             */
+            void beginFrame();
+            
+            /*!
+             \brief Allocates \c size bytes in the region of the current frame, growing the buffer if they do not fit.
+             \param offset Receives the offset of the allocation, relative to the region.
+             \return Where to write the data, valid until \c flush() or the next allocation.
+             */
+            void *allocate(size_t size, size_t alignment, size_t &offset);
+            
+            /*!
+             \brief Makes the data written so far visible to the GPU. Call it before the draws reading the data.
+             */
+            void flush();
+            
+            /*!
+             \brief Flushes the data of the frame and fences its region.
+             */
+            void endFrame();
+            
+            inline GLuint getBuffer() const {
+                return bufferID;
+            }
+            
+            /*!
+             \brief Returns the offset in the buffer of the region of the current frame, to which allocation offsets are relative.
+             */
+            inline size_t getRegionOffset() const {
+                return region * regionSize;
+            }
+            
+            inline size_t getRegionSize() const {
+                return regionSize;
+            }
+            
+            /*!
+             \brief Binds an allocation of the current frame to an indexed binding point of the target, e.g. a uniform block binding.
+             */
+            inline void bindRange(GLuint index, size_t offset, size_t size) const {
+                glBindBufferRange(target, index, bufferID, (GLintptr)(getRegionOffset() + offset), (GLsizeiptr)size);
+            }
+            
+            /*!
+             \brief Binds the buffer texture to the given texture unit, e.g. \c GL_TEXTURE1 .
+             */
+            inline void bindTexture(GLenum unit) const {
+                glActiveTexture(unit);
+                glBindTexture(GL_TEXTURE_BUFFER, textureID);
+            }
             
         };
         
@@ -0,0 +1,149 @@
+//
+// => gcore/graphics/render_queue.h
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#ifndef __graphcore_graphics_render_queue
+#define __graphcore_graphics_render_queue
+
+#include <gcore/graphics/opengl.h>
+#include <gcore/graphics/shaders/shaders.h>
+
+#include <cstdint>
+#include <vector>
+
+namespace gcore {
+    
+    /*!
+     \brief A draw of the triangles of a vertex array, with the state it needs bound.
+     */
+    struct RenderItem {
+        const ShaderProgram *program = nullptr;
+        /*!
+         \brief The \c GL_TEXTURE_2D bound to texture unit 0, or 0.
+         */
+        GLuint texture = 0;
+        const VertexArrayObject *vao = nullptr;
+        /*!
+         \brief The number of instances drawn with an instanced draw call, or 0 for a plain draw call.
+         */
+        GLsizei instanceCount = 0;
+        
+        /*!
+         \brief Called with the state of the item bound, right before its draw call, to set the uniforms of the draw; or \c nullptr .
+         */
+        void (*setUniforms)(const RenderItem &item) = nullptr;
+        /*!
+         \brief Data for \c setUniforms , such as the object drawn and the index of its mesh.
+         */
+        const void *object = nullptr;
+        uint32_t index = 0;
+    };
+    
+    /*!
+     \brief The work done by the last submission of a \c RenderQueue .
+     */
+    struct RenderQueueStats {
+        uint32_t itemCount = 0;
+        uint32_t drawCalls = 0;
+        uint32_t programChanges = 0;
+        uint32_t textureChanges = 0;
+        uint32_t vertexArrayChanges = 0;
+        
+        inline uint32_t getStateChanges() const {
+            return programChanges + textureChanges + vertexArrayChanges;
+        }
+    };
+    
+    /*!
+     \brief Collects the draws of a frame and submits them sorted by state, binding only the state that differs from the previous draw.
+     \note Each item gets a 64-bit sort key: from the most significant bits, 12 bits of the program, 16 of the texture, 16 of the vertex array and 20 of the depth, so that draws are grouped by program first, the most expensive change, and front to back last. Keys are sorted with an LSD radix sort, skipping the bytes all the keys share.
+     \note Programs, textures and vertex arrays are keyed by the low bits of their OpenGL names, which only affect grouping: the state is always compared as a whole before being bound.
+     */
+    class RenderQueue {
+        
+        std::vector<RenderItem> items;
+        std::vector<uint64_t> keys;
+        
+        /*!
+         \brief The indices of the items in submission order, and the buffers the radix sort ping-pongs with.
+         */
+        std::vector<uint32_t> order;
+        std::vector<uint32_t> orderScratch;
+        std::vector<uint64_t> sortedKeys;
+        std::vector<uint64_t> keyScratch;
+        
+        RenderQueueStats stats;
+        
+    public:
+        static constexpr uint32_t ProgramBits = 12;
+        static constexpr uint32_t TextureBits = 16;
+        static constexpr uint32_t VertexArrayBits = 16;
+        static constexpr uint32_t DepthBits = 20;
+        
+        /*!
+         \brief Returns the sort key of an item.
+         \param depth The distance of the item from the camera, which must not be negative.
+         */
+        static uint64_t makeKey(const RenderItem &item, float depth);
+        
+        /*!
+         \brief Removes all the items, keeping the memory for the next frame.
+         */
+        void clear();
+        
+        /*!
+         \brief Adds a draw to the queue.
+         \param depth The distance of the item from the camera, which must not be negative. Draws with the same state are submitted front to back.
+         */
+        void add(const RenderItem &item, float depth = 0.0f);
+        
+        inline size_t getItemCount() const {
+            return items.size();
+        }
+        
+        /*!
+         \brief Sorts the items by key, which \c submit() does itself.
+         */
+        void sort();
+        
+        /*!
+         \brief Sorts the items and issues their draw calls, skipping the binds of the state already bound. The queue keeps its items until \c clear() .
+         \note The uniforms shared by the draws of a program must be set before submitting, since uniforms are kept by each program. The texture of the items is bound to texture unit 0, which is left active.
+         */
+        void submit();
+        
+        /*!
+         \brief Returns the draw calls and the state changes of the last submission.
+         */
+        inline const RenderQueueStats &getStats() const {
+            return stats;
+        }
+        
+    };
+    
+}
+
+#endif
@@ -68,6 +68,11 @@ namespace gcore {
             inline void use() const {
                 glUseProgram(program);
             }
+            
+            inline GLuint getProgramID() const {
+                return program;
+            }
+            
             /*!
              \brief Adds the uniform location of the uniform in the program with the given name. If there are more than one uniform, then uniforms locations can be accessed through \c getUniform(i) where \c i depends on the order in which the calls to \c addUniform() are done.
              \return \c true if the uniform has been found and added successfully, \c false otherwise.
@@ -43,26 +43,129 @@ namespace gcore {
      */
     typedef uint8_t byte_t;
     
+    /*!
+     \brief Values indicating how a \c BinaryInputStream fetches the bytes from its source.
+     */
+    typedef enum : uint8_t {
+        /*!
+         \brief The file is read with \c fread into a private buffer, and the buffer is refilled when it runs out of bytes.
+         */
+        BinaryInputStreamBuffered = 0,
+        /*!
+         \brief The whole file is mapped in memory and the pointers returned by the stream point straight into the mapping, so no bytes are ever copied.
+         \note If the file cannot be mapped (or the platform does not support memory mapping) the stream falls back to \c BinaryInputStreamBuffered.
+         */
+        BinaryInputStreamMapped = 1,
+        /*!
+         \brief A background thread reads the file ahead of the consumer into a ring of buffers, so that decoding the bytes overlaps with the disk I/O.
+         */
+        BinaryInputStreamPrefetched = 2
+    } BinaryInputStreamMode;
+    
+    /*!
+     \brief Tunables for the way a \c BinaryInputStream reads its source.
+     */
+    struct BinaryInputStreamOptions {
+        /*!
+         \brief The way the stream fetches the bytes from its source.
+         */
+        BinaryInputStreamMode mode = BinaryInputStreamBuffered;
+        /*!
+         \brief The size in bytes of the read buffer, and of each buffer of the ring if the stream is prefetched. This is also the largest chunk that can be returned by a single call to \c BinaryInputStream::read() .
+         \note Ignored if the stream is memory mapped.
+         */
+        size_t bufferSize = MAX_BUFF_SIZE;
+        /*!
+         \brief The number of buffers in the ring filled by the background thread, if the stream is prefetched.
+         */
+        uint32_t bufferCount = 4;
+        
+        BinaryInputStreamOptions() {  }
+        
+        BinaryInputStreamOptions(BinaryInputStreamMode mode, size_t bufferSize = MAX_BUFF_SIZE, uint32_t bufferCount = 4) : mode(mode), bufferSize(bufferSize), bufferCount(bufferCount) {  }
+    };
+    
+    class BinaryInputPrefetcher;
+    
     /*!
      \brief Class implementing a binary input stream and convenience method to read numbers in big endian.
      */
     class BinaryInputStream {
         /*!
-         \brief The C file pointer used to read the file.
+         \brief The C file pointer used to read the file, or \c nullptr if the file is memory mapped.
+         */
+        FILE *fp = nullptr;
+        /*!
+         \brief The way the stream is actually fetching the bytes from its source.
          */
-        FILE *fp;
+        BinaryInputStreamMode mode = BinaryInputStreamBuffered;
         /*!
-         \brief The pointer to the byte buffer.
+         \brief The pointer to the byte buffer. If the stream is memory mapped, this is the beginning of the mapping.
          */
-        byte_t *buf;
+        byte_t *buf = nullptr;
+        /*!
+         \brief The size in bytes of the byte buffer, or of the mapping if the stream is memory mapped.
+         */
+        size_t bufSize = 0;
         /*!
          \brief The pointer to the next byte that has to be read.
          */
-        byte_t *bufptr;
+        byte_t *bufptr = nullptr;
         /*!
          \brief The number of valid bytes left in the buffer to read.
          */
-        size_t leftBytes;
+        size_t leftBytes = 0;
+        /*!
+         \brief The offset in the source of the first byte in the buffer.
+         */
+        uint64_t bufOffset = 0;
+        /*!
+         \brief The background reader filling the ring of buffers, if the stream is prefetched.
+         */
+        BinaryInputPrefetcher *prefetcher = nullptr;
+        /*!
+         \brief The time in seconds spent by the consumer waiting for bytes from the source.
+         */
+        double stallTime = 0;
+        /*!
+         \brief Whether the memory the stream reads from is owned by someone else, so that it must not be unmapped.
+         */
+        bool borrowed = false;
+        /*!
+         \brief Whether a read or a seek has run past the end of the source since the stream was opened or last cleared.
+         */
+        bool failed = false;
+        /*!
+         \brief The size in bytes of the source, or \c UINT64_MAX if it is not known (e.g. the source is a pipe).
+         */
+        uint64_t sourceSize = UINT64_MAX;
+        
+        /*!
+         \brief Returns the size in bytes of the file read by the given C file pointer, or \c UINT64_MAX if it is not a regular file.
+         */
+        static uint64_t fileSize(FILE *fp);
+        
+        /*!
+         \brief Maps the file at the given filename in memory.
+         \return \c true if the file has been mapped successfully, \c false otherwise.
+         */
+        bool map(const char *filename);
+        
+        /*!
+         \brief Releases the mapping of the file, if any.
+         */
+        void unmap();
+        
+        /*!
+         \brief Reads the next \c count words of \c wordSize bytes from the stream into \c dst , converting each one from big endian to the byte order of the host.
+         \note The words past the end of the source are set to 0 and the stream fails.
+         */
+        void readArray(void *dst, size_t count, size_t wordSize);
+        
+        /*!
+         \brief Fails the stream, dropping the bytes left in the buffer, so that nothing is read until the stream is cleared and moved.
+         */
+        void setFailed();
         
     public:
         /*!
@@ -70,8 +173,8 @@ namespace gcore {
          */
         explicit BinaryInputStream(FILE *fp) : fp(fp) {
             if (fp) {
-                buf = new byte_t[MAX_BUFF_SIZE];
-                leftBytes = 0;
+                buf = bufptr = new byte_t[bufSize = MAX_BUFF_SIZE];
+                sourceSize = fileSize(fp);
             }
         }
         
@@ -80,15 +183,27 @@ namespace gcore {
          */
         explicit BinaryInputStream(const char *filename) : BinaryInputStream(fopen(filename, "rb")) {  }
         
-        ~BinaryInputStream() {
-            if (fp) {
-                fclose(fp);
-            }
-            if (buf) {
-                delete buf;
-            }
+        /*!
+         \brief Initializes the stream with the file at the given filename, reading it as specified by \c options .
+         */
+        BinaryInputStream(const char *filename, const BinaryInputStreamOptions &options);
+        
+        /*!
+         \brief Initializes the stream with the file at the given filename, fetching the bytes as specified by \c mode .
+         */
+        BinaryInputStream(const char *filename, BinaryInputStreamMode mode) : BinaryInputStream(filename, BinaryInputStreamOptions(mode)) {  }
+        
+        /*!
+         \brief Initializes the stream with the \c size bytes at \c data , which must stay valid for the whole lifetime of the stream. The stream behaves as a memory mapped one, starting at offset 0.
+         \note Useful to decode a part of a mapped file on another thread, with a stream of its own.
+         */
+        BinaryInputStream(const void *data, size_t size) : mode(BinaryInputStreamMapped), borrowed(true) {
+            buf = bufptr = (byte_t *)data;
+            sourceSize = bufSize = leftBytes = size;
         }
         
+        ~BinaryInputStream();
+        
         BinaryInputStream &operator=(BinaryInputStream &) = delete;
         BinaryInputStream(BinaryInputStream &) = delete;
         
@@ -96,15 +211,9 @@ namespace gcore {
     private:
         /*!
          \brief Loads the next bytes in the file, until the buffer is full or the source runs out of bytes.
+         \note A memory mapped stream has all of its bytes already loaded, so this is a no-op, as it is for a failed stream.
          */
-        void load() {
-            if (leftBytes > 0) {
-                memcpy(buf, bufptr, sizeof(byte_t) * leftBytes);
-            }
-            
-            leftBytes += fread(buf + leftBytes, sizeof(byte_t), MAX_BUFF_SIZE - leftBytes, fp);
-            bufptr = buf;
-        }
+        void load();
         
     public:
         
@@ -112,22 +221,74 @@ namespace gcore {
          \brief Returns whether the stream is ready to read bytes
          */
         inline bool good() const {
-            return fp != nullptr;
+            return buf != nullptr;
         }
         /*!
          \brief Returns whether the stream source has ran out of bytes to read.
          */
-        inline bool eof() const {
-            return feof(fp) && !leftBytes;
+        bool eof() const;
+        /*!
+         \brief Returns whether a read or a seek has run past the end of the source, since the stream was opened or last cleared.
+         \note Numbers read past the end are 0, so a decoder can read a whole record and check the stream once at the end.
+         */
+        inline bool fail() const {
+            return failed;
         }
+        /*!
+         \brief Clears the failure of the stream. A failed stream reads nothing until it is cleared and moved with \c seek() , e.g. to read another record at a known offset.
+         */
+        inline void clear() {
+            failed = false;
+        }
+        /*!
+         \brief Returns the way the stream is fetching the bytes from its source.
+         */
+        inline BinaryInputStreamMode getMode() const {
+            return mode;
+        }
+        /*!
+         \brief Returns the time in seconds the stream has spent blocked waiting for bytes from the source, either in \c fread or waiting for the background thread to fill a buffer.
+         \note Page faults on a memory mapped stream are not accounted for.
+         */
+        inline double getStallTime() const {
+            return stallTime;
+        }
+        /*!
+         \brief Returns the offset in the source of the next byte that has to be read.
+         */
+        inline uint64_t tell() const {
+            return bufOffset + (uint64_t)(bufptr - buf);
+        }
+        /*!
+         \brief Returns the number of bytes between the current offset and the end of the source, or \c UINT64_MAX if the size of the source is not known.
+         \note Useful to reject counts read from a corrupt source before allocating storage for them.
+         */
+        inline uint64_t getRemainingBytes() const {
+            if (sourceSize == UINT64_MAX) {
+                return UINT64_MAX;
+            }
+            return sourceSize > tell() ? sourceSize - tell() : 0;
+        }
+        /*!
+         \brief Moves the stream to the given offset in the source, so that the next byte read is the one at \c offset .
+         \note Seeking inside the bytes already in the buffer (or anywhere in a memory mapped stream) is free. Otherwise the buffer is discarded and, for a prefetched stream, the background reader is restarted at the new offset.
+         \return \c true if the stream has been moved successfully, \c false otherwise, in which case the stream fails.
+         */
+        bool seek(uint64_t offset);
         
 
         /*!
          \brief Returns a pointer to the stream buffer containing the next \c bytes bytes in the stream. If there are not enough bytes, then new data from the source is requested.
+         \note If the stream is memory mapped, the returned pointer points straight into the mapping and stays valid for the whole lifetime of the stream.
+         \return The pointer to the bytes, or \c nullptr if the source has fewer than \c bytes bytes left or \c bytes exceeds the buffer size, in which case the stream fails.
          */
         const byte_t *read(size_t bytes) {
             if (leftBytes < bytes) {
                 load();
+                if (leftBytes < bytes) {
+                    setFailed(); // the bytes left would be read as the next value
+                    return nullptr;
+                }
             }
             
             byte_t *ret = bufptr;
@@ -136,17 +297,36 @@ namespace gcore {
             
             return ret;
         }
+        /*!
+         \brief Returns a pointer to the stream buffer containing the next \c bytes bytes in the stream, without consuming them.
+         \return The pointer to the bytes, or \c nullptr if the source has fewer than \c bytes bytes left. The stream does not fail.
+         */
+        const byte_t *peek(size_t bytes) {
+            if (leftBytes < bytes) {
+                load();
+            }
+            return leftBytes < bytes ? nullptr : bufptr;
+        }
+        /*!
+         \brief Copies the next \c bytes bytes in the stream to the memory pointed by \c dst . Unlike \c read() , the number of bytes is not limited by the buffer size.
+         \return The number of bytes copied, which is less than \c bytes only if the source ran out of bytes, in which case the stream fails.
+         */
+        size_t readBytes(void *dst, size_t bytes);
         /*!
          \brief Returns the next byte from the buffer as unsigned integer type.
          */
         inline uint8_t readByte() {
-            return *read(1);
+            const byte_t *data = read(1);
+            return data ? *data : 0;
         }
         /*!
          \brief Returns the next two bytes from the buffer as unsigned integer type, encoded as big endian.
          */
         uint16_t readInt16() {
             const byte_t *data = read(2);
+            if (!data) {
+                return 0;
+            }
             return ((uint32_t)data[0] << 8) | data[1];
         }
         /*!
@@ -154,6 +334,9 @@ namespace gcore {
          */
         uint32_t readInt32() {
             const byte_t *data = read(4);
+            if (!data) {
+                return 0;
+            }
             return ((uint32_t)data[0] << 24) |
             ((uint32_t)data[1] << 16) |
             ((uint32_t)data[2] << 8) | data[3];
@@ -169,10 +352,24 @@ namespace gcore {
          \brief Returns a \c glm::mat4 with the next 16 floats from the buffer, encoded as big endian. The layout of the floats for the matrix is column-major.
          */
         inline glm::mat4 readMat4() {
-            return glm::mat4(readFloat(), readFloat(), readFloat(), readFloat(),
-                             readFloat(), readFloat(), readFloat(), readFloat(),
-                             readFloat(), readFloat(), readFloat(), readFloat(),
-                             readFloat(), readFloat(), readFloat(), readFloat());
+            glm::mat4 ret;
+            readFloatArray(&ret[0][0], 16);
+            return ret;
+        }
+        
+        /*!
+         \brief Reads the next \c count 16-bit unsigned integers from the stream, encoded as big endian, into the array pointed by \c dst .
+         */
+        void readInt16Array(uint16_t *dst, size_t count);
+        /*!
+         \brief Reads the next \c count 32-bit unsigned integers from the stream, encoded as big endian, into the array pointed by \c dst .
+         */
+        void readInt32Array(uint32_t *dst, size_t count);
+        /*!
+         \brief Reads the next \c count floats from the stream, encoded as big endian, into the array pointed by \c dst .
+         */
+        inline void readFloatArray(float *dst, size_t count) {
+            readInt32Array((uint32_t *)dst, count);
         }
 
     };
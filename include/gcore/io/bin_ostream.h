@@ -0,0 +1,239 @@
+//
+// => gcore/io/bin_ostream.h
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef __graphcore_io_bin_ostream
+#define __graphcore_io_bin_ostream
+
+#include <gcore/io/bin_istream.h>
+
+#include <cstdio>
+
+#include <cstdint>
+#include <cstring>
+
+#include <glm/glm.hpp>
+
+#define MAX_WRITE_BUFF_SIZE (1 << 20)
+
+namespace gcore {
+    
+    /*!
+     \brief Values indicating how a \c BinaryOutputStream pushes the bytes to its destination.
+     */
+    typedef enum : uint8_t {
+        /*!
+         \brief The bytes are collected in a large private buffer, which is written with \c fwrite when it is full.
+         */
+        BinaryOutputStreamBuffered = 0,
+        /*!
+         \brief Like \c BinaryOutputStreamBuffered , but raw blocks larger than the buffer are not copied: they are written together with the pending buffer in a single \c writev call.
+         \note Falls back to \c BinaryOutputStreamBuffered on platforms without \c writev .
+         */
+        BinaryOutputStreamVectored = 1,
+        /*!
+         \brief The file is grown and mapped in memory, and the bytes are encoded straight into the mapping. The file is truncated to the written size when the stream is closed.
+         \note Falls back to \c BinaryOutputStreamBuffered if the file cannot be mapped.
+         */
+        BinaryOutputStreamMapped = 2
+    } BinaryOutputStreamMode;
+    
+    /*!
+     \brief Tunables for the way a \c BinaryOutputStream writes its destination.
+     */
+    struct BinaryOutputStreamOptions {
+        /*!
+         \brief The way the stream pushes the bytes to its destination.
+         */
+        BinaryOutputStreamMode mode = BinaryOutputStreamBuffered;
+        /*!
+         \brief The size in bytes of the write buffer, or the initial size of the mapping if the stream is memory mapped.
+         */
+        size_t bufferSize = MAX_WRITE_BUFF_SIZE;
+        
+        BinaryOutputStreamOptions() {  }
+        
+        BinaryOutputStreamOptions(BinaryOutputStreamMode mode, size_t bufferSize = MAX_WRITE_BUFF_SIZE) : mode(mode), bufferSize(bufferSize) {  }
+    };
+    
+    /*!
+     \brief Class implementing a binary output stream and convenience method to write numbers in big endian.
+     */
+    class BinaryOutputStream {
+        /*!
+         \brief The C file pointer used to write the file.
+         */
+        FILE *fp = nullptr;
+        /*!
+         \brief The way the stream is actually pushing the bytes to its destination.
+         */
+        BinaryOutputStreamMode mode = BinaryOutputStreamBuffered;
+        /*!
+         \brief The pointer to the byte buffer. If the stream is memory mapped, this is the beginning of the mapping.
+         */
+        byte_t *buf = nullptr;
+        /*!
+         \brief The size in bytes of the byte buffer, or of the mapping if the stream is memory mapped.
+         */
+        size_t bufSize = 0;
+        /*!
+         \brief The pointer to the next byte that has to be written.
+         */
+        byte_t *bufptr = nullptr;
+        /*!
+         \brief The number of bytes left in the buffer before it has to be flushed (or grown, if the stream is memory mapped).
+         */
+        size_t freeBytes = 0;
+        /*!
+         \brief The number of bytes already pushed to the file, not counting the ones still in the buffer.
+         */
+        uint64_t flushedBytes = 0;
+        /*!
+         \brief Whether an error occurred while writing the file.
+         */
+        bool failed = false;
+        
+        /*!
+         \brief Maps the file behind \c fp in memory, reserving \c size bytes.
+         \return \c true if the file has been mapped successfully, \c false otherwise.
+         */
+        bool map(size_t size);
+        
+        /*!
+         \brief Makes room in the buffer for at least \c bytes bytes, flushing it (or growing the mapping) if needed.
+         */
+        void reserve(size_t bytes);
+        
+        /*!
+         \brief Writes \c count words of \c wordSize bytes from \c src , converting each one from the byte order of the host to big endian.
+         */
+        void writeArray(const void *src, size_t count, size_t wordSize);
+        
+    public:
+        /*!
+         \brief Initializes the stream with the file at the given filename, which is created or truncated, writing it as specified by \c options .
+         */
+        explicit BinaryOutputStream(const char *filename, const BinaryOutputStreamOptions &options = BinaryOutputStreamOptions());
+        
+        ~BinaryOutputStream() {
+            close();
+        }
+        
+        BinaryOutputStream &operator=(BinaryOutputStream &) = delete;
+        BinaryOutputStream(BinaryOutputStream &) = delete;
+        
+        /*!
+         \brief Returns whether the stream is ready to write bytes and no error has occurred so far.
+         */
+        inline bool good() const {
+            return buf != nullptr && !failed;
+        }
+        /*!
+         \brief Returns the way the stream is pushing the bytes to its destination.
+         */
+        inline BinaryOutputStreamMode getMode() const {
+            return mode;
+        }
+        /*!
+         \brief Returns the number of bytes written so far, which is the offset in the file of the next byte.
+         */
+        inline uint64_t tell() const {
+            return flushedBytes + (uint64_t)(bufptr - buf);
+        }
+        
+        /*!
+         \brief Pushes the bytes in the buffer to the file.
+         \note A memory mapped stream has nothing to push, so this is a no-op.
+         */
+        void flush();
+        /*!
+         \brief Flushes the stream and closes the file. No more bytes can be written after this call.
+         \return \c true if every byte has been written successfully, \c false otherwise.
+         */
+        bool close();
+        
+        /*!
+         \brief Writes the \c bytes bytes pointed by \c data as they are.
+         */
+        void write(const void *data, size_t bytes);
+        /*!
+         \brief Writes zero bytes until the offset of the next byte is a multiple of \c alignment .
+         */
+        void align(size_t alignment);
+        /*!
+         \brief Writes the given byte.
+         */
+        inline void writeByte(uint8_t x) {
+            if (freeBytes < 1) {
+                reserve(1);
+            }
+            *bufptr++ = x;
+            freeBytes--;
+        }
+        /*!
+         \brief Writes the given unsigned integer in two bytes, encoded as big endian.
+         */
+        inline void writeInt16(uint16_t x) {
+            writeInt16Array(&x, 1);
+        }
+        /*!
+         \brief Writes the given unsigned integer in four bytes, encoded as big endian.
+         */
+        inline void writeInt32(uint32_t x) {
+            writeInt32Array(&x, 1);
+        }
+        /*!
+         \brief Writes the given floating point number in four bytes, encoded as big endian.
+         */
+        inline void writeFloat(float x) {
+            writeFloatArray(&x, 1);
+        }
+        /*!
+         \brief Writes the 16 floats of the given matrix, encoded as big endian. The layout of the floats for the matrix is column-major.
+         */
+        inline void writeMat4(const glm::mat4 &m) {
+            writeFloatArray(&m[0][0], 16);
+        }
+        
+        /*!
+         \brief Writes the \c count 16-bit unsigned integers in the array pointed by \c src , encoded as big endian.
+         */
+        void writeInt16Array(const uint16_t *src, size_t count);
+        /*!
+         \brief Writes the \c count 32-bit unsigned integers in the array pointed by \c src , encoded as big endian.
+         */
+        void writeInt32Array(const uint32_t *src, size_t count);
+        /*!
+         \brief Writes the \c count floats in the array pointed by \c src , encoded as big endian.
+         */
+        inline void writeFloatArray(const float *src, size_t count) {
+            writeInt32Array((const uint32_t *)src, count);
+        }
+        
+    };
+    
+}
+
+#endif
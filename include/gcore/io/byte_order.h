@@ -0,0 +1,154 @@
+//
+// => gcore/io/byte_order.h
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef __graphcore_io_byte_order
+#define __graphcore_io_byte_order
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+namespace gcore {
+    
+    /*!
+     \brief Returns whether the host stores multi-byte numbers in little endian.
+     */
+    inline bool isLittleEndianHost() {
+        const uint16_t probe = 1;
+        uint8_t first;
+        memcpy(&first, &probe, 1);
+        return first == 1;
+    }
+    
+    /*!
+     \brief Returns the given 16-bit word with its bytes in reverse order.
+     */
+    inline uint16_t byteSwap16(uint16_t x) {
+        return (uint16_t)((x << 8) | (x >> 8));
+    }
+    
+    /*!
+     \brief Returns the given 32-bit word with its bytes in reverse order.
+     */
+    inline uint32_t byteSwap32(uint32_t x) {
+        return (x << 24) | ((x << 8) & 0x00FF0000) | ((x >> 8) & 0x0000FF00) | (x >> 24);
+    }
+    
+    /*!
+     \brief Returns the given 64-bit word with its bytes in reverse order.
+     */
+    inline uint64_t byteSwap64(uint64_t x) {
+        return ((uint64_t)byteSwap32((uint32_t)x) << 32) | byteSwap32((uint32_t)(x >> 32));
+    }
+    
+    /*!
+     \brief Copies \c count 16-bit words from \c src to \c dst , reversing the byte order of each word.
+     \note Neither pointer needs to be aligned, and \c dst may be equal to \c src to swap in place.
+     */
+    void swapBytes16(void *dst, const void *src, size_t count);
+    
+    /*!
+     \brief Copies \c count 32-bit words from \c src to \c dst , reversing the byte order of each word.
+     \note Neither pointer needs to be aligned, and \c dst may be equal to \c src to swap in place.
+     */
+    void swapBytes32(void *dst, const void *src, size_t count);
+    
+    /*!
+     \brief Copies \c count 16-bit words encoded as big endian from \c src to \c dst , in the byte order of the host.
+     */
+    inline void bigEndianToHost16(void *dst, const void *src, size_t count) {
+        if (isLittleEndianHost()) {
+            swapBytes16(dst, src, count);
+        } else if (dst != src) {
+            memcpy(dst, src, count * 2);
+        }
+    }
+    
+    /*!
+     \brief Copies \c count 32-bit words encoded as big endian from \c src to \c dst , in the byte order of the host.
+     */
+    inline void bigEndianToHost32(void *dst, const void *src, size_t count) {
+        if (isLittleEndianHost()) {
+            swapBytes32(dst, src, count);
+        } else if (dst != src) {
+            memcpy(dst, src, count * 4);
+        }
+    }
+    
+    /*!
+     \brief Copies \c count 16-bit words encoded as little endian from \c src to \c dst , in the byte order of the host.
+     */
+    inline void littleEndianToHost16(void *dst, const void *src, size_t count) {
+        if (!isLittleEndianHost()) {
+            swapBytes16(dst, src, count);
+        } else if (dst != src) {
+            memcpy(dst, src, count * 2);
+        }
+    }
+    
+    /*!
+     \brief Copies \c count 16-bit words in the byte order of the host from \c src to \c dst , encoded as little endian.
+     */
+    inline void hostToLittleEndian16(void *dst, const void *src, size_t count) {
+        littleEndianToHost16(dst, src, count); // the conversion is symmetric
+    }
+    
+    /*!
+     \brief Copies \c count 32-bit words encoded as little endian from \c src to \c dst , in the byte order of the host.
+     \note This is the conversion needed by the native-endian blobs of FDMD v2, and it is a plain copy on little endian hosts.
+     */
+    inline void littleEndianToHost32(void *dst, const void *src, size_t count) {
+        if (!isLittleEndianHost()) {
+            swapBytes32(dst, src, count);
+        } else if (dst != src) {
+            memcpy(dst, src, count * 4);
+        }
+    }
+    
+    /*!
+     \brief Copies \c count 32-bit words in the byte order of the host from \c src to \c dst , encoded as little endian.
+     */
+    inline void hostToLittleEndian32(void *dst, const void *src, size_t count) {
+        littleEndianToHost32(dst, src, count); // the conversion is symmetric
+    }
+    
+    /*!
+     \brief Copies \c count 16-bit words in the byte order of the host from \c src to \c dst , encoded as big endian.
+     */
+    inline void hostToBigEndian16(void *dst, const void *src, size_t count) {
+        bigEndianToHost16(dst, src, count); // the conversion is symmetric
+    }
+    
+    /*!
+     \brief Copies \c count 32-bit words in the byte order of the host from \c src to \c dst , encoded as big endian.
+     */
+    inline void hostToBigEndian32(void *dst, const void *src, size_t count) {
+        bigEndianToHost32(dst, src, count); // the conversion is symmetric
+    }
+    
+}
+
+#endif
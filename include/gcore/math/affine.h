@@ -0,0 +1,89 @@
+//
+// => gcore/math/affine.h
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef __graphcore_math_affine
+#define __graphcore_math_affine
+
+#include <glm/glm.hpp>
+#include <glm/gtc/quaternion.hpp>
+
+#include <cstdint>
+
+namespace gcore {
+    
+    /*!
+     \brief An affine transform stored as the first three rows of its 4x4 matrix, whose last row is always (0, 0, 0, 1). Each row holds three coefficients of the linear part and a component of the translation.
+     \note The layout is that of a GLSL \c mat3x4 , which transforms a point \c p as \c vec4(p, 1) \c * \c m . Rows are aligned so that each loads into a single SIMD register.
+     */
+    struct alignas(16) Affine3x4 {
+        float rows[3][4];
+    };
+    
+    /*!
+     \brief Returns the rotation matrix of a unit quaternion.
+     */
+    glm::mat3 quaternionToMat3(const glm::quat &q);
+    
+    /*!
+     \brief Writes the affine part of \c m to \c out , dropping its last row.
+     */
+    void affineFromMat4(const glm::mat4 &m, Affine3x4 &out);
+    
+    /*!
+     \brief Returns the 4x4 matrix of an affine transform.
+     */
+    glm::mat4 affineToMat4(const Affine3x4 &a);
+    
+    /*!
+     \brief Writes to \c out the transform scaling by \c scale , then rotating by \c rotation , then translating by \c translation .
+     */
+    void composeTRS(const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale, Affine3x4 &out);
+    
+    /*!
+     \brief Writes the product \c a * \c b to \c out , which may be either operand.
+     */
+    void multiplyAffine(const Affine3x4 &a, const Affine3x4 &b, Affine3x4 &out);
+    
+    /*!
+     \brief Composes the transforms of \c count nodes stored as structure of arrays, with SIMD across the nodes.
+     \param components The component arrays one after the other, \c stride values apart: translation x, y, z, rotation x, y, z, w, scale x, y, z. The stride must be a multiple of \c GCORE_LANE_COUNT , and the padding is read but ignored.
+     \param weights If not \c nullptr , a value for each node: only the nodes with a weight greater than 0 are written to \c out .
+     */
+    void composeTRSBatch(const float *components, uint32_t stride, const float *weights, uint32_t count, Affine3x4 *out);
+    
+    /*!
+     \brief Writes the products \c a[i] * \c b[i] of \c count pairs of transforms to \c out as 4x4 matrices, as needed by a joint palette.
+     */
+    void multiplyAffineBatch(const Affine3x4 *a, const Affine3x4 *b, uint32_t count, glm::mat4 *out);
+    
+    /*!
+     \brief Writes the products \c a[i] * \c b[i] of \c count pairs of transforms to \c out , as needed by a 3x4 joint palette.
+     */
+    void multiplyAffineBatch(const Affine3x4 *a, const Affine3x4 *b, uint32_t count, Affine3x4 *out);
+    
+}
+
+#endif
@@ -0,0 +1,60 @@
+//
+// => gcore/math/dual_quaternion.h
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef __graphcore_math_dual_quaternion
+#define __graphcore_math_dual_quaternion
+
+#include <gcore/math/affine.h>
+
+namespace gcore {
+    
+    /*!
+     \brief A rigid transform as a unit dual quaternion: the rotation \c real and \c dual , which is half the translation times the rotation. Both are stored as x, y, z, w.
+     \note Dual quaternions blend rigid transforms without the volume loss of blended matrices, in half the size of a 4x4 matrix. They hold no scale.
+     */
+    struct alignas(16) DualQuaternion {
+        float real[4];
+        float dual[4];
+    };
+    
+    /*!
+     \brief Returns the unit quaternion of the rotation of an affine transform, removing the scale of each axis.
+     */
+    glm::quat affineRotation(const Affine3x4 &a);
+    
+    /*!
+     \brief Writes the rigid part of an affine transform to \c out , dropping its scale.
+     */
+    void affineToDualQuaternion(const Affine3x4 &a, DualQuaternion &out);
+    
+    /*!
+     \brief Returns the affine transform of a unit dual quaternion.
+     */
+    void dualQuaternionToAffine(const DualQuaternion &dq, Affine3x4 &out);
+    
+}
+
+#endif
@@ -0,0 +1,123 @@
+//
+// => gcore/math/simd_lanes.h
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef __graphcore_math_simd_lanes
+#define __graphcore_math_simd_lanes
+
+#include <cmath>
+#include <cstdint>
+#include <cstring>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GCORE_LANES_SSE2
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define GCORE_LANES_NEON
+#endif
+
+/*
+ Lanes of floats processed at once by the batch kernels, with the widest vector type available at compile time.
+ The scalar fallback is a single lane, so that the batch code is the same on every target.
+ */
+
+namespace gcore {
+    
+#if defined(__AVX2__)
+#define GCORE_LANE_COUNT 8
+    typedef __m256 Lanes;
+    inline Lanes lanesLoad(const float *p) { return _mm256_loadu_ps(p); }
+    inline void lanesStore(float *p, Lanes a) { _mm256_storeu_ps(p, a); }
+    inline Lanes lanesSet(float x) { return _mm256_set1_ps(x); }
+    inline Lanes lanesAdd(Lanes a, Lanes b) { return _mm256_add_ps(a, b); }
+    inline Lanes lanesSub(Lanes a, Lanes b) { return _mm256_sub_ps(a, b); }
+    inline Lanes lanesMul(Lanes a, Lanes b) { return _mm256_mul_ps(a, b); }
+    inline Lanes lanesDiv(Lanes a, Lanes b) { return _mm256_div_ps(a, b); }
+    inline Lanes lanesSqrt(Lanes a) { return _mm256_sqrt_ps(a); }
+    inline Lanes lanesAnd(Lanes a, Lanes b) { return _mm256_and_ps(a, b); }
+    inline Lanes lanesXor(Lanes a, Lanes b) { return _mm256_xor_ps(a, b); }
+    inline Lanes lanesGreater(Lanes a, Lanes b) { return _mm256_cmp_ps(a, b, _CMP_GT_OQ); }
+    inline uint32_t lanesMask(Lanes a) { return (uint32_t)_mm256_movemask_ps(a); }
+#elif defined(GCORE_LANES_SSE2)
+#define GCORE_LANE_COUNT 4
+    typedef __m128 Lanes;
+    inline Lanes lanesLoad(const float *p) { return _mm_loadu_ps(p); }
+    inline void lanesStore(float *p, Lanes a) { _mm_storeu_ps(p, a); }
+    inline Lanes lanesSet(float x) { return _mm_set1_ps(x); }
+    inline Lanes lanesAdd(Lanes a, Lanes b) { return _mm_add_ps(a, b); }
+    inline Lanes lanesSub(Lanes a, Lanes b) { return _mm_sub_ps(a, b); }
+    inline Lanes lanesMul(Lanes a, Lanes b) { return _mm_mul_ps(a, b); }
+    inline Lanes lanesDiv(Lanes a, Lanes b) { return _mm_div_ps(a, b); }
+    inline Lanes lanesSqrt(Lanes a) { return _mm_sqrt_ps(a); }
+    inline Lanes lanesAnd(Lanes a, Lanes b) { return _mm_and_ps(a, b); }
+    inline Lanes lanesXor(Lanes a, Lanes b) { return _mm_xor_ps(a, b); }
+    inline Lanes lanesGreater(Lanes a, Lanes b) { return _mm_cmpgt_ps(a, b); }
+    inline uint32_t lanesMask(Lanes a) { return (uint32_t)_mm_movemask_ps(a); }
+#elif defined(GCORE_LANES_NEON)
+#define GCORE_LANE_COUNT 4
+    typedef float32x4_t Lanes;
+    inline Lanes lanesLoad(const float *p) { return vld1q_f32(p); }
+    inline void lanesStore(float *p, Lanes a) { vst1q_f32(p, a); }
+    inline Lanes lanesSet(float x) { return vdupq_n_f32(x); }
+    inline Lanes lanesAdd(Lanes a, Lanes b) { return vaddq_f32(a, b); }
+    inline Lanes lanesSub(Lanes a, Lanes b) { return vsubq_f32(a, b); }
+    inline Lanes lanesMul(Lanes a, Lanes b) { return vmulq_f32(a, b); }
+    inline Lanes lanesDiv(Lanes a, Lanes b) { return vdivq_f32(a, b); }
+    inline Lanes lanesSqrt(Lanes a) { return vsqrtq_f32(a); }
+    inline Lanes lanesAnd(Lanes a, Lanes b) { return vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+    inline Lanes lanesXor(Lanes a, Lanes b) { return vreinterpretq_f32_u32(veorq_u32(vreinterpretq_u32_f32(a), vreinterpretq_u32_f32(b))); }
+    inline Lanes lanesGreater(Lanes a, Lanes b) { return vreinterpretq_f32_u32(vcgtq_f32(a, b)); }
+    inline uint32_t lanesMask(Lanes a) {
+        static const int32_t shifts[4] = { 0, 1, 2, 3 };
+        uint32x4_t bits = vshlq_u32(vshrq_n_u32(vreinterpretq_u32_f32(a), 31), vld1q_s32(shifts));
+        return vaddvq_u32(bits);
+    }
+#else
+#define GCORE_LANE_COUNT 1
+    typedef float Lanes;
+    inline uint32_t floatBits(float x) { uint32_t b; memcpy(&b, &x, sizeof(b)); return b; }
+    inline float bitsFloat(uint32_t b) { float x; memcpy(&x, &b, sizeof(x)); return x; }
+    inline Lanes lanesLoad(const float *p) { return *p; }
+    inline void lanesStore(float *p, Lanes a) { *p = a; }
+    inline Lanes lanesSet(float x) { return x; }
+    inline Lanes lanesAdd(Lanes a, Lanes b) { return a + b; }
+    inline Lanes lanesSub(Lanes a, Lanes b) { return a - b; }
+    inline Lanes lanesMul(Lanes a, Lanes b) { return a * b; }
+    inline Lanes lanesDiv(Lanes a, Lanes b) { return a / b; }
+    inline Lanes lanesSqrt(Lanes a) { return sqrtf(a); }
+    inline Lanes lanesAnd(Lanes a, Lanes b) { return bitsFloat(floatBits(a) & floatBits(b)); }
+    inline Lanes lanesXor(Lanes a, Lanes b) { return bitsFloat(floatBits(a) ^ floatBits(b)); }
+    inline Lanes lanesGreater(Lanes a, Lanes b) { return bitsFloat(a > b ? 0xFFFFFFFF : 0); }
+    inline uint32_t lanesMask(Lanes a) { return floatBits(a) >> 31; }
+#endif
+
+#define GCORE_LANES_ALL ((1u << GCORE_LANE_COUNT) - 1)
+    
+}
+
+#endif
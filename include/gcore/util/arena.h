@@ -0,0 +1,126 @@
+//
+// => gcore/util/arena.h
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#ifndef __graphcore_util_arena
+#define __graphcore_util_arena
+
+#include <cstddef>
+#include <cstdint>
+#include <new>
+#include <type_traits>
+#include <utility>
+
+namespace gcore {
+    
+    /*!
+     \brief A bump allocator handing out memory from large blocks, which are all freed at once when the arena is released or destroyed.
+     \note Objects placed in an arena are never destroyed individually, so only trivially destructible types can be created in it.
+     */
+    class Arena {
+        
+        struct Block {
+            Block *next;
+            size_t size;
+        };
+        
+        Block *head = nullptr;
+        uint8_t *cursor = nullptr;
+        uint8_t *end = nullptr;
+        
+        size_t capacity = 0;
+        size_t used = 0;
+        
+        /*!
+         \brief The minimum size of the blocks allocated when the arena runs out of memory.
+         */
+        size_t growSize;
+        
+        void addBlock(size_t size);
+        
+    public:
+        /*!
+         \brief Creates an arena, allocating a first block of \c initialSize bytes if it is not 0.
+         \param growSize The minimum size of the further blocks.
+         */
+        explicit Arena(size_t initialSize = 0, size_t growSize = 16384);
+        
+        ~Arena() {
+            release();
+        }
+        
+        Arena(const Arena &) = delete;
+        Arena &operator=(const Arena &) = delete;
+        
+        Arena(Arena &&other);
+        Arena &operator=(Arena &&other);
+        
+        /*!
+         \brief Returns \c size bytes aligned to \c alignment , which must be a power of two.
+         */
+        void *allocate(size_t size, size_t alignment = alignof(std::max_align_t));
+        
+        /*!
+         \brief Returns uninitialized storage for \c count objects of type \c T , or \c nullptr if \c count is 0.
+         */
+        template <typename T>
+        inline T *allocateArray(size_t count) {
+            return count ? (T *)allocate(sizeof(T) * count, alignof(T)) : nullptr;
+        }
+        
+        /*!
+         \brief Constructs an object in the arena.
+         */
+        template <typename T, typename... Args>
+        inline T *create(Args &&...args) {
+            static_assert(std::is_trivially_destructible<T>::value, "objects in an arena are never destroyed");
+            return new (allocate(sizeof(T), alignof(T))) T(std::forward<Args>(args)...);
+        }
+        
+        /*!
+         \brief Frees all the blocks of the arena, invalidating everything allocated from it.
+         */
+        void release();
+        
+        /*!
+         \brief Returns the total size of the blocks of the arena.
+         */
+        inline size_t getCapacity() const {
+            return capacity;
+        }
+        
+        /*!
+         \brief Returns the number of bytes handed out, including alignment padding.
+         */
+        inline size_t getUsed() const {
+            return used;
+        }
+        
+    };
+    
+}
+
+#endif
@@ -0,0 +1,86 @@
+//
+// => gcore/util/thread_pool.h
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#ifndef __graphcore_util_thread_pool
+#define __graphcore_util_thread_pool
+
+#include <condition_variable>
+#include <deque>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace gcore {
+    
+    /*!
+     \brief A fixed set of worker threads running the tasks submitted to it in FIFO order.
+     */
+    class ThreadPool {
+        
+        std::vector<std::thread> workers;
+        
+        std::mutex mutex;
+        std::condition_variable taskAvailable;
+        std::deque<std::function<void()>> tasks;
+        bool stopping = false;
+        
+        void work();
+        
+    public:
+        /*!
+         \brief Starts the given number of worker threads. With 0, one thread less than the hardware threads is started (at least one), leaving a core to the thread owning the GL context.
+         */
+        explicit ThreadPool(unsigned threadCount = 0);
+        
+        /*!
+         \brief Waits for the tasks already submitted to complete, then stops the workers.
+         */
+        ~ThreadPool();
+        
+        ThreadPool(const ThreadPool &) = delete;
+        ThreadPool &operator=(const ThreadPool &) = delete;
+        
+        inline unsigned getThreadCount() const {
+            return (unsigned)workers.size();
+        }
+        
+        /*!
+         \brief Queues a task to be run by one of the workers.
+         */
+        void submit(std::function<void()> task);
+        
+        /*!
+         \brief Runs \c body for every index in [0, count) on the workers and on the calling thread, and returns once all of them completed.
+         \note The calling thread takes part in the work, so this can be called from a task of the same pool without deadlocking.
+         */
+        void parallelFor(size_t count, const std::function<void(size_t)> &body);
+        
+    };
+    
+}
+
+#endif
@@ -0,0 +1,233 @@
+//
+// => gcore/graphics/asset_cache.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <gcore/graphics/asset_cache.h>
+
+#include <climits>
+#include <cstdlib>
+
+using namespace gcore;
+
+/*!
+ \brief Returns the absolute path of the given file with symbolic links and relative components resolved, or the path itself if the file does not exist.
+ */
+static std::string canonicalPath(const char *path) {
+    char resolved[PATH_MAX];
+    return realpath(path, resolved) ? std::string(resolved) : std::string(path);
+}
+
+static std::string modelOptionsKey(const ModelLoadOptions &options) {
+    std::string key = "|";
+    key += options.interleaveVertices ? '1' : '0';
+    key += options.packBoneData ? '1' : '0';
+    key += options.compressAnimations ? '1' : '0';
+    key += options.lazyAnimations ? '1' : '0';
+    key += options.keepMeshData ? '1' : '0';
+    key += '|' + std::to_string(options.animationFrameRate);
+    return key;
+}
+
+AssetCache::~AssetCache() {
+    std::lock_guard<std::mutex> lock(mutex);
+    for (auto &pair : entries) {
+        destroy(pair.second.get());
+    }
+}
+
+AssetEntry *AssetCache::acquire(const std::string &key, AssetKind kind, bool &created) {
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    std::unique_ptr<AssetEntry> &slot = entries[key];
+    created = !slot;
+    if (created) {
+        slot.reset(new AssetEntry(key, kind));
+    }
+    
+    AssetEntry *entry = slot.get();
+    entry->retain();
+    entry->lastUse = ++clock;
+    return entry;
+}
+
+void AssetCache::complete(AssetEntry *entry, void *asset) {
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    entry->asset = asset;
+    if (asset) {
+        measure(entry);
+        cpuMemory += entry->cpuSize;
+        gpuMemory += entry->gpuSize;
+    }
+    entry->state.store(asset ? AssetStateReady : AssetStateFailed, std::memory_order_release);
+}
+
+void AssetCache::measure(AssetEntry *entry) {
+    switch (entry->kind) {
+        case AssetKindModel: {
+            Model *model = (Model *)entry->asset;
+            entry->cpuSize = model->getCPUMemorySize();
+            entry->gpuSize = model->getGPUMemorySize();
+            break;
+        }
+        case AssetKindTexture:
+            entry->cpuSize = 0;
+            entry->gpuSize = ((Texture *)entry->asset)->getMemorySize();
+            break;
+        case AssetKindShader:
+            entry->cpuSize = entry->gpuSize = 0;
+            break;
+    }
+}
+
+void AssetCache::destroy(AssetEntry *entry) {
+    switch (entry->kind) {
+        case AssetKindModel:
+            delete (Model *)entry->asset;
+            break;
+        case AssetKindTexture:
+            delete (Texture *)entry->asset;
+            break;
+        case AssetKindShader:
+            delete (ShaderProgram *)entry->asset;
+            break;
+    }
+    entry->asset = nullptr;
+}
+
+AssetHandle<Model> AssetCache::getModel(const char *fileName, const ModelLoadOptions &options) {
+    std::string path = canonicalPath(fileName);
+    
+    bool created;
+    AssetEntry *entry = acquire("model:" + path + modelOptionsKey(options), AssetKindModel, created);
+    
+    if (created) {
+        if (loader) {
+            entry->request = loader->load(path.c_str(), options); // completed by update()
+        } else {
+            complete(entry, Model::fromFile(path.c_str(), options));
+        }
+    }
+    return AssetHandle<Model>(entry, true);
+}
+
+AssetHandle<Texture> AssetCache::getTexture(const char *fileName) {
+    std::string path = canonicalPath(fileName);
+    
+    bool created;
+    AssetEntry *entry = acquire("texture:" + path, AssetKindTexture, created);
+    
+    if (created) {
+        Texture *texture = new Texture(path.c_str());
+        if (!texture->good()) {
+            delete texture;
+            texture = nullptr;
+        }
+        complete(entry, texture);
+    }
+    return AssetHandle<Texture>(entry, true);
+}
+
+AssetHandle<ShaderProgram> AssetCache::getShader(const char *vShaderPath, const char *fShaderPath) {
+    std::string vPath = canonicalPath(vShaderPath);
+    std::string fPath = canonicalPath(fShaderPath);
+    
+    bool created;
+    AssetEntry *entry = acquire("shader:" + vPath + "|" + fPath, AssetKindShader, created);
+    
+    if (created) {
+        complete(entry, ShaderProgram::fromSources(vPath.c_str(), fPath.c_str()));
+    }
+    return AssetHandle<ShaderProgram>(entry, true);
+}
+
+void AssetCache::setBudget(size_t cpuBytes, size_t gpuBytes) {
+    std::lock_guard<std::mutex> lock(mutex);
+    cpuBudget = cpuBytes;
+    gpuBudget = gpuBytes;
+    evict();
+}
+
+void AssetCache::update(double uploadBudgetSeconds) {
+    if (loader) {
+        loader->processUploads(uploadBudgetSeconds);
+    }
+    
+    std::lock_guard<std::mutex> lock(mutex);
+    
+    cpuMemory = 0;
+    gpuMemory = 0;
+    
+    for (auto it = entries.begin(); it != entries.end();) {
+        AssetEntry *entry = it->second.get();
+        
+        if (entry->request && entry->request->isDone()) {
+            entry->asset = entry->request->takeModel();
+            entry->request.reset();
+            entry->state.store(entry->asset ? AssetStateReady : AssetStateFailed, std::memory_order_release);
+        }
+        
+        AssetState state = entry->getState();
+        if (state == AssetStateFailed && entry->refCount.load(std::memory_order_acquire) == 0) {
+            it = entries.erase(it); // let the asset be requested again
+            continue;
+        }
+        
+        if (state == AssetStateReady) {
+            measure(entry); // models change size as their animations are loaded and unloaded
+            cpuMemory += entry->cpuSize;
+            gpuMemory += entry->gpuSize;
+        }
+        ++it;
+    }
+    
+    evict();
+}
+
+void AssetCache::evict() {
+    while ((cpuBudget && cpuMemory > cpuBudget) || (gpuBudget && gpuMemory > gpuBudget)) {
+        auto victim = entries.end();
+        
+        for (auto it = entries.begin(); it != entries.end(); ++it) {
+            AssetEntry *entry = it->second.get();
+            if (entry->getState() != AssetStateReady || entry->refCount.load(std::memory_order_acquire) > 0) {
+                continue;
+            }
+            if (victim == entries.end() || entry->lastUse < victim->second->lastUse) {
+                victim = it;
+            }
+        }
+        
+        if (victim == entries.end()) {
+            return; // everything left is in use
+        }
+        
+        AssetEntry *entry = victim->second.get();
+        cpuMemory -= entry->cpuSize;
+        gpuMemory -= entry->gpuSize;
+        destroy(entry);
+        entries.erase(victim);
+    }
+}
@@ -25,12 +25,18 @@
 //
 
 #include <gcore/graphics/model/animation.h>
+#include <gcore/math/affine.h>
+#include <gcore/math/simd_lanes.h>
 
 #include <glm/glm.hpp>
 #include <glm/gtc/matrix_transform.hpp>
 #include <glm/gtx/quaternion.hpp>
 
 #include <math.h>
+#include <string.h>
+
+#include <algorithm>
+#include <vector>
 
 #include <iostream>
 
@@ -39,110 +45,702 @@
 using namespace gcore;
 
 
-void KeyFrameChannel::refreshNextKeyFrames(double t) {
+/*!
+ \brief Scale mapping the components of a quaternion other than the largest one, which are in [-1/sqrt(2), 1/sqrt(2)], to [-1, 1].
+ */
+#define SMALLEST_THREE_RANGE 1.41421356f
+
+static inline uint16_t compressKeyTime(float t, float duration) {
+    return duration > 0 ? (uint16_t)lroundf(fminf(fmaxf(t / duration, 0.0f), 1.0f) * 65535.0f) : 0;
+}
+
+static void compressVectorKeys(CompressedVectorTrack &track, const VectorKey *keys, uint32_t keyCount, float duration, Arena &arena) {
+    track.times = arena.allocateArray<uint16_t>(keyCount);
+    track.values = arena.allocateArray<uint16_t>(keyCount * 3);
     
-    double T = animation.getTotalDuration();
-    t = fmod(t, T);
+    for (int c = 0; c < 3; c++) {
+        float min = keys[0].v[c], max = keys[0].v[c];
+        for (uint32_t i = 1; i < keyCount; i++) {
+            min = fminf(min, keys[i].v[c]);
+            max = fmaxf(max, keys[i].v[c]);
+        }
+        track.rangeMin[c] = min;
+        track.rangeExtent[c] = max - min;
+    }
     
-    double revert = t;
+    for (uint32_t i = 0; i < keyCount; i++) {
+        track.times[i] = compressKeyTime(keys[i].t, duration);
+        for (int c = 0; c < 3; c++) {
+            float extent = track.rangeExtent[c];
+            track.values[i * 3 + c] = extent > 0 ? (uint16_t)lroundf((keys[i].v[c] - track.rangeMin[c]) / extent * 65535.0f) : 0;
+        }
+    }
+}
+
+static void compressQuaternionKeys(CompressedQuaternionTrack &track, const QuaternionKey *keys, uint32_t keyCount, float duration, Arena &arena) {
+    track.times = arena.allocateArray<uint16_t>(keyCount);
+    track.values = arena.allocateArray<uint16_t>(keyCount * 3);
     
+    for (uint32_t i = 0; i < keyCount; i++) {
+        track.times[i] = compressKeyTime(keys[i].t, duration);
+        
+        const glm::quat &q = keys[i].q;
+        float xyzw[4] = { q.x, q.y, q.z, q.w };
+        float length = sqrtf(xyzw[0] * xyzw[0] + xyzw[1] * xyzw[1] + xyzw[2] * xyzw[2] + xyzw[3] * xyzw[3]);
+        
+        uint32_t largest = 0;
+        for (uint32_t c = 1; c < 4; c++) {
+            if (fabsf(xyzw[c]) > fabsf(xyzw[largest])) {
+                largest = c;
+            }
+        }
+        
+        // q and -q are the same rotation: flip the quaternion so that the largest component is positive.
+        float sign = xyzw[largest] < 0 ? -1.0f : 1.0f;
+        float factor = length > 0 ? sign * SMALLEST_THREE_RANGE / length : 0.0f;
+        
+        uint16_t *packed = &track.values[i * 3];
+        for (uint32_t k = 0; k < 3; k++) {
+            float x = fminf(fmaxf(xyzw[(largest + k + 1) & 3] * factor, -1.0f), 1.0f);
+            packed[k] = (uint16_t)lroundf((x + 1.0f) * 0.5f * 32767.0f);
+        }
+        packed[0] |= (largest & 1) << 15;
+        packed[1] |= (largest >> 1) << 15;
+    }
+}
+
+static inline glm::vec3 decompressVector(const CompressedVectorTrack &track, uint32_t i) {
+    const uint16_t *packed = &track.values[i * 3];
+    return glm::vec3(track.rangeMin.x + track.rangeExtent.x * (packed[0] * (1.0f / 65535.0f)),
+                     track.rangeMin.y + track.rangeExtent.y * (packed[1] * (1.0f / 65535.0f)),
+                     track.rangeMin.z + track.rangeExtent.z * (packed[2] * (1.0f / 65535.0f)));
+}
+
+static inline glm::quat decompressQuaternion(const CompressedQuaternionTrack &track, uint32_t i) {
+    const uint16_t *packed = &track.values[i * 3];
     
-    uint32_t i;
+    // Branchless: the three components are rotated in place after the largest one.
+    uint32_t largest = (packed[0] >> 15) | ((packed[1] >> 15) << 1);
+    float a = ((packed[0] & 0x7FFF) * (2.0f / 32767.0f) - 1.0f) * (1.0f / SMALLEST_THREE_RANGE);
+    float b = ((packed[1] & 0x7FFF) * (2.0f / 32767.0f) - 1.0f) * (1.0f / SMALLEST_THREE_RANGE);
+    float c = ((packed[2] & 0x7FFF) * (2.0f / 32767.0f) - 1.0f) * (1.0f / SMALLEST_THREE_RANGE);
     
-    i = currentKeyFrame.nextPosKey;
-    if (posKeys) {
-        while (posKeys[i].t < t) {
-            i = (i+1) % posKeyCount;
-            //if (!i) t -= T;
-        }
-        currentKeyFrame.nextPosKey = i;
+    float xyzw[4];
+    xyzw[(largest + 1) & 3] = a;
+    xyzw[(largest + 2) & 3] = b;
+    xyzw[(largest + 3) & 3] = c;
+    xyzw[largest] = sqrtf(fmaxf(1.0f - a * a - b * b - c * c, 0.0f));
+    
+    return glm::quat(xyzw[3], xyzw[0], xyzw[1], xyzw[2]);
+}
+
+float KeyFrameChannel::posKeyTime(uint32_t i) const {
+    return compressed ? posTrack.times[i] * (animation.getTotalDuration() / 65535.0f) : posKeys[i].t;
+}
+
+float KeyFrameChannel::rotKeyTime(uint32_t i) const {
+    return compressed ? rotTrack.times[i] * (animation.getTotalDuration() / 65535.0f) : rotKeys[i].t;
+}
+
+float KeyFrameChannel::scalKeyTime(uint32_t i) const {
+    return compressed ? scalTrack.times[i] * (animation.getTotalDuration() / 65535.0f) : scalKeys[i].t;
+}
+
+glm::vec3 KeyFrameChannel::posKeyValue(uint32_t i) const {
+    return compressed ? decompressVector(posTrack, i) : posKeys[i].v;
+}
+
+glm::quat KeyFrameChannel::rotKeyValue(uint32_t i) const {
+    return compressed ? decompressQuaternion(rotTrack, i) : rotKeys[i].q;
+}
+
+glm::vec3 KeyFrameChannel::scalKeyValue(uint32_t i) const {
+    return compressed ? decompressVector(scalTrack, i) : scalKeys[i].v;
+}
+
+void KeyFrameChannel::compress(Arena &arena) {
+    if (compressed) {
+        return;
+    }
+    
+    float duration = animation.getTotalDuration();
+    
+    // The raw keys are left in the arena of the animation, which is released once all the channels are compressed.
+    if (posKeyCount) {
+        compressVectorKeys(posTrack, posKeys, posKeyCount, duration, arena);
+        posKeys = nullptr;
+    }
+    if (rotKeyCount) {
+        compressQuaternionKeys(rotTrack, rotKeys, rotKeyCount, duration, arena);
+        rotKeys = nullptr;
+    }
+    if (scalKeyCount) {
+        compressVectorKeys(scalTrack, scalKeys, scalKeyCount, duration, arena);
+        scalKeys = nullptr;
+    }
+    
+    compressed = true;
+}
+
+size_t KeyFrameChannel::getCompressedArenaSize() const {
+    // A time and three values per key, with the padding of each array.
+    return (posKeyCount + rotKeyCount + scalKeyCount) * 4 * sizeof(uint16_t) + 6 * alignof(uint16_t);
+}
+
+size_t KeyFrameChannel::getMemorySize() const {
+    if (compressed) {
+        size_t vectorTracks = (posKeyCount ? sizeof(glm::vec3) * 2 : 0) + (scalKeyCount ? sizeof(glm::vec3) * 2 : 0);
+        return (posKeyCount + rotKeyCount + scalKeyCount) * 4 * sizeof(uint16_t) + vectorTracks;
+    }
+    return (posKeyCount + scalKeyCount) * sizeof(VectorKey) + rotKeyCount * sizeof(QuaternionKey);
+}
+
+
+
+
+/*!
+ \brief Returns the index of the first of \c count keys whose time is after \c t , which is \c count if there is none.
+ \note The search starts from \c hint , the result of the previous search: playing forward checks one or two keys, and jumps forward gallop before a binary search, so any seek costs O(log n). The result does not depend on \c hint .
+ */
+template <typename KeyTime>
+static uint32_t seekKey(uint32_t count, uint32_t hint, float t, KeyTime keyTime) {
+    if (hint > count) {
+        hint = count;
     }
     
-    t = revert;
-    i = currentKeyFrame.nextRotKey;
-    if (rotKeys) {
-        while (rotKeys[i].t < t) {
-            i = (i+1) % rotKeyCount;
-            //if (!i) t -= T;
+    uint32_t lo, hi;
+    if (hint < count && keyTime(hint) <= t) {
+        // Forward: probe at growing distances until a key after t is found.
+        lo = hint + 1;
+        hi = count;
+        for (uint32_t step = 1; lo < count; step <<= 1) {
+            uint32_t probe = std::min(lo + step - 1, count - 1);
+            if (keyTime(probe) > t) {
+                hi = probe;
+                break;
+            }
+            lo = probe + 1;
         }
-        currentKeyFrame.nextRotKey = i;
+    } else {
+        if (hint == 0 || keyTime(hint - 1) <= t) {
+            return hint;
+        }
+        // Backward, e.g. when the clip restarts.
+        lo = 0;
+        hi = hint - 1;
     }
     
-    t = revert;
-    i = currentKeyFrame.nextScalKey;
-    if (scalKeys) {
-        while (scalKeys[i].t < t) {
-            i = (i+1) % scalKeyCount;
-            //if (!i) t -= T;
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo) / 2;
+        if (keyTime(mid) <= t) {
+            lo = mid + 1;
+        } else {
+            hi = mid;
         }
-        currentKeyFrame.nextScalKey = i;
     }
+    return lo;
 }
 
+/*!
+ \brief Returns the keys to interpolate at \c t given the result of \c seekKey() , and the factor between them.
+ \param extrapolate Whether times out of the keys are extrapolated from the two nearest keys, rather than clamped to the nearest one.
+ */
+template <typename KeyTime>
+static float keyPair(uint32_t count, uint32_t next, float t, bool extrapolate, KeyTime keyTime, uint32_t &first, uint32_t &second) {
+    if (count == 1 || (!extrapolate && (next == 0 || next == count))) {
+        first = second = next == 0 ? 0 : next - 1;
+        return 0.0f;
+    }
+    
+    second = std::min(std::max(next, 1u), count - 1);
+    first = second - 1;
+    
+    float t0 = keyTime(first), t1 = keyTime(second);
+    return t1 > t0 ? (t - t0) / (t1 - t0) : 0.0f;
+}
 
-glm::vec3 interpolate(glm::vec3 last, glm::vec3 next, float t) {
-    return last + t * next;
+static inline glm::vec3 lerpVector(const glm::vec3 &a, const glm::vec3 &b, float f) {
+    return glm::vec3(a.x + (b.x - a.x) * f, a.y + (b.y - a.y) * f, a.z + (b.z - a.z) * f);
 }
 
+/*!
+ \brief Interpolates two unit quaternions along the shortest arc, with a normalized lerp when they are closer than \c DOT_THRESHOLD .
+ */
+static glm::quat slerpRotation(const glm::quat &a, glm::quat b, float f) {
+    float dot = a.x * b.x + a.y * b.y + a.z * b.z + a.w * b.w;
+    if (dot < 0.0f) {
+        b = glm::quat(-b.w, -b.x, -b.y, -b.z);
+        dot = -dot;
+    }
+    
+    float wa, wb;
+    if (dot > DOT_THRESHOLD) {
+        wa = 1.0f - f;
+        wb = f;
+    } else {
+        float theta = acosf(dot);
+        float sinTheta = sinf(theta);
+        wa = sinf((1.0f - f) * theta) / sinTheta;
+        wb = sinf(f * theta) / sinTheta;
+    }
+    
+    float x = wa * a.x + wb * b.x, y = wa * a.y + wb * b.y, z = wa * a.z + wb * b.z, w = wa * a.w + wb * b.w;
+    float length = sqrtf(x * x + y * y + z * z + w * w);
+    float inverse = length > 0 ? 1.0f / length : 0.0f;
+    return glm::quat(w * inverse, x * inverse, y * inverse, z * inverse);
+}
 
+float KeyFrameChannel::getStartTime() const {
+    float start = INFINITY;
+    if (posKeyCount) start = fminf(start, posKeyTime(0));
+    if (rotKeyCount) start = fminf(start, rotKeyTime(0));
+    if (scalKeyCount) start = fminf(start, scalKeyTime(0));
+    return start;
+}
 
+float KeyFrameChannel::getEndTime() const {
+    float end = -INFINITY;
+    if (posKeyCount) end = fmaxf(end, posKeyTime(posKeyCount - 1));
+    if (rotKeyCount) end = fmaxf(end, rotKeyTime(rotKeyCount - 1));
+    if (scalKeyCount) end = fmaxf(end, scalKeyTime(scalKeyCount - 1));
+    return end;
+}
 
-inline uint32_t getLastKeyFrame(const uint32_t next, const uint32_t keyCount) {
-    return (next > 0 ? next : keyCount) - 1;
+bool KeyFrameChannel::sampleKeys(double time, KeyFrame &cursor, KeySample &sample) const {
+    if (animation.baked) {
+        return animation.frameKeys((uint32_t)(this - animation.keyChannels), time, sample);
+    }
+    
+    float t = (float)time;
+    float start = getStartTime(), end = getEndTime();
+    
+    // Before the first key or after the last one, the channel behaves as its pre or post state says.
+    AnimationBehaviour behaviour = t < start ? preState : t > end ? postState : AnimationBehaviourConstant;
+    switch (behaviour) {
+        case AnimationBehaviourToBindPose:
+            return false;
+        case AnimationBehaviourRepeat:
+            if (end > start) {
+                t = start + fmodf(t - start, end - start);
+                if (t < start) {
+                    t += end - start;
+                }
+            }
+            break;
+        default:
+            break;
+    }
+    bool extrapolate = behaviour == AnimationBehaviourLinear;
+    
+    uint32_t first, second;
+    
+    if (posKeyCount) {
+        auto keyTime = [this](uint32_t i) { return posKeyTime(i); };
+        cursor.nextPosKey = seekKey(posKeyCount, cursor.nextPosKey, t, keyTime);
+        sample.positionFactor = keyPair(posKeyCount, cursor.nextPosKey, t, extrapolate, keyTime, first, second);
+        sample.position[0] = posKeyValue(first);
+        sample.position[1] = first == second ? sample.position[0] : posKeyValue(second);
+    } else {
+        sample.position[0] = sample.position[1] = glm::vec3(0.0f);
+        sample.positionFactor = 0.0f;
+    }
+    
+    if (rotKeyCount) {
+        // Rotations are not extrapolated: the slerp factor is clamped, holding the nearest key.
+        auto keyTime = [this](uint32_t i) { return rotKeyTime(i); };
+        cursor.nextRotKey = seekKey(rotKeyCount, cursor.nextRotKey, t, keyTime);
+        sample.rotationFactor = fminf(fmaxf(keyPair(rotKeyCount, cursor.nextRotKey, t, false, keyTime, first, second), 0.0f), 1.0f);
+        sample.rotation[0] = rotKeyValue(first);
+        sample.rotation[1] = first == second ? sample.rotation[0] : rotKeyValue(second);
+    } else {
+        sample.rotation[0] = sample.rotation[1] = glm::quat(1.0f, 0.0f, 0.0f, 0.0f);
+        sample.rotationFactor = 0.0f;
+    }
+    
+    if (scalKeyCount) {
+        auto keyTime = [this](uint32_t i) { return scalKeyTime(i); };
+        cursor.nextScalKey = seekKey(scalKeyCount, cursor.nextScalKey, t, keyTime);
+        sample.scaleFactor = keyPair(scalKeyCount, cursor.nextScalKey, t, extrapolate, keyTime, first, second);
+        sample.scale[0] = scalKeyValue(first);
+        sample.scale[1] = first == second ? sample.scale[0] : scalKeyValue(second);
+    } else {
+        sample.scale[0] = sample.scale[1] = glm::vec3(1.0f);
+        sample.scaleFactor = 0.0f;
+    }
+    
+    return true;
 }
 
+bool KeyFrameChannel::sampleTransform(double t, KeyFrame &cursor, glm::vec3 &position, glm::quat &rotation, glm::vec3 &scale) const {
+    KeySample sample;
+    if (!sampleKeys(t, cursor, sample)) {
+        return false;
+    }
+    
+    position = lerpVector(sample.position[0], sample.position[1], sample.positionFactor);
+    rotation = sample.rotationFactor > 0 ? slerpRotation(sample.rotation[0], sample.rotation[1], sample.rotationFactor) : sample.rotation[0];
+    scale = lerpVector(sample.scale[0], sample.scale[1], sample.scaleFactor);
+    return true;
+}
 
-glm::mat3 quat_to_mat(glm::quat q) {
-    glm::mat3 ret;
-    ret[0][0] = 1.0f - 2.0f * (q.y * q.y + q.z * q.z);
-    ret[1][0] = 2.0f * (q.x * q.y - q.z * q.w);
-    ret[2][0] = 2.0f * (q.x * q.z + q.y * q.w);
-    ret[0][1] = 2.0f * (q.x * q.y + q.z * q.w);
-    ret[1][1] = 1.0f - 2.0f * (q.x * q.x + q.z * q.z);
-    ret[2][1] = 2.0f * (q.y * q.z - q.x * q.w);
-    ret[0][2] = 2.0f * (q.x * q.z - q.y * q.w);
-    ret[1][2] = 2.0f * (q.y * q.z + q.x * q.w);
-    ret[2][2] = 1.0f - 2.0f * (q.x * q.x + q.y * q.y);
+glm::mat4 KeyFrameChannel::interpolateJoint(double t, KeyFrame &cursor) const {
+    
+    glm::vec3 pos, scal;
+    glm::quat rot;
+    
+    if (!sampleTransform(t, cursor, pos, rot, scal)) {
+        return affectedBone.getBindPose();
+    }
     
-    return ret;
+    Affine3x4 transform;
+    composeTRS(pos, rot, scal, transform);
+    return affineToMat4(transform);
 }
 
 
-glm::mat4 KeyFrameChannel::interpolateJoint(double t) {
-    
-    refreshNextKeyFrames(t);
+
+
+/*!
+ \brief Returns the length of the arrays holding a value for each of \c count channels, padded to whole batches of lanes.
+ */
+static inline uint32_t batchStride(uint32_t count) {
+    return (count + GCORE_LANE_COUNT - 1) / GCORE_LANE_COUNT * GCORE_LANE_COUNT;
+}
+
+/*!
+ \brief The frames around the time sampled, one array per component, as gathered by the first pass of \c Animation::sample() on a baked animation.
+ \note The interpolated values are written back over the first key of each pair.
+ */
+enum : uint32_t {
+    BatchPosition0 = 0, BatchPosition1 = 3, BatchPositionFactor = 6,
+    BatchRotation0 = 7, BatchRotation1 = 11, BatchRotationFactor = 15,
+    BatchScale0 = 16, BatchScale1 = 19, BatchScaleFactor = 22,
+    BatchArrayCount = 23
+};
+
+/*!
+ \brief Lerps \c count values of \c components arrays in place: a[c][i] += (b[c][i] - a[c][i]) * f[i] .
+ */
+static void lerpLanes(float *a, const float *b, const float *f, uint32_t components, uint32_t stride, uint32_t count) {
+    for (uint32_t c = 0; c < components; c++) {
+        float *ac = a + c * stride;
+        const float *bc = b + c * stride;
+        for (uint32_t i = 0; i < count; i += GCORE_LANE_COUNT) {
+            Lanes x = lanesLoad(ac + i);
+            lanesStore(ac + i, lanesAdd(x, lanesMul(lanesSub(lanesLoad(bc + i), x), lanesLoad(f + i))));
+        }
+    }
+}
+
+/*!
+ \brief Slerps \c count pairs of quaternions in place, with the same results as \c slerpRotation() up to rounding.
+ \note Lanes closer than \c DOT_THRESHOLD are nlerped in SIMD; the weights of the others are computed with scalar trigonometry, and the combination and normalization are SIMD again.
+ */
+static void slerpLanes(float *a, const float *b, const float *f, uint32_t stride, uint32_t count) {
+    const Lanes signBit = lanesSet(-0.0f);
+    const Lanes one = lanesSet(1.0f);
+    const Lanes threshold = lanesSet((float)DOT_THRESHOLD);
     
-    const KeyFrame &current = currentKeyFrame;
+    float *ax = a, *ay = a + stride, *az = a + 2 * stride, *aw = a + 3 * stride;
+    const float *bx = b, *by = b + stride, *bz = b + 2 * stride, *bw = b + 3 * stride;
     
-    uint32_t nextKey;
-    uint32_t lastKey;
+    for (uint32_t i = 0; i < count; i += GCORE_LANE_COUNT) {
+        Lanes qax = lanesLoad(ax + i), qay = lanesLoad(ay + i), qaz = lanesLoad(az + i), qaw = lanesLoad(aw + i);
+        Lanes qbx = lanesLoad(bx + i), qby = lanesLoad(by + i), qbz = lanesLoad(bz + i), qbw = lanesLoad(bw + i);
+        
+        Lanes dot = lanesAdd(lanesAdd(lanesMul(qax, qbx), lanesMul(qay, qby)), lanesAdd(lanesMul(qaz, qbz), lanesMul(qaw, qbw)));
+        
+        // Flip b where the dot is negative, to take the shortest arc.
+        Lanes sign = lanesAnd(dot, signBit);
+        dot = lanesXor(dot, sign);
+        qbx = lanesXor(qbx, sign);
+        qby = lanesXor(qby, sign);
+        qbz = lanesXor(qbz, sign);
+        qbw = lanesXor(qbw, sign);
+        
+        Lanes wb = lanesLoad(f + i);
+        Lanes wa = lanesSub(one, wb);
+        
+        uint32_t nlerp = lanesMask(lanesGreater(dot, threshold));
+        if (nlerp != GCORE_LANES_ALL) {
+            float dots[GCORE_LANE_COUNT], was[GCORE_LANE_COUNT], wbs[GCORE_LANE_COUNT];
+            lanesStore(dots, dot);
+            lanesStore(was, wa);
+            lanesStore(wbs, wb);
+            for (uint32_t l = 0; l < GCORE_LANE_COUNT; l++) {
+                if (!(nlerp & (1u << l))) {
+                    float theta = acosf(dots[l]);
+                    float sinTheta = sinf(theta);
+                    float factor = wbs[l];
+                    was[l] = sinf((1.0f - factor) * theta) / sinTheta;
+                    wbs[l] = sinf(factor * theta) / sinTheta;
+                }
+            }
+            wa = lanesLoad(was);
+            wb = lanesLoad(wbs);
+        }
+        
+        Lanes x = lanesAdd(lanesMul(wa, qax), lanesMul(wb, qbx));
+        Lanes y = lanesAdd(lanesMul(wa, qay), lanesMul(wb, qby));
+        Lanes z = lanesAdd(lanesMul(wa, qaz), lanesMul(wb, qbz));
+        Lanes w = lanesAdd(lanesMul(wa, qaw), lanesMul(wb, qbw));
+        
+        Lanes inverse = lanesDiv(one, lanesSqrt(lanesAdd(lanesAdd(lanesMul(x, x), lanesMul(y, y)), lanesAdd(lanesMul(z, z), lanesMul(w, w)))));
+        lanesStore(ax + i, lanesMul(x, inverse));
+        lanesStore(ay + i, lanesMul(y, inverse));
+        lanesStore(az + i, lanesMul(z, inverse));
+        lanesStore(aw + i, lanesMul(w, inverse));
+    }
+}
+
+void Animation::framePair(double t, uint32_t &frame, float &factor) const {
+    float x = fminf(fmaxf((float)t * frameRate, 0.0f), (float)(frameCount - 1));
+    frame = std::min((uint32_t)x, frameCount - 2);
+    factor = x - frame;
+}
+
+bool Animation::frameKeys(uint32_t channel, double t, KeySample &sample) const {
+    uint32_t frame;
+    float f;
+    framePair(t, frame, f);
     
-    glm::vec3 pos = posKeys[current.nextPosKey].v;
-    glm::quat rot = rotKeys[current.nextRotKey].q;
-    glm::vec3 scal = scalKeys[current.nextScalKey].v;
+    // A channel entering or leaving its bind pose between two frames switches at the nearest one.
+    if (!frameAnimated[(frame + (f >= 0.5f)) * keyChannelsCount + channel]) {
+        return false;
+    }
     
+    for (uint32_t k = 0; k < 2; k++) {
+        const float *values = frames + (size_t)(frame + k) * Pose::ComponentCount * frameStride + channel;
+        sample.position[k] = glm::vec3(values[Pose::TranslationX * frameStride], values[Pose::TranslationY * frameStride], values[Pose::TranslationZ * frameStride]);
+        sample.rotation[k] = glm::quat(values[Pose::RotationW * frameStride], values[Pose::RotationX * frameStride], values[Pose::RotationY * frameStride], values[Pose::RotationZ * frameStride]);
+        sample.scale[k] = glm::vec3(values[Pose::ScaleX * frameStride], values[Pose::ScaleY * frameStride], values[Pose::ScaleZ * frameStride]);
+    }
+    sample.positionFactor = sample.rotationFactor = sample.scaleFactor = f;
+    return true;
+}
 
-    glm::mat4 ret = glm::mat4_cast(rot);// * glm::scale(glm::mat4(), scal);
+void Animation::sample(double t, KeyFrame *cursors, Pose &pose, float weight, PoseBlendMode mode, const BoneMask *mask) const {
+    if (weight <= 0) {
+        return;
+    }
+    
+    const float *referenceComponents = reference.data();
+    auto blend = [&](uint32_t i, glm::vec3 position, glm::quat rotation, glm::vec3 scale) {
+        uint32_t node = keyChannels[i].getAffectedBone().getBoneID();
+        
+        if (mode == PoseBlendAdditive) {
+            // The difference from the reference: position - p, conjugate(r) * rotation and scale / s.
+            const float *ref = referenceComponents + i;
+            uint32_t n = keyChannelsCount;
+            position -= glm::vec3(ref[Pose::TranslationX * n], ref[Pose::TranslationY * n], ref[Pose::TranslationZ * n]);
+            
+            float rx = -ref[Pose::RotationX * n], ry = -ref[Pose::RotationY * n], rz = -ref[Pose::RotationZ * n], rw = ref[Pose::RotationW * n];
+            rotation = glm::quat(rw * rotation.w - rx * rotation.x - ry * rotation.y - rz * rotation.z,
+                                 rw * rotation.x + rx * rotation.w + ry * rotation.z - rz * rotation.y,
+                                 rw * rotation.y - rx * rotation.z + ry * rotation.w + rz * rotation.x,
+                                 rw * rotation.z + rx * rotation.y - ry * rotation.x + rz * rotation.w);
+            
+            for (uint32_t c = 0; c < 3; c++) {
+                float s = ref[(Pose::ScaleX + c) * n];
+                scale[c] = s != 0 ? scale[c] / s : 1.0f;
+            }
+        }
+        
+        pose.blendTransform(node, position, rotation, scale, mask ? weight * mask->getWeight(node) : weight, mode);
+    };
+    
+    if (!baked) {
+        // The key search dominates the cost of raw keys: gathering them into lanes only adds a transposition, so each channel is
+        // interpolated as soon as its keys are found.
+        glm::vec3 position, scale;
+        glm::quat rotation;
+        for (uint32_t i = 0; i < keyChannelsCount; i++) {
+            // Masked out channels are skipped as if in their bind pose, without seeking their keys.
+            if (mask && mask->getWeight(keyChannels[i].getAffectedBone().getBoneID()) <= 0) {
+                continue;
+            }
+            if (keyChannels[i].sampleTransform(t, cursors[i], position, rotation, scale)) {
+                blend(i, position, rotation, scale);
+            }
+        }
+        return;
+    }
     
+    uint32_t stride = batchStride(keyChannelsCount);
     
-    ret[0][0] *= scal.x; ret[1][0] *= scal.y; ret[2][0] *= scal.z; ret[3][0] = pos.x;
-    ret[0][1] *= scal.x; ret[1][1] *= scal.y; ret[2][1] *= scal.z; ret[3][1] = pos.y;
-    ret[0][2] *= scal.x; ret[1][2] *= scal.y; ret[2][2] *= scal.z; ret[3][2] = pos.z;
+    thread_local std::vector<float> batch;
+    thread_local std::vector<uint8_t> bindPose;
+    bindPose.resize(keyChannelsCount);
+    batch.resize((size_t)stride * BatchArrayCount);
     
-    return ret;
+    float *arrays = batch.data();
+    auto array = [arrays, stride](uint32_t index) { return arrays + (size_t)index * stride; };
+    
+    // First pass: the keys of all the channels are the two frames around t, whose padding already holds identity keys.
+    uint32_t frame;
+    float f;
+    framePair(t, frame, f);
+    
+    const float *first = frames + (size_t)frame * Pose::ComponentCount * stride;
+    const float *second = first + (size_t)Pose::ComponentCount * stride;
+    memcpy(array(BatchPosition0), first + Pose::TranslationX * stride, 3 * stride * sizeof(float));
+    memcpy(array(BatchPosition1), second + Pose::TranslationX * stride, 3 * stride * sizeof(float));
+    memcpy(array(BatchRotation0), first + Pose::RotationX * stride, 4 * stride * sizeof(float));
+    memcpy(array(BatchRotation1), second + Pose::RotationX * stride, 4 * stride * sizeof(float));
+    memcpy(array(BatchScale0), first + Pose::ScaleX * stride, 3 * stride * sizeof(float));
+    memcpy(array(BatchScale1), second + Pose::ScaleX * stride, 3 * stride * sizeof(float));
+    std::fill(array(BatchPositionFactor), array(BatchPositionFactor) + stride, f);
+    std::fill(array(BatchRotationFactor), array(BatchRotationFactor) + stride, f);
+    std::fill(array(BatchScaleFactor), array(BatchScaleFactor) + stride, f);
+    
+    const uint8_t *animated = frameAnimated + (frame + (f >= 0.5f)) * keyChannelsCount;
+    for (uint32_t i = 0; i < keyChannelsCount; i++) {
+        bindPose[i] = !animated[i] || (mask && mask->getWeight(keyChannels[i].getAffectedBone().getBoneID()) <= 0);
+    }
+    
+    // Second pass, across channels: interpolate all the pairs of keys in SIMD.
+    lerpLanes(array(BatchPosition0), array(BatchPosition1), array(BatchPositionFactor), 3, stride, stride);
+    lerpLanes(array(BatchScale0), array(BatchScale1), array(BatchScaleFactor), 3, stride, stride);
+    slerpLanes(array(BatchRotation0), array(BatchRotation1), array(BatchRotationFactor), stride, stride);
+    
+    // Third pass: blend the transforms into the nodes of the pose.
+    for (uint32_t i = 0; i < keyChannelsCount; i++) {
+        if (bindPose[i]) {
+            continue;
+        }
+        
+        glm::vec3 position(array(BatchPosition0)[i], array(BatchPosition0 + 1)[i], array(BatchPosition0 + 2)[i]);
+        glm::quat rotation(array(BatchRotation0 + 3)[i], array(BatchRotation0)[i], array(BatchRotation0 + 1)[i], array(BatchRotation0 + 2)[i]);
+        glm::vec3 scale(array(BatchScale0)[i], array(BatchScale0 + 1)[i], array(BatchScale0 + 2)[i]);
+        blend(i, position, rotation, scale);
+    }
 }
 
+void Animation::bake(float rate) {
+    if (rate <= 0) {
+        return;
+    }
+    
+    uint32_t count = totalDuration > 0 ? std::max((uint32_t)ceilf(totalDuration * rate) + 1, 2u) : 2;
+    if (baked && count == frameCount) {
+        return;
+    }
+    
+    uint32_t stride = batchStride(keyChannelsCount);
+    size_t frameValues = (size_t)count * Pose::ComponentCount * stride;
+    size_t arenaSize = keyChannelsCount * sizeof(KeyFrameChannel) + alignof(KeyFrameChannel)
+                       + frameValues * sizeof(float) + alignof(float) + (size_t)count * keyChannelsCount;
+    
+    Arena bakedArena(arenaSize);
+    KeyFrameChannel *bakedChannels = bakedArena.allocateArray<KeyFrameChannel>(keyChannelsCount);
+    float *bakedFrames = bakedArena.allocateArray<float>(frameValues);
+    uint8_t *bakedAnimated = bakedArena.allocateArray<uint8_t>((size_t)count * keyChannelsCount);
+    
+    // Sampled forward, so that each channel seeks its keys from the previous frame.
+    std::vector<KeyFrame> cursors(keyChannelsCount);
+    float interval = totalDuration > 0 ? totalDuration / (count - 1) : 0.0f;
+    
+    for (uint32_t frame = 0; frame < count; frame++) {
+        double t = frame == count - 1 ? totalDuration : frame * interval;
+        float *values = bakedFrames + (size_t)frame * Pose::ComponentCount * stride;
+        
+        for (uint32_t i = 0; i < stride; i++) {
+            // Channels in their bind pose and the padding hold identity keys.
+            glm::vec3 position(0.0f), scale(1.0f);
+            glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+            if (i < keyChannelsCount) {
+                bakedAnimated[frame * keyChannelsCount + i] = keyChannels[i].sampleTransform(t, cursors[i], position, rotation, scale);
+            }
+            
+            values[Pose::TranslationX * stride + i] = position.x;
+            values[Pose::TranslationY * stride + i] = position.y;
+            values[Pose::TranslationZ * stride + i] = position.z;
+            values[Pose::RotationX * stride + i] = rotation.x;
+            values[Pose::RotationY * stride + i] = rotation.y;
+            values[Pose::RotationZ * stride + i] = rotation.z;
+            values[Pose::RotationW * stride + i] = rotation.w;
+            values[Pose::ScaleX * stride + i] = scale.x;
+            values[Pose::ScaleY * stride + i] = scale.y;
+            values[Pose::ScaleZ * stride + i] = scale.z;
+        }
+    }
+    
+    // The channels keep only their bone: the keys are left in the old arena, released below.
+    for (uint32_t i = 0; i < keyChannelsCount; i++) {
+        KeyFrameChannel *keyChannel = new (&bakedChannels[i]) KeyFrameChannel(*this, keyChannels[i].affectedBone);
+        keyChannel->preState = keyChannels[i].preState;
+        keyChannel->postState = keyChannels[i].postState;
+    }
+    
+    keyChannels = bakedChannels;
+    frames = bakedFrames;
+    frameAnimated = bakedAnimated;
+    frameStride = stride;
+    frameCount = count;
+    frameRate = interval > 0 ? 1.0f / interval : 0.0f;
+    arena = std::move(bakedArena);
+    baked = true;
+    compressed = false;
+    
+    computeReference();
+}
 
+void Animation::computeReference() {
+    reference.assign((size_t)Pose::ComponentCount * keyChannelsCount, 0.0f);
+    
+    uint32_t n = keyChannelsCount;
+    for (uint32_t i = 0; i < n; i++) {
+        KeyFrame cursor;
+        glm::vec3 position(0.0f), scale(1.0f);
+        glm::quat rotation(1.0f, 0.0f, 0.0f, 0.0f);
+        keyChannels[i].sampleTransform(0.0, cursor, position, rotation, scale);
+        
+        reference[Pose::TranslationX * n + i] = position.x;
+        reference[Pose::TranslationY * n + i] = position.y;
+        reference[Pose::TranslationZ * n + i] = position.z;
+        reference[Pose::RotationX * n + i] = rotation.x;
+        reference[Pose::RotationY * n + i] = rotation.y;
+        reference[Pose::RotationZ * n + i] = rotation.z;
+        reference[Pose::RotationW * n + i] = rotation.w;
+        reference[Pose::ScaleX * n + i] = scale.x;
+        reference[Pose::ScaleY * n + i] = scale.y;
+        reference[Pose::ScaleZ * n + i] = scale.z;
+    }
+}
 
-void Animation::update(double dt) {
+void Animation::compress() {
+    if (compressed || baked) {
+        return;
+    }
     
-    elapsed += dt;
+    size_t arenaSize = keyChannelsCount * sizeof(KeyFrameChannel) + alignof(KeyFrameChannel);
+    for (uint32_t i = 0; i < keyChannelsCount; i++) {
+        arenaSize += keyChannels[i].getCompressedArenaSize();
+    }
     
-    for (uint32_t i = 0; i < keyChannelsCount; i++)
-    {
-        KeyFrameChannel &keyChannel = *keyChannels[i];
-        
-        keyChannel.getAffectedBone().joint() = keyChannel.interpolateJoint(elapsed);
+    Arena compressedArena(arenaSize);
+    KeyFrameChannel *compressedChannels = compressedArena.allocateArray<KeyFrameChannel>(keyChannelsCount);
+    
+    for (uint32_t i = 0; i < keyChannelsCount; i++) {
+        KeyFrameChannel *keyChannel = new (&compressedChannels[i]) KeyFrameChannel(keyChannels[i]);
+        keyChannel->compress(compressedArena);
     }
     
+    keyChannels = compressedChannels;
+    arena = std::move(compressedArena);
+    compressed = true;
+    
+    computeReference();
+}
+
+size_t Animation::getMemorySize() const {
+    size_t size = reference.size() * sizeof(float);
+    if (baked) {
+        return size + (size_t)frameCount * (Pose::ComponentCount * frameStride * sizeof(float) + keyChannelsCount);
+    }
+    
+    for (uint32_t i = 0; i < keyChannelsCount; i++) {
+        size += keyChannels[i].getMemorySize();
+    }
+    return size;
 }
@@ -0,0 +1,424 @@
+//
+// => gcore/graphics/model/cpu_skinning.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#include <gcore/graphics/model/cpu_skinning.h>
+#include <gcore/graphics/model/fdmd_loader.h>
+#include <gcore/graphics/model/vertex_packing.h>
+#include <gcore/util/thread_pool.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+#include <vector>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GCORE_SKINNING_SSE
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define GCORE_SKINNING_NEON
+#endif
+
+using namespace gcore;
+
+/*!
+ \brief The number of vertices decoded at a time, small enough for the decoded streams to stay in the L1 cache.
+ */
+static constexpr size_t SkinningBlockSize = 256;
+
+SkinningSource SkinningSource::fromMeshData(const MeshData &mesh, uint32_t jointCount, const MeshQuantization &quantization) {
+    SkinningSource source;
+    source.vertexCount = mesh.getVertexCount();
+    source.jointCount = jointCount;
+    source.positions = mesh.getAttrib(OGLVertexAttribPosition);
+    source.normals = mesh.getAttrib(OGLVertexAttribNormal);
+    source.boneIDs = mesh.getAttrib(OGLVertexAttribBoneID);
+    source.boneWeights = mesh.getAttrib(OGLVertexAttribBoneWeight);
+    source.quantization = quantization;
+    return source;
+}
+
+namespace {
+    
+    template <typename T>
+    inline T readValue(const byte_t *p) {
+        T value;
+        memcpy(&value, p, sizeof(T));
+        return value;
+    }
+    
+    /*!
+     \brief Converts the first \c Components values of each vertex of a stream of \c T with \c convert , writing 4 floats per vertex. Missing components are set to 0.
+     */
+    template <uint32_t Components, typename T, typename Convert>
+    void decodeComponents(const VertexStream &stream, size_t first, size_t count, float *out, Convert convert) {
+        const byte_t *src = (const byte_t *)stream.data + first * stream.stride;
+        
+        if ((uint32_t)stream.components >= Components) {
+            for (size_t v = 0; v < count; v++, src += stream.stride, out += 4) {
+                T values[Components];
+                memcpy(values, src, sizeof(values));
+                for (uint32_t c = 0; c < Components; c++) {
+                    out[c] = convert(values[c]);
+                }
+            }
+            return;
+        }
+        
+        uint32_t read = (uint32_t)stream.components;
+        for (size_t v = 0; v < count; v++, src += stream.stride, out += 4) {
+            for (uint32_t c = 0; c < read; c++) {
+                out[c] = convert(readValue<T>(src + c * sizeof(T)));
+            }
+            for (uint32_t c = read; c < Components; c++) {
+                out[c] = 0.0f;
+            }
+        }
+    }
+    
+    template <uint32_t Components>
+    void decodeFloats(const VertexStream &stream, size_t first, size_t count, float *out) {
+        bool normalized = stream.normalized;
+        
+        switch (stream.type) {
+            case GL_FLOAT:
+                decodeComponents<Components, float>(stream, first, count, out, [](float x) { return x; });
+                break;
+            case GL_HALF_FLOAT:
+                decodeComponents<Components, uint16_t>(stream, first, count, out, halfToFloat);
+                break;
+            case GL_SHORT:
+                if (normalized) decodeComponents<Components, int16_t>(stream, first, count, out, unpackSNorm16);
+                else decodeComponents<Components, int16_t>(stream, first, count, out, [](int16_t x) { return (float)x; });
+                break;
+            case GL_UNSIGNED_SHORT:
+                if (normalized) decodeComponents<Components, uint16_t>(stream, first, count, out, unpackUNorm16);
+                else decodeComponents<Components, uint16_t>(stream, first, count, out, [](uint16_t x) { return (float)x; });
+                break;
+            case GL_BYTE:
+                if (normalized) decodeComponents<Components, int8_t>(stream, first, count, out, [](int8_t x) { return std::max(x / 127.0f, -1.0f); });
+                else decodeComponents<Components, int8_t>(stream, first, count, out, [](int8_t x) { return (float)x; });
+                break;
+            case GL_UNSIGNED_BYTE:
+                if (normalized) decodeComponents<Components, uint8_t>(stream, first, count, out, [](uint8_t x) { return x * (1.0f / 255.0f); });
+                else decodeComponents<Components, uint8_t>(stream, first, count, out, [](uint8_t x) { return (float)x; });
+                break;
+            case GL_UNSIGNED_INT:
+                decodeComponents<Components, uint32_t>(stream, first, count, out, [](uint32_t x) { return (float)x; });
+                break;
+            case GL_INT_2_10_10_10_REV: {
+                const byte_t *src = (const byte_t *)stream.data + first * stream.stride;
+                for (size_t v = 0; v < count; v++, src += stream.stride, out += 4) {
+                    unpackSNorm2_10_10_10(readValue<uint32_t>(src), out);
+                }
+                break;
+            }
+            default:
+                memset(out, 0, count * 4 * sizeof(float));
+                break;
+        }
+    }
+    
+    template <typename T>
+    void decodeIntegers(const VertexStream &stream, size_t first, size_t count, uint32_t maxValue, uint32_t *out) {
+        const byte_t *src = (const byte_t *)stream.data + first * stream.stride;
+        uint32_t read = std::min<uint32_t>((uint32_t)stream.components, MAX_WEIGHTS_PER_VERTEX);
+        
+        for (size_t v = 0; v < count; v++, src += stream.stride, out += MAX_WEIGHTS_PER_VERTEX) {
+            for (uint32_t c = 0; c < read; c++) {
+                out[c] = std::min<uint32_t>(readValue<T>(src + c * sizeof(T)), maxValue);
+            }
+            for (uint32_t c = read; c < MAX_WEIGHTS_PER_VERTEX; c++) {
+                out[c] = 0;
+            }
+        }
+    }
+    
+    void decodeIntegers(const VertexStream &stream, size_t first, size_t count, uint32_t maxValue, uint32_t *out) {
+        switch (stream.type) {
+            case GL_UNSIGNED_BYTE:
+                decodeIntegers<uint8_t>(stream, first, count, maxValue, out);
+                break;
+            case GL_UNSIGNED_SHORT:
+                decodeIntegers<uint16_t>(stream, first, count, maxValue, out);
+                break;
+            default:
+                decodeIntegers<uint32_t>(stream, first, count, maxValue, out);
+                break;
+        }
+    }
+    
+    /*!
+     \brief A block of vertices decoded to 4 floats per position, normal and weights, and \c MAX_WEIGHTS_PER_VERTEX bone IDs.
+     */
+    struct DecodedBlock {
+        alignas(16) float positions[SkinningBlockSize * 4];
+        alignas(16) float normals[SkinningBlockSize * 4];
+        alignas(16) float weights[SkinningBlockSize * MAX_WEIGHTS_PER_VERTEX];
+        uint32_t boneIDs[SkinningBlockSize * MAX_WEIGHTS_PER_VERTEX];
+        
+        void decode(const SkinningSource &source, size_t first, size_t count, bool withNormals) {
+            decodeFloats<3>(source.positions, first, count, positions);
+            
+            const float *offset = source.quantization.positionOffset;
+            const float *scale = source.quantization.positionScale;
+            for (size_t v = 0; v < count; v++) {
+                float *p = positions + v * 4;
+                p[0] = offset[0] + scale[0] * p[0];
+                p[1] = offset[1] + scale[1] * p[1];
+                p[2] = offset[2] + scale[2] * p[2];
+            }
+            
+            if (withNormals) {
+                decodeFloats<3>(source.normals, first, count, normals);
+            }
+            decodeFloats<MAX_WEIGHTS_PER_VERTEX>(source.boneWeights, first, count, weights);
+            decodeIntegers(source.boneIDs, first, count, source.jointCount - 1, boneIDs);
+        }
+    };
+    
+    /*!
+     \brief Skins a block of vertices with the palette transposed to columns: 4 columns of 4 floats per joint, the last row being 0.
+     \note The last vertex of the block is stored with exactly 3 floats, so that blocks can be written by different threads. The others are stored with 4 floats, the extra one being overwritten by the next vertex.
+     */
+    void skinBlock(const SkinningSource &source, const float *columns, size_t first, size_t count, float *positions, float *normals) {
+        DecodedBlock block;
+        block.decode(source, first, count, normals != nullptr);
+        
+        for (size_t v = 0; v < count; v++) {
+            const uint32_t *ids = block.boneIDs + v * MAX_WEIGHTS_PER_VERTEX;
+            const float *w = block.weights + v * MAX_WEIGHTS_PER_VERTEX;
+            const float *p = block.positions + v * 4;
+            const float *n = block.normals + v * 4;
+            bool last = v + 1 == count;
+            
+#if defined(GCORE_SKINNING_SSE)
+            const float *joint = columns + ids[0] * 16;
+            __m128 weight = _mm_set1_ps(w[0]);
+            __m128 c0 = _mm_mul_ps(weight, _mm_loadu_ps(joint));
+            __m128 c1 = _mm_mul_ps(weight, _mm_loadu_ps(joint + 4));
+            __m128 c2 = _mm_mul_ps(weight, _mm_loadu_ps(joint + 8));
+            __m128 c3 = _mm_mul_ps(weight, _mm_loadu_ps(joint + 12));
+            for (uint32_t k = 1; k < MAX_WEIGHTS_PER_VERTEX; k++) {
+                joint = columns + ids[k] * 16;
+                weight = _mm_set1_ps(w[k]);
+                c0 = _mm_add_ps(c0, _mm_mul_ps(weight, _mm_loadu_ps(joint)));
+                c1 = _mm_add_ps(c1, _mm_mul_ps(weight, _mm_loadu_ps(joint + 4)));
+                c2 = _mm_add_ps(c2, _mm_mul_ps(weight, _mm_loadu_ps(joint + 8)));
+                c3 = _mm_add_ps(c3, _mm_mul_ps(weight, _mm_loadu_ps(joint + 12)));
+            }
+            
+            __m128 position = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(p[0])), _mm_mul_ps(c1, _mm_set1_ps(p[1]))),
+                                         _mm_add_ps(_mm_mul_ps(c2, _mm_set1_ps(p[2])), c3));
+            float *outPosition = positions + v * 3;
+            if (last) {
+                _mm_storel_pi((__m64 *)outPosition, position);
+                _mm_store_ss(outPosition + 2, _mm_movehl_ps(position, position));
+            } else {
+                _mm_storeu_ps(outPosition, position);
+            }
+            
+            if (normals) {
+                __m128 normal = _mm_add_ps(_mm_add_ps(_mm_mul_ps(c0, _mm_set1_ps(n[0])), _mm_mul_ps(c1, _mm_set1_ps(n[1]))),
+                                           _mm_mul_ps(c2, _mm_set1_ps(n[2])));
+                __m128 squared = _mm_mul_ps(normal, normal);
+                float length2 = _mm_cvtss_f32(_mm_add_ss(_mm_add_ss(squared, _mm_shuffle_ps(squared, squared, _MM_SHUFFLE(1, 1, 1, 1))),
+                                                         _mm_movehl_ps(squared, squared)));
+                if (length2 > 0.0f) {
+                    normal = _mm_mul_ps(normal, _mm_set1_ps(1.0f / sqrtf(length2)));
+                }
+                
+                float *outNormal = normals + v * 3;
+                if (last) {
+                    _mm_storel_pi((__m64 *)outNormal, normal);
+                    _mm_store_ss(outNormal + 2, _mm_movehl_ps(normal, normal));
+                } else {
+                    _mm_storeu_ps(outNormal, normal);
+                }
+            }
+#elif defined(GCORE_SKINNING_NEON)
+            const float *joint = columns + ids[0] * 16;
+            float32x4_t c0 = vmulq_n_f32(vld1q_f32(joint), w[0]);
+            float32x4_t c1 = vmulq_n_f32(vld1q_f32(joint + 4), w[0]);
+            float32x4_t c2 = vmulq_n_f32(vld1q_f32(joint + 8), w[0]);
+            float32x4_t c3 = vmulq_n_f32(vld1q_f32(joint + 12), w[0]);
+            for (uint32_t k = 1; k < MAX_WEIGHTS_PER_VERTEX; k++) {
+                joint = columns + ids[k] * 16;
+                c0 = vmlaq_n_f32(c0, vld1q_f32(joint), w[k]);
+                c1 = vmlaq_n_f32(c1, vld1q_f32(joint + 4), w[k]);
+                c2 = vmlaq_n_f32(c2, vld1q_f32(joint + 8), w[k]);
+                c3 = vmlaq_n_f32(c3, vld1q_f32(joint + 12), w[k]);
+            }
+            
+            float32x4_t position = vmlaq_n_f32(vmlaq_n_f32(vmlaq_n_f32(c3, c0, p[0]), c1, p[1]), c2, p[2]);
+            float *outPosition = positions + v * 3;
+            if (last) {
+                vst1_f32(outPosition, vget_low_f32(position));
+                vst1q_lane_f32(outPosition + 2, position, 2);
+            } else {
+                vst1q_f32(outPosition, position);
+            }
+            
+            if (normals) {
+                float32x4_t normal = vmlaq_n_f32(vmlaq_n_f32(vmulq_n_f32(c0, n[0]), c1, n[1]), c2, n[2]);
+                float length2 = vaddvq_f32(vmulq_f32(normal, normal));
+                if (length2 > 0.0f) {
+                    normal = vmulq_n_f32(normal, 1.0f / sqrtf(length2));
+                }
+                
+                float *outNormal = normals + v * 3;
+                if (last) {
+                    vst1_f32(outNormal, vget_low_f32(normal));
+                    vst1q_lane_f32(outNormal + 2, normal, 2);
+                } else {
+                    vst1q_f32(outNormal, normal);
+                }
+            }
+#else
+            (void)last;
+            float c[16] = {  };
+            for (uint32_t k = 0; k < MAX_WEIGHTS_PER_VERTEX; k++) {
+                const float *joint = columns + ids[k] * 16;
+                for (int i = 0; i < 16; i++) {
+                    c[i] += w[k] * joint[i];
+                }
+            }
+            
+            for (int r = 0; r < 3; r++) {
+                positions[v * 3 + r] = c[r] * p[0] + c[4 + r] * p[1] + c[8 + r] * p[2] + c[12 + r];
+            }
+            
+            if (normals) {
+                float normal[3];
+                for (int r = 0; r < 3; r++) {
+                    normal[r] = c[r] * n[0] + c[4 + r] * n[1] + c[8 + r] * n[2];
+                }
+                float length2 = normal[0] * normal[0] + normal[1] * normal[1] + normal[2] * normal[2];
+                float scale = length2 > 0.0f ? 1.0f / sqrtf(length2) : 1.0f;
+                for (int r = 0; r < 3; r++) {
+                    normals[v * 3 + r] = normal[r] * scale;
+                }
+            }
+#endif
+        }
+    }
+    
+}
+
+void gcore::skinVerticesReference(const SkinningSource &source, const Affine3x4 *joints, size_t first, size_t count, float *positions, float *normals) {
+    if (!source.jointCount) {
+        return;
+    }
+    if (!source.normals.data) {
+        normals = nullptr;
+    }
+    
+    DecodedBlock block;
+    
+    for (size_t blockFirst = 0; blockFirst < count; blockFirst += SkinningBlockSize) {
+        size_t blockCount = std::min(SkinningBlockSize, count - blockFirst);
+        block.decode(source, first + blockFirst, blockCount, normals != nullptr);
+        
+        for (size_t v = 0; v < blockCount; v++) {
+            const uint32_t *ids = block.boneIDs + v * MAX_WEIGHTS_PER_VERTEX;
+            const float *w = block.weights + v * MAX_WEIGHTS_PER_VERTEX;
+            
+            Affine3x4 m = {  };
+            for (uint32_t k = 0; k < MAX_WEIGHTS_PER_VERTEX; k++) {
+                for (int r = 0; r < 3; r++) {
+                    for (int c = 0; c < 4; c++) {
+                        m.rows[r][c] += w[k] * joints[ids[k]].rows[r][c];
+                    }
+                }
+            }
+            
+            const float *p = block.positions + v * 4;
+            float *outPosition = positions + (blockFirst + v) * 3;
+            for (int r = 0; r < 3; r++) {
+                outPosition[r] = m.rows[r][0] * p[0] + m.rows[r][1] * p[1] + m.rows[r][2] * p[2] + m.rows[r][3];
+            }
+            
+            if (normals) {
+                const float *n = block.normals + v * 4;
+                float *outNormal = normals + (blockFirst + v) * 3;
+                for (int r = 0; r < 3; r++) {
+                    outNormal[r] = m.rows[r][0] * n[0] + m.rows[r][1] * n[1] + m.rows[r][2] * n[2];
+                }
+                
+                float length = sqrtf(outNormal[0] * outNormal[0] + outNormal[1] * outNormal[1] + outNormal[2] * outNormal[2]);
+                if (length > 0.0f) {
+                    outNormal[0] /= length;
+                    outNormal[1] /= length;
+                    outNormal[2] /= length;
+                }
+            }
+        }
+    }
+}
+
+void gcore::skinVertices(const SkinningSource &source, const Affine3x4 *joints, float *positions, float *normals, ThreadPool *pool) {
+    if (!source.jointCount) {
+        return;
+    }
+    if (!source.normals.data) {
+        normals = nullptr;
+    }
+    
+    uint32_t jointCount = source.jointCount;
+    static thread_local std::vector<float> columnStorage;
+    columnStorage.resize(jointCount * 16);
+    float *columns = columnStorage.data();
+    for (uint32_t j = 0; j < jointCount; j++) {
+        for (int c = 0; c < 4; c++) {
+            float *column = columns + j * 16 + c * 4;
+            column[0] = joints[j].rows[0][c];
+            column[1] = joints[j].rows[1][c];
+            column[2] = joints[j].rows[2][c];
+            column[3] = 0.0f;
+        }
+    }
+    
+    size_t vertexCount = source.vertexCount;
+    auto skinChunk = [&](size_t chunk) {
+        size_t chunkFirst = chunk * SkinningChunkSize;
+        size_t chunkEnd = std::min(chunkFirst + SkinningChunkSize, vertexCount);
+        
+        for (size_t first = chunkFirst; first < chunkEnd; first += SkinningBlockSize) {
+            size_t count = std::min(SkinningBlockSize, chunkEnd - first);
+            skinBlock(source, columns, first, count, positions + first * 3, normals ? normals + first * 3 : nullptr);
+        }
+    };
+    
+    size_t chunkCount = (vertexCount + SkinningChunkSize - 1) / SkinningChunkSize;
+    if (pool && chunkCount > 1) {
+        pool->parallelFor(chunkCount, skinChunk);
+    } else {
+        for (size_t chunk = 0; chunk < chunkCount; chunk++) {
+            skinChunk(chunk);
+        }
+    }
+}
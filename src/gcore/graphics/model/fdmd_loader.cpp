@@ -27,25 +27,34 @@
 #include <gcore/graphics/opengl.h>
 
 #include <gcore/graphics/model/fdmd_loader.h>
+#include <gcore/graphics/model/mesh_data.h>
 #include <gcore/graphics/model/model.h>
 #include <gcore/graphics/model/skeleton.h>
 #include <gcore/graphics/model/animation.h>
+#include <gcore/graphics/model/vertex_packing.h>
 #include <gcore/io/bin_istream.h>
+#include <gcore/util/thread_pool.h>
 
+#include <algorithm>
+#include <atomic>
 #include <cstdlib>
 #include <cstdint>
+#include <cstring>
 
 #include <iostream>
+#include <vector>
 
 using namespace gcore;
 
-typedef enum : GLuint {
-    OGLVertexAttribPosition = 0,
-    OGLVertexAttribNormal = 1,
-    OGLVertexAttribTexCoord2 = 2,
-    OGLVertexAttribBoneID = 3,
-    OGLVertexAttribBoneWeight = 4
-} OGLVertexAttrib;
+/*!
+ \brief The smallest size in bytes of a v1 skeleton node: its type, its ID, its bind pose and its children count.
+ */
+static const uint64_t SkeletonNodeMinSize = 1 + 4 + 16 * sizeof(float) + 4;
+
+/*!
+ \brief The smallest size in bytes of a v1 animation channel: its bone, its states and its three key counts.
+ */
+static const uint64_t KeyFrameChannelMinSize = 6;
 
 SkeletonBone *Skeleton::readNode(BinaryInputStream &is) {
     
@@ -53,7 +62,12 @@ SkeletonBone *Skeleton::readNode(BinaryInputStream &is) {
     
     uint32_t boneID = is.readInt32();
     
-    SkeletonBone *newBone = new SkeletonBone(*this, boneID, is.readMat4());
+    // The tables and the arena of the skeleton hold nodesCount nodes, and a node read twice would make a cycle.
+    if (boneID >= nodesCount || bones[boneID]) {
+        return nullptr;
+    }
+    
+    SkeletonBone *newBone = arena.create<SkeletonBone>(*this, boneID, is.readMat4());
     
     if (isBone) {
         newBone->offsetMatrix = is.readMat4();
@@ -62,22 +76,242 @@ SkeletonBone *Skeleton::readNode(BinaryInputStream &is) {
 
     bones[boneID] = newBone;
 
-    uint32_t childrenCount = is.readInt32();
+    uint32_t childrenCount = newBone->childrenCount = is.readInt32();
+    if (childrenCount >= nodesCount) {
+        return nullptr;
+    }
+    
+    newBone->children = arena.allocateArray<SkeletonBone *>(childrenCount);
     for (uint32_t i = 0; i < childrenCount; i++) {
-        newBone->addChild(readNode(is));
+        SkeletonBone *child = newBone->children[i] = readNode(is);
+        if (!child) {
+            return nullptr;
+        }
+        child->parent = newBone;
     }
     
     return newBone;
 }
 
+Skeleton *Model::readSkeleton(BinaryInputStream &is) {
+    uint32_t boneCount = is.readInt32();
+    uint32_t nodeCount = is.readInt32();
+    
+    // The bones are the first nodes of the table, and every node takes some bytes of the file: the counts are checked before sizing the skeleton.
+    Skeleton *skel = nullptr;
+    SkeletonBone *root = nullptr;
+    if (boneCount <= nodeCount && nodeCount <= is.getRemainingBytes() / SkeletonNodeMinSize) {
+        skel = new Skeleton(boneCount, nodeCount);
+        skel->finalTransform = is.readMat4();
+        root = skel->readNode(is);
+    }
+    
+    if (!root || is.fail()) {
+        std::cerr << (is.fail() ? "Truncated FDMD file." : "Invalid FDMD skeleton.") << std::endl;
+        delete skel;
+        return nullptr;
+    }
+    
+    skel->setRootBone(root);
+    return skel;
+}
+
+Animation *Model::readAnimation(BinaryInputStream &is, Skeleton *skel) {
+    // Scanning a mapped stream costs nothing, and sizes the arena of the animation exactly. Other streams let the arena grow.
+    size_t arenaSize = 0;
+    if (is.getMode() == BinaryInputStreamMapped) {
+        uint64_t start = is.tell();
+        skipAnimation(is, &arenaSize);
+        is.seek(start);
+    }
+    
+    uint32_t animID = is.readByte();
+    float duration = is.readFloat();
+    uint32_t chanCount = is.readInt32();
+    
+    is.readByte(); // Skeletal animation
+    
+    if (is.fail() || chanCount > is.getRemainingBytes() / KeyFrameChannelMinSize) {
+        std::cerr << "Truncated FDMD file." << std::endl;
+        return nullptr;
+    }
+    if (!skel) {
+        std::cerr << "FDMD animation without a skeleton." << std::endl;
+        return nullptr;
+    }
+    
+    Animation *anim = new Animation(animID, duration);
+    anim->arena = Arena(arenaSize);
+    
+    anim->keyChannelsCount = chanCount;
+    anim->keyChannels = anim->arena.allocateArray<KeyFrameChannel>(chanCount);
+    
+    for (uint32_t chanIndex = 0; chanIndex < chanCount; chanIndex++) {
+        
+        uint32_t boneID = is.readByte();
+        SkeletonBone *affectedBone = boneID < skel->getNodesCount() ? (*skel)[boneID] : nullptr;
+        if (!affectedBone) {
+            std::cerr << "Invalid FDMD bone index: " << boneID << std::endl;
+            delete anim;
+            return nullptr;
+        }
+        
+        KeyFrameChannel *keyChannel = new (&anim->keyChannels[chanIndex]) KeyFrameChannel(*anim, *affectedBone);
+        keyChannel->preState = (AnimationBehaviour) is.readByte();
+        keyChannel->postState = (AnimationBehaviour) is.readByte();
+        
+        if (uint32_t keysCount = is.readByte()) {
+            keyChannel->posKeyCount = keysCount;
+            keyChannel->posKeys = anim->arena.allocateArray<VectorKey>(keysCount);
+            
+            VectorKey *&keyVector = keyChannel->posKeys;
+            for (uint32_t i = 0; i < keysCount; i++) {
+                keyVector[i].t = is.readFloat();
+                is.readFloatArray(&keyVector[i].v[0], 3);
+            }
+            
+        }
+        
+        if (uint32_t keysCount = is.readByte()) {
+            keyChannel->rotKeyCount = keysCount;
+            keyChannel->rotKeys = anim->arena.allocateArray<QuaternionKey>(keysCount);
+            
+            QuaternionKey *&keyVector = keyChannel->rotKeys;
+            for (uint32_t i = 0; i < keysCount; i++) {
+                float wxyz[4];
+                keyVector[i].t = is.readFloat();
+                is.readFloatArray(wxyz, 4);
+                keyVector[i].q = glm::quat(wxyz[0], wxyz[1], wxyz[2], wxyz[3]);
+            }
+            
+        }
+        
+        if (uint32_t keysCount = is.readByte()) {
+            keyChannel->scalKeyCount = keysCount;
+            keyChannel->scalKeys = anim->arena.allocateArray<VectorKey>(keysCount);
+            
+            VectorKey *&keyVector = keyChannel->scalKeys;
+            for (uint32_t i = 0; i < keysCount; i++) {
+                keyVector[i].t = is.readFloat();
+                is.readFloatArray(&keyVector[i].v[0], 3);
+            }
+            
+        }
+    }
+    
+    if (is.fail()) {
+        std::cerr << "Truncated FDMD file." << std::endl;
+        delete anim;
+        return nullptr;
+    }
+    return anim;
+}
+
+uint32_t Model::skipAnimation(BinaryInputStream &is, size_t *arenaSize) {
+    uint32_t animID = is.readByte();
+    is.readFloat(); // duration
+    
+    uint32_t chanCount = is.readInt32();
+    is.readByte(); // Skeletal animation
+    
+    size_t size = chanCount * sizeof(KeyFrameChannel) + alignof(KeyFrameChannel);
+    
+    // A failed stream ends the channels, whatever their count.
+    for (uint32_t chanIndex = 0; chanIndex < chanCount && !is.fail(); chanIndex++) {
+        is.read(3); // bone, pre and post state
+        
+        uint32_t posCount = is.readByte();
+        is.seek(is.tell() + posCount * (sizeof(float) * 4));
+        uint32_t rotCount = is.readByte();
+        is.seek(is.tell() + rotCount * (sizeof(float) * 5));
+        uint32_t scalCount = is.readByte();
+        is.seek(is.tell() + scalCount * (sizeof(float) * 4));
+        
+        size += (posCount + scalCount) * sizeof(VectorKey) + rotCount * sizeof(QuaternionKey) + 3 * alignof(QuaternionKey);
+    }
+    
+    if (arenaSize) {
+        *arenaSize = size;
+    }
+    return animID;
+}
+
 
-Model *Model::fromFile(const char *fileName) {
-    BinaryInputStream is(fileName);
+Model *Model::fromFile(const char *fileName, const ModelLoadOptions &options) {
+    return fromFile(fileName, BinaryInputStreamOptions(BinaryInputStreamMapped), options);
+}
+
+Model *Model::fromFile(const char *fileName, const BinaryInputStreamOptions &streamOptions, const ModelLoadOptions &options) {
+    BinaryInputStream *is = new BinaryInputStream(fileName, streamOptions);
+    Model *model = read(*is, options);
+    
+    if (model) {
+        model->adoptAnimationSource(is);
+    } else {
+        delete is;
+    }
+    return model;
+}
 
+Model *Model::fromStream(BinaryInputStream &is, const ModelLoadOptions &options) {
+    ModelLoadOptions eagerOptions = options;
+    eagerOptions.lazyAnimations = false;
+    return read(is, eagerOptions);
+}
+
+Model *Model::read(BinaryInputStream &is, const ModelLoadOptions &options) {
+    Model *model = decode(is, options, nullptr);
+    
+    if (model && options.uploadMeshes) {
+        while (model->uploadNextMesh());
+    }
+    return model;
+}
+
+Model *Model::decode(BinaryInputStream &is, const ModelLoadOptions &options, ThreadPool *pool) {
 	if (!is.good()) {
 		return nullptr;
 	}
     
+    Model *model;
+    const byte_t *magic = is.peek(4);
+    if (magic && !memcmp(magic, FDMD_MAGIC, 4)) {
+        // v2 animations are prepared by the workers that decode them.
+        model = decodeV2(is, options, pool);
+    } else {
+        model = decodeV1(is, options);
+        
+        if (model) {
+            for (uint32_t i = 0; i < model->_animCount; i++) {
+                if (model->_animations[i]) {
+                    prepareAnimation(*model->_animations[i], options, model->_animationFrameRates[i]);
+                }
+            }
+        }
+    }
+    
+    if (!model) {
+        return nullptr;
+    }
+    model->loadOptions = options;
+    return model;
+}
+
+void Model::adoptAnimationSource(BinaryInputStream *is) {
+    if (!isUploaded()) {
+        animationSource = is;
+        return;
+    }
+    for (uint32_t i = 0; i < _animCount; i++) {
+        if (_animationOffsets[i] && !_animations[i]) {
+            animationSource = is;
+            return;
+        }
+    }
+    delete is; // every animation is already loaded
+}
+
+Model *Model::decodeV1(BinaryInputStream &is, const ModelLoadOptions &options) {
     Model *model = new Model();
     
     Skeleton *skel = nullptr;
@@ -87,8 +321,14 @@ Model *Model::fromFile(const char *fileName) {
     uint32_t meshCount = model->meshCount = is.readByte();
     uint32_t animCount = model->_animCount = is.readByte();
     
-    model->vaos = new VertexArrayObject *[meshCount];
-    model->_animations = new Animation *[animCount];
+    model->vaos = new VertexArrayObject *[meshCount]();
+    model->meshData.assign(meshCount, MeshData(0));
+    model->quantizations = new MeshQuantization[meshCount];
+    model->_animations = new Animation *[animCount]();
+    model->_animationOffsets = new uint64_t[animCount]();
+    model->_animationLastUse = new uint64_t[animCount]();
+    model->_animationFrameRates = new float[animCount];
+    std::fill(model->_animationFrameRates, model->_animationFrameRates + animCount, options.animationFrameRate);
     
     uint32_t modelAttrib;
     while ((modelAttrib = is.readByte()) != FDMDModelAttribEndFile) {
@@ -98,100 +338,75 @@ Model *Model::fromFile(const char *fileName) {
 
             
             uint32_t vertexCount = is.readInt32();
-            VertexArrayObject &theVAO = *(model->vaos[meshIndex] = new VertexArrayObject(vertexCount));
-            theVAO.bind();
+            MeshData &mesh = model->meshData[meshIndex] = MeshData(vertexCount);
             
             
             uint32_t vertexAttrib;
             while ((vertexAttrib = is.readByte()) != FDMDModelVertexAttribEndMesh) {
                 switch (vertexAttrib) {
                     case FDMDModelVertexAttribPosition: {
-                        GLfloat *vertexData = (GLfloat *)malloc(vertexCount * sizeof(GLfloat) * 3);
-                        
-                        uint64_t j = 0;
-                        for (uint32_t i = 0; i < vertexCount; i++) {
-                            vertexData[j++] = is.readFloat();
-                            vertexData[j++] = is.readFloat();
-                            vertexData[j++] = is.readFloat();
-                        }
-                        
-                        theVAO.bindPositions(vertexData);
-                        free(vertexData);
+                        GLfloat *vertexData = (GLfloat *)mesh.addAttrib(OGLVertexAttribPosition, 3, GL_FLOAT, GL_FALSE, false);
+                        is.readFloatArray(vertexData, (size_t)vertexCount * 3);
                         break;
                     }
                         
                     case FDMDModelVertexAttribNormal: {
-                        GLfloat *normalData = (GLfloat *)malloc(vertexCount * sizeof(GLfloat) * 3);
-                        
-                        uint64_t j = 0;
-                        for (uint32_t i = 0; i < vertexCount; i++) {
-                            normalData[j++] = is.readFloat();
-                            normalData[j++] = is.readFloat();
-                            normalData[j++] = is.readFloat();
-                        }
-                        
-                        theVAO.bindNormals(normalData);
-                        free(normalData);
+                        GLfloat *normalData = (GLfloat *)mesh.addAttrib(OGLVertexAttribNormal, 3, GL_FLOAT, GL_FALSE, false);
+                        is.readFloatArray(normalData, (size_t)vertexCount * 3);
                         break;
                     }
                         
                     case FDMDModelVertexAttribTexCoord2: {
                         is.readByte(); // texIndex
                         
-                        GLfloat *uvData = (GLfloat *)malloc(vertexCount * sizeof(GLfloat) * 2);
-                        
-                        uint64_t j = 0;
-                        for (uint32_t i = 0; i < vertexCount; i++) {
-                            uvData[j++] = is.readFloat();
-                            uvData[j++] = is.readFloat();
-                        }
-                        
-                        theVAO.bindTexCoords2D(uvData);
-                        free(uvData);
+                        GLfloat *uvData = (GLfloat *)mesh.addAttrib(OGLVertexAttribTexCoord2, 2, GL_FLOAT, GL_FALSE, false);
+                        is.readFloatArray(uvData, (size_t)vertexCount * 2);
                         break;
                     }
                         
                     case FDMDModelVertexAttribBoneID: {
                         is.readByte(); // assuming 4 weights per vertex
                         
-                        GLuint *boneData = (GLuint *)malloc(vertexCount * sizeof(GLuint) * MAX_WEIGHTS_PER_VERTEX);
-                
-                        uint64_t j = 0;
-                        for (uint32_t i = 0; i < vertexCount; i++) {
-                            boneData[j++] = is.readInt32();
-                            boneData[j++] = is.readInt32();
-                            boneData[j++] = is.readInt32();
-                            boneData[j++] = is.readInt32();
-                        }
+                        size_t idCount = (size_t)vertexCount * MAX_WEIGHTS_PER_VERTEX;
+                        std::vector<GLuint> boneData(idCount);
+                        is.readInt32Array(boneData.data(), idCount);
                         
-                        theVAO.bindBoneIDs(boneData, MAX_WEIGHTS_PER_VERTEX);
-                        free(boneData);
+                        if (options.packBoneData && !boneData.empty() && *std::max_element(boneData.begin(), boneData.end()) <= UINT8_MAX) {
+                            GLubyte *packedData = (GLubyte *)mesh.addAttrib(OGLVertexAttribBoneID, MAX_WEIGHTS_PER_VERTEX, GL_UNSIGNED_BYTE, GL_FALSE, true);
+                            std::copy(boneData.begin(), boneData.end(), packedData);
+                        } else {
+                            GLuint *idData = (GLuint *)mesh.addAttrib(OGLVertexAttribBoneID, MAX_WEIGHTS_PER_VERTEX, GL_UNSIGNED_INT, GL_FALSE, true);
+                            std::copy(boneData.begin(), boneData.end(), idData);
+                        }
                         break;
                     }
                         
                     case FDMDModelVertexAttribBoneWeight: {
-                        GLuint _boneWeightBuffer;
-                        glGenBuffers(1, &_boneWeightBuffer); // Bone Weights
-                        glBindBuffer(GL_ARRAY_BUFFER, _boneWeightBuffer);
-                        
                         is.readByte(); // assuming 4 weights per vertex
                         
-                        GLfloat *boneData = (GLfloat *)malloc(vertexCount * sizeof(GLfloat) * MAX_WEIGHTS_PER_VERTEX);
-                        
-                        uint64_t j = 0;
-                        for (uint32_t i = 0; i < vertexCount; i++) {
-                            boneData[j++] = is.readFloat();
-                            boneData[j++] = is.readFloat();
-                            boneData[j++] = is.readFloat();
-                            boneData[j++] = is.readFloat();
+                        if (options.packBoneData) {
+                            std::vector<GLfloat> boneData((size_t)vertexCount * MAX_WEIGHTS_PER_VERTEX);
+                            is.readFloatArray(boneData.data(), boneData.size());
+                            
+                            GLubyte *packedData = (GLubyte *)mesh.addAttrib(OGLVertexAttribBoneWeight, MAX_WEIGHTS_PER_VERTEX, GL_UNSIGNED_BYTE, GL_TRUE, false);
+                            packBoneWeights(packedData, boneData.data(), vertexCount, MAX_WEIGHTS_PER_VERTEX);
+                        } else {
+                            GLfloat *boneData = (GLfloat *)mesh.addAttrib(OGLVertexAttribBoneWeight, MAX_WEIGHTS_PER_VERTEX, GL_FLOAT, GL_FALSE, false);
+                            is.readFloatArray(boneData, (size_t)vertexCount * MAX_WEIGHTS_PER_VERTEX);
                         }
+                        break;
+                    }
 
-                        glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(GLfloat) * MAX_WEIGHTS_PER_VERTEX, boneData, GL_STATIC_DRAW);
-                        free(boneData);
-                        
-                        glEnableVertexAttribArray(OGLVertexAttribBoneWeight);
-                        glVertexAttribPointer(OGLVertexAttribBoneWeight, MAX_WEIGHTS_PER_VERTEX, GL_FLOAT, GL_FALSE, 0, (void*)(0));
+                    case FDMDModelVertexAttribIndex: {
+                        uint32_t indexCount = is.readInt32();
                         
+                        if (is.readByte() == sizeof(GLushort)) {
+                            GLushort *indexData = (GLushort *)mesh.setIndices(indexCount, GL_UNSIGNED_SHORT);
+                            is.readInt16Array(indexData, indexCount);
+                        } else {
+                            GLuint *indexData = (GLuint *)mesh.setIndices(indexCount, GL_UNSIGNED_INT);
+                            is.readInt32Array(indexData, indexCount);
+                        }
                         break;
                     }
 
@@ -199,76 +414,373 @@ Model *Model::fromFile(const char *fileName) {
                 }
 
             }
-            glBindVertexArray(0);
+            mesh.build(options.interleaveVertices);
             meshIndex++;
 
         } else if (modelAttrib == FDMDModelAttribSkeleton) {
-            skel = model->_skeleton = new Skeleton(is.readInt32(), is.readInt32()); // boneCount, nodeCount
-            
-            skel->finalTransform = is.readMat4();
-            skel->setRootBone(skel->readNode(is));
-            skel->resetAllJoints();
+            if (skel) {
+                std::cerr << "Repeated FDMD skeleton." << std::endl;
+                delete model;
+                return nullptr;
+            }
+            if (!(skel = model->_skeleton = readSkeleton(is))) {
+                delete model;
+                return nullptr;
+            }
         } else if (modelAttrib == FDMDModelAttribAnimation) {
-            uint32_t animID = is.readByte();
-            
-            Animation *anim = model->_animations[animID] = new Animation(animID, is.readFloat()); // ID, duration
-            
-            uint32_t chanCount = anim->keyChannelsCount = is.readInt32();
-            anim->keyChannels = new KeyFrameChannel *[chanCount];
+            // Animations refer to the bones of the skeleton, so it must come first.
+            if (!skel) {
+                std::cerr << "FDMD animation without a skeleton." << std::endl;
+                delete model;
+                return nullptr;
+            }
             
-            is.readByte(); // Skeletal animation
-            for (uint32_t chanIndex = 0; chanIndex < chanCount; chanIndex++) {
+            if (options.lazyAnimations) {
+                uint64_t offset = is.tell();
+                uint32_t animID = skipAnimation(is);
+                if (animID >= animCount) {
+                    std::cerr << "Invalid FDMD animation ID: " << animID << std::endl;
+                    delete model;
+                    return nullptr;
+                }
+                model->_animationOffsets[animID] = offset;
+            } else {
+                Animation *anim = readAnimation(is, skel);
+                if (!anim) {
+                    delete model;
+                    return nullptr;
+                }
+                if (anim->getAnimationID() >= animCount) {
+                    std::cerr << "Invalid FDMD animation ID: " << anim->getAnimationID() << std::endl;
+                    delete anim;
+                    delete model;
+                    return nullptr;
+                }
+                delete model->_animations[anim->getAnimationID()]; // a later record with the same ID replaces the earlier one
+                model->_animations[anim->getAnimationID()] = anim;
+            }
+        } else {
+            std::cerr << "Unknown FDMD model attribute: " << modelAttrib << std::endl;
+            delete model;
+            return nullptr;
+        }
+        
+    }
+    
+    // Numbers read past the end of the file are 0, which ends every record, so a truncated file is only detected here.
+    if (is.fail()) {
+        std::cerr << "Truncated FDMD file." << std::endl;
+        delete model;
+        return nullptr;
+    }
+    
+    return model;
+}
 
-                SkeletonBone *affectedBone = skel->bones[is.readByte()];
-                
-                KeyFrameChannel *keyChannel = anim->keyChannels[chanIndex] = new KeyFrameChannel(*anim, *affectedBone);
-                keyChannel->preState = (AnimationBehaviour) is.readByte();
-                keyChannel->postState = (AnimationBehaviour) is.readByte();
+/*!
+ \brief Returns the OpenGL type the values of the given FDMD component format are uploaded as, and whether they are normalized.
+ */
+static GLenum glTypeOf(uint8_t format, GLboolean &normalized) {
+    normalized = GL_FALSE;
+    switch (format) {
+        case FDMDFormatUInt32:
+            return GL_UNSIGNED_INT;
+        case FDMDFormatUInt16:
+            return GL_UNSIGNED_SHORT;
+        case FDMDFormatFloat16:
+            return GL_HALF_FLOAT;
+        case FDMDFormatSNorm16:
+            normalized = GL_TRUE;
+            return GL_SHORT;
+        case FDMDFormatUNorm16:
+            normalized = GL_TRUE;
+            return GL_UNSIGNED_SHORT;
+        case FDMDFormatUInt8:
+            return GL_UNSIGNED_BYTE;
+        case FDMDFormatUNorm8:
+            normalized = GL_TRUE;
+            return GL_UNSIGNED_BYTE;
+        case FDMDFormatSNorm2_10_10_10:
+            normalized = GL_TRUE;
+            return GL_INT_2_10_10_10_REV;
+        default:
+            return GL_FLOAT;
+    }
+}
+
+/*!
+ \brief Adds the payload of a FDMD v2 vertex data section to the streams of its mesh.
+ \param data The payload, or \c nullptr to let the mesh allocate it.
+ \return The storage of the section in the mesh, or \c nullptr if \c data was given or the section is not used.
+ */
+static void *addVertexData(MeshData &mesh, const FDMDSectionEntry &entry, const void *data) {
+    GLboolean normalized;
+    GLenum type = glTypeOf(entry.format, normalized);
+    
+    switch (entry.attrib) {
+        case FDMDModelVertexAttribPosition:
+        case FDMDModelVertexAttribNormal:
+            return mesh.addAttrib(entry.attrib == FDMDModelVertexAttribPosition ? OGLVertexAttribPosition : OGLVertexAttribNormal, entry.components, type, normalized, false, data);
+        case FDMDModelVertexAttribTexCoord2:
+            if (entry.set == 0) { // only the first set of texture coordinates is used
+                return mesh.addAttrib(OGLVertexAttribTexCoord2, entry.components, type, normalized, false, data);
+            }
+            return nullptr;
+        case FDMDModelVertexAttribBoneID:
+            return mesh.addAttrib(OGLVertexAttribBoneID, entry.components, type, GL_FALSE, true, data);
+        case FDMDModelVertexAttribBoneWeight:
+            return mesh.addAttrib(OGLVertexAttribBoneWeight, entry.components, type, normalized, false, data);
+        case FDMDModelVertexAttribIndex:
+            return mesh.setIndices(entry.count, type, data);
+        default:
+            return nullptr;
+    }
+}
+
+/*!
+ \brief Returns whether the payload of a vertex data section has the size of its values, and whether it has a value per vertex of the mesh it follows. Other sections are not checked.
+ */
+static bool validSection(const FDMDSectionEntry &entry, uint32_t meshVertexCount) {
+    if (entry.type != FDMDSectionVertexData) {
+        return true;
+    }
+    if (entry.attrib != FDMDModelVertexAttribIndex && entry.count != meshVertexCount) {
+        return false;
+    }
+    
+    uint64_t valueSize = entry.format == FDMDFormatSNorm2_10_10_10 ? 4 : entry.components * fdmdFormatWordSize(entry.format);
+    return entry.size == (uint64_t)entry.count * valueSize;
+}
+
+/*!
+ \brief A part of a FDMD v2 file that is decoded on its own: a mesh section with the vertex data sections following it, or an animation section.
+ */
+struct SectionGroup {
+    std::vector<const FDMDSectionEntry *> entries;
+    /*!
+     \brief The payload of each entry, pointing into the mapping of the file or into \c copies .
+     */
+    std::vector<const byte_t *> payloads;
+    std::vector<std::vector<byte_t>> copies;
+};
+
+Model *Model::decodeV2(BinaryInputStream &is, const ModelLoadOptions &options, ThreadPool *pool) {
+    uint64_t base = is.tell();
+    
+    FDMDHeader header;
+    is.readBytes(&header, sizeof(FDMDHeader));
+    fdmdSwapToHost(header);
+    
+    if (header.version != FDMD_VERSION) {
+        std::cerr << "Unsupported FDMD version: " << header.version << std::endl;
+        return nullptr;
+    }
+    
+    // The table is only allocated once it is known to fit in the file.
+    if (!is.seek(base + header.sectionTableOffset) || header.sectionCount > is.getRemainingBytes() / sizeof(FDMDSectionEntry)) {
+        std::cerr << "Truncated FDMD file." << std::endl;
+        return nullptr;
+    }
+    
+    std::vector<FDMDSectionEntry> sections(header.sectionCount);
+    size_t tableSize = sizeof(FDMDSectionEntry) * header.sectionCount;
+    if (is.readBytes(sections.data(), tableSize) != tableSize) {
+        std::cerr << "Truncated FDMD file." << std::endl;
+        return nullptr;
+    }
+    
+    Model *model = new Model();
+    
+    Skeleton *skel = nullptr;
+    
+    uint32_t meshCount = model->meshCount = header.meshCount;
+    uint32_t animCount = model->_animCount = header.animCount;
+    
+    model->vaos = new VertexArrayObject *[meshCount]();
+    model->meshData.assign(meshCount, MeshData(0));
+    model->quantizations = new MeshQuantization[meshCount];
+    model->_animations = new Animation *[animCount]();
+    model->_animationOffsets = new uint64_t[animCount]();
+    model->_animationLastUse = new uint64_t[animCount]();
+    model->_animationFrameRates = new float[animCount];
+    std::fill(model->_animationFrameRates, model->_animationFrameRates + animCount, options.animationFrameRate);
+    
+    // A mapped stream hands out pointers into the mapping, which stays valid until the stream is closed.
+    bool mapped = is.getMode() == BinaryInputStreamMapped;
+    // Blobs can be uploaded straight from a mapping only if no conversion is needed.
+    bool zeroCopy = mapped && isLittleEndianHost();
+    
+    // The sections are fetched in order, then the groups are decoded in parallel. The skeleton comes first, since animations refer to its bones.
+    std::vector<SectionGroup> groups;
+    bool inMesh = false;
+    uint32_t meshVertexCount = 0;
+    
+    for (FDMDSectionEntry &entry : sections) {
+        fdmdSwapToHost(entry);
+        
+        // A mapping cannot be read past its end, so the end of the payload is sought first.
+        if (!is.seek(base + entry.offset + entry.size) || !is.seek(base + entry.offset)) {
+            std::cerr << "Truncated FDMD file." << std::endl;
+            delete model;
+            return nullptr;
+        }
+        
+        switch (entry.type) {
+            case FDMDSectionSkeleton:
+                if (skel) {
+                    std::cerr << "Repeated FDMD skeleton." << std::endl;
+                    delete model;
+                    return nullptr;
+                }
+                if (!(skel = model->_skeleton = readSkeleton(is))) {
+                    delete model;
+                    return nullptr;
+                }
+                if (is.tell() > base + entry.offset + entry.size) {
+                    std::cerr << "Invalid FDMD skeleton." << std::endl;
+                    delete model;
+                    return nullptr;
+                }
+                inMesh = false;
+                continue;
                 
-                if (uint32_t keysCount = is.readByte()) {
-                    keyChannel->posKeyCount = keysCount;
-                    keyChannel->posKeys = new VectorKey[keysCount];
-                    
-                    VectorKey *&keyVector = keyChannel->posKeys;
-                    for (uint32_t i = 0; i < keysCount; i++) {
-                        keyVector[i].t = is.readFloat();
-                        keyVector[i].v = glm::vec3(is.readFloat(), is.readFloat(), is.readFloat());
-                    }
-                    
+            case FDMDSectionMesh:
+                if (entry.index >= meshCount) {
+                    inMesh = false;
+                    continue;
                 }
+                groups.emplace_back();
+                inMesh = true;
+                meshVertexCount = entry.count;
+                break;
                 
-                if (uint32_t keysCount = is.readByte()) {
-                    keyChannel->rotKeyCount = keysCount;
-                    keyChannel->rotKeys = new QuaternionKey[keysCount];
-                    
-                    QuaternionKey *&keyVector = keyChannel->rotKeys;
-                    for (uint32_t i = 0; i < keysCount; i++) {
-                        keyVector[i].t = is.readFloat();
-                        keyVector[i].q = glm::quat(is.readFloat(), is.readFloat(), is.readFloat(), is.readFloat());
-                    }
-                    
+            case FDMDSectionVertexData:
+                if (!inMesh) {
+                    continue;
                 }
+                break;
                 
-                if (uint32_t keysCount = is.readByte()) {
-                    keyChannel->scalKeyCount = keysCount;
-                    keyChannel->scalKeys = new VectorKey[keysCount];
-                    
-                    VectorKey *&keyVector = keyChannel->scalKeys;
-                    for (uint32_t i = 0; i < keysCount; i++) {
-                        keyVector[i].t = is.readFloat();
-                        keyVector[i].v = glm::vec3(is.readFloat(), is.readFloat(), is.readFloat());
-                    }
-                    
+            case FDMDSectionAnimation:
+                inMesh = false;
+                if (!skel) {
+                    std::cerr << "FDMD animation without a skeleton." << std::endl;
+                    delete model;
+                    return nullptr;
+                }
+                if (entry.index >= animCount) {
+                    continue;
                 }
+                if (options.lazyAnimations) {
+                    model->_animationOffsets[entry.index] = base + entry.offset;
+                    continue;
+                }
+                groups.emplace_back();
+                break;
+                
+            default:
+                continue;
+        }
+        
+        if (!validSection(entry, meshVertexCount)) {
+            std::cerr << "Invalid FDMD section size." << std::endl;
+            delete model;
+            return nullptr;
+        }
+        
+        SectionGroup &group = groups.back();
+        group.entries.push_back(&entry);
+        
+        if (mapped) {
+            group.payloads.push_back(is.read((size_t)entry.size));
+        } else {
+            group.copies.emplace_back((size_t)entry.size);
+            is.readBytes(group.copies.back().data(), (size_t)entry.size);
+            group.payloads.push_back(group.copies.back().data());
+        }
+        
+        if (is.fail()) {
+            std::cerr << "Truncated FDMD file." << std::endl;
+            delete model;
+            return nullptr;
+        }
+    }
+    
+    // Set by the workers decoding an invalid animation: the whole model is then discarded.
+    std::atomic<bool> invalid(false);
+    
+    auto decodeGroup = [&](size_t i) {
+        const SectionGroup &group = groups[i];
+        const FDMDSectionEntry &first = *group.entries[0];
+        
+        if (first.type == FDMDSectionAnimation) {
+            BinaryInputStream animationStream(group.payloads[0], (size_t)first.size);
+            
+            Animation *anim = readAnimation(animationStream, skel);
+            if (!anim) {
+                invalid = true;
+                return;
+            }
+            if (anim->getAnimationID() >= animCount) {
+                std::cerr << "Invalid FDMD animation ID: " << anim->getAnimationID() << std::endl;
+                delete anim;
+                invalid = true;
+                return;
             }
+            prepareAnimation(*anim, options, options.animationFrameRate);
+            model->_animations[anim->getAnimationID()] = anim;
+            return;
+        }
+        
+        MeshData &mesh = model->meshData[first.index] = MeshData(first.count);
+        
+        if (first.size >= sizeof(FDMDMeshQuantization)) {
+            FDMDMeshQuantization quantization;
+            memcpy(&quantization, group.payloads[0], sizeof(FDMDMeshQuantization));
+            littleEndianToHost32(&quantization, &quantization, sizeof(FDMDMeshQuantization) / 4);
             
-        } else {
-            std::cout << "no!" << std::endl;
+            MeshQuantization &meshQuantization = model->quantizations[first.index];
+            memcpy(meshQuantization.positionOffset, quantization.positionOffset, sizeof(meshQuantization.positionOffset));
+            memcpy(meshQuantization.positionScale, quantization.positionScale, sizeof(meshQuantization.positionScale));
         }
         
+        for (size_t k = 1; k < group.entries.size(); k++) {
+            const FDMDSectionEntry &entry = *group.entries[k];
+            
+            if (zeroCopy) {
+                addVertexData(mesh, entry, group.payloads[k]);
+                continue;
+            }
+            
+            byte_t *blob = (byte_t *)addVertexData(mesh, entry, nullptr);
+            if (!blob) {
+                continue;
+            }
+            memcpy(blob, group.payloads[k], (size_t)entry.size);
+            switch (fdmdFormatWordSize(entry.format)) {
+                case 2:
+                    littleEndianToHost16(blob, blob, (size_t)entry.size / 2);
+                    break;
+                case 4:
+                    littleEndianToHost32(blob, blob, (size_t)entry.size / 4);
+                    break;
+                default: break;
+            }
+        }
+        
+        mesh.build(options.interleaveVertices);
+    };
+    
+    if (pool) {
+        pool->parallelFor(groups.size(), decodeGroup);
+    } else {
+        for (size_t i = 0; i < groups.size(); i++) {
+            decodeGroup(i);
+        }
     }
     
+    if (invalid) {
+        delete model;
+        return nullptr;
+    }
     return model;
 }
-
-
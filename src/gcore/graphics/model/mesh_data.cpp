@@ -0,0 +1,172 @@
+//
+// => gcore/graphics/model/mesh_data.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <gcore/graphics/model/mesh_data.h>
+
+#include <cstring>
+
+using namespace gcore;
+
+void *MeshData::addAttrib(GLuint location, GLint components, GLenum type, GLboolean normalized, bool integer, const void *data) {
+    streams.push_back({ location, components, type, normalized, integer, data, std::vector<byte_t>() });
+    
+    Stream &stream = streams.back();
+    if (data) {
+        return nullptr;
+    }
+    stream.storage.resize(vertexCount * stream.elementSize());
+    return stream.storage.data();
+}
+
+void *MeshData::setIndices(size_t count, GLenum type, const void *data) {
+    indexCount = count;
+    indexType = type;
+    indexData = data;
+    if (data) {
+        return nullptr;
+    }
+    indexStorage.resize(count * glTypeSize(type));
+    return indexStorage.data();
+}
+
+void MeshData::build(bool interleave) {
+    buffers.clear();
+    
+    if (interleave && streams.size() > 1) {
+        Buffer buffer;
+        for (const Stream &stream : streams) {
+            buffer.layout.add(stream.location, stream.components, stream.type, stream.normalized, stream.integer);
+        }
+        
+        GLuint stride = buffer.layout.getStride();
+        buffer.data = nullptr;
+        buffer.storage.resize(vertexCount * stride);
+        
+        for (size_t i = 0; i < streams.size(); i++) {
+            size_t elementSize = streams[i].elementSize();
+            const byte_t *src = streams[i].bytes();
+            byte_t *dst = buffer.storage.data() + buffer.layout.getAttribs()[i].offset;
+            
+            for (size_t v = 0; v < vertexCount; v++, src += elementSize, dst += stride) {
+                memcpy(dst, src, elementSize);
+            }
+        }
+        buffers.push_back(std::move(buffer));
+    } else {
+        for (Stream &stream : streams) {
+            Buffer buffer;
+            buffer.layout.add(stream.location, stream.components, stream.type, stream.normalized, stream.integer);
+            
+            size_t elementSize = stream.elementSize();
+            GLuint stride = buffer.layout.getStride();
+            if (elementSize == stride) {
+                buffer.data = stream.data;
+                buffer.storage = std::move(stream.storage);
+            } else {
+                // The layout pads each vertex to 4 bytes.
+                const byte_t *src = stream.bytes();
+                buffer.data = nullptr;
+                buffer.storage.assign(vertexCount * stride, 0);
+                for (size_t v = 0; v < vertexCount; v++, src += elementSize) {
+                    memcpy(buffer.storage.data() + v * stride, src, elementSize);
+                }
+            }
+            buffers.push_back(std::move(buffer));
+        }
+    }
+    
+    streams.clear();
+}
+
+size_t MeshData::getUploadSize() const {
+    size_t size = indexCount * glTypeSize(indexType);
+    for (const Buffer &buffer : buffers) {
+        size += vertexCount * buffer.layout.getStride();
+    }
+    return size;
+}
+
+void MeshData::upload(VertexArrayObject &theVAO) const {
+    theVAO.bind();
+    
+    for (const Buffer &buffer : buffers) {
+        theVAO.bindInterleaved(buffer.bytes(), buffer.layout);
+    }
+    
+    if (indexCount > 0) {
+        theVAO.bindIndices(indexData ? indexData : indexStorage.data(), indexCount, indexType);
+    }
+}
+
+VertexStream MeshData::getAttrib(GLuint location) const {
+    VertexStream ret;
+    for (const Stream &stream : streams) {
+        if (stream.location == location) {
+            ret.data = stream.bytes();
+            ret.components = stream.components;
+            ret.type = stream.type;
+            ret.normalized = stream.normalized;
+            ret.stride = stream.elementSize();
+            return ret;
+        }
+    }
+    
+    for (const Buffer &buffer : buffers) {
+        for (const VertexAttribFormat &attrib : buffer.layout.getAttribs()) {
+            if (attrib.location == location) {
+                ret.data = (const byte_t *)buffer.bytes() + attrib.offset;
+                ret.components = attrib.components;
+                ret.type = attrib.type;
+                ret.normalized = attrib.normalized;
+                ret.stride = buffer.layout.getStride();
+                return ret;
+            }
+        }
+    }
+    return ret;
+}
+
+void MeshData::detach() {
+    for (Stream &stream : streams) {
+        if (stream.data) {
+            stream.storage.assign((const byte_t *)stream.data, (const byte_t *)stream.data + vertexCount * stream.elementSize());
+            stream.data = nullptr;
+        }
+    }
+    
+    for (Buffer &buffer : buffers) {
+        if (buffer.data) {
+            buffer.storage.assign((const byte_t *)buffer.data, (const byte_t *)buffer.data + vertexCount * buffer.layout.getStride());
+            buffer.data = nullptr;
+        }
+    }
+    
+    if (indexData) {
+        size_t size = indexCount * glTypeSize(indexType);
+        indexStorage.assign((const byte_t *)indexData, (const byte_t *)indexData + size);
+        indexData = nullptr;
+    }
+}
@@ -31,23 +31,167 @@
 
 #include <GL/glew.h>
 
+#include <iostream>
+
 using namespace gcore;
 
-void Model::update(double dt) {
+void Model::drawMeshes(GLint positionDequantizationUniform) const {
     
-    _animations[0]->update(dt);
+    for (uint32_t i = 0; i < uploadedMeshes; i++) {
+        if (positionDequantizationUniform >= 0) {
+            glUniform3fv(positionDequantizationUniform, 2, quantizations[i].positionOffset);
+        }
+        vaos[i]->bind();
+        vaos[i]->drawTriangles();
+    }
     
-    _skeleton->resetAllJoints();
+}
+
+void Model::drawMeshesInstanced(GLsizei instanceCount, GLint positionDequantizationUniform) const {
+    
+    for (uint32_t i = 0; i < uploadedMeshes; i++) {
+        if (positionDequantizationUniform >= 0) {
+            glUniform3fv(positionDequantizationUniform, 2, quantizations[i].positionOffset);
+        }
+        vaos[i]->bind();
+        vaos[i]->drawTrianglesInstanced(instanceCount);
+    }
     
 }
 
-void Model::draw(GLint jointsUniform) {
+void Model::queueMeshes(RenderQueue &queue, const RenderItem &item, float depth) const {
+    RenderItem meshItem = item;
+    for (uint32_t i = 0; i < uploadedMeshes; i++) {
+        meshItem.vao = vaos[i];
+        meshItem.index = i;
+        queue.add(meshItem, depth);
+    }
+}
 
-    glUniformMatrix4fv(jointsUniform, _skeleton->bonesCount, 0, glm::value_ptr(_skeleton->joints[0]));
+bool Model::uploadNextMesh() {
+    if (uploadedMeshes >= meshCount) {
+        return false;
+    }
     
-    for (int i = 0; i < meshCount; i++) {
-        vaos[i]->bind();
-        glDrawArrays(GL_TRIANGLES, 0, vaos[i]->getVertexCount());
+    uint32_t i = uploadedMeshes++;
+    vaos[i] = new VertexArrayObject(meshData[i].getVertexCount());
+    meshData[i].upload(*vaos[i]);
+    gpuMemory += meshData[i].getUploadSize();
+    glBindVertexArray(0);
+    
+    if (loadOptions.keepMeshData) {
+        meshData[i].detach();
+    } else {
+        meshData[i] = MeshData(0); // the data now lives in the VBOs
     }
     
+    return uploadedMeshes < meshCount;
+}
+
+void Model::uploadMeshes() {
+    while (uploadNextMesh());
+    
+    // The stream may have been kept only for the meshes.
+    if (animationSource) {
+        BinaryInputStream *is = animationSource;
+        animationSource = nullptr;
+        adoptAnimationSource(is);
+    }
+}
+
+size_t Model::getCPUMemorySize() const {
+    size_t size = 0;
+    for (uint32_t i = 0; i < _animCount; i++) {
+        if (_animations[i]) {
+            size += _animations[i]->getMemorySize();
+        }
+    }
+    return size;
+}
+
+Animation *Model::getAnimation(uint32_t animID) {
+    if (animID >= _animCount) {
+        return nullptr;
+    }
+    
+    _animationLastUse[animID] = ++animationClock;
+    
+    if (!_animations[animID] && _animationOffsets[animID] && animationSource) {
+        animationSource->clear();
+        animationSource->seek(_animationOffsets[animID]);
+        
+        Animation *anim = readAnimation(*animationSource, _skeleton);
+        if (!anim) {
+            return nullptr;
+        }
+        if (anim->getAnimationID() != animID) {
+            std::cerr << "Invalid FDMD animation ID: " << anim->getAnimationID() << std::endl;
+            delete anim;
+            return nullptr;
+        }
+        
+        _animations[animID] = anim;
+        prepareAnimation(*anim, loadOptions, _animationFrameRates[animID]);
+        animationMemory += anim->getMemorySize();
+        
+        evictAnimations(animID);
+    }
+    
+    return _animations[animID];
+}
+
+void Model::prepareAnimation(Animation &anim, const ModelLoadOptions &options, float frameRate) {
+    if (frameRate > 0) {
+        anim.bake(frameRate);
+    } else if (options.compressAnimations) {
+        anim.compress();
+    } else {
+        anim.computeReference();
+    }
+}
+
+void Model::setAnimationFrameRate(uint32_t animID, float frameRate) {
+    if (animID >= _animCount) {
+        return;
+    }
+    
+    _animationFrameRates[animID] = frameRate;
+    
+    Animation *anim = _animations[animID];
+    if (!anim) {
+        return;
+    }
+    
+    if (_animationOffsets[animID] && animationSource) {
+        animationMemory -= anim->getMemorySize();
+        delete anim;
+        _animations[animID] = nullptr;
+    } else {
+        anim->bake(frameRate);
+    }
+}
+
+void Model::setAnimationBudget(size_t bytes) {
+    animationBudget = bytes;
+    evictAnimations(_animCount);
+}
+
+void Model::evictAnimations(uint32_t keep) {
+    while (animationBudget > 0 && animationMemory > animationBudget) {
+        uint32_t victim = _animCount;
+        
+        for (uint32_t i = 0; i < _animCount; i++) {
+            if (i != keep && _animations[i] && _animationOffsets[i] && (victim == _animCount || _animationLastUse[i] < _animationLastUse[victim])) {
+                victim = i;
+            }
+        }
+        
+        if (victim == _animCount) {
+            break; // only the requested animation is left
+        }
+        
+        animationMemory -= _animations[victim]->getMemorySize();
+        delete _animations[victim];
+        _animations[victim] = nullptr;
+    }
 }
@@ -0,0 +1,248 @@
+//
+// => gcore/graphics/model/model_instance.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <gcore/graphics/model/model_instance.h>
+
+#include <GL/glew.h>
+
+#include <algorithm>
+#include <cassert>
+#include <cmath>
+#include <cstring>
+
+using namespace gcore;
+
+/*!
+ \brief Returns a buffer for the pose of a skeleton, shared by the instances updated on the calling thread.
+ \note Nodes not animated by a clip stay in their bind pose, so the pose is rebuilt from it at each update rather than kept by every instance.
+ */
+static Affine3x4 *poseBuffer(const Skeleton &skeleton) {
+    static thread_local std::vector<Affine3x4> pose;
+    
+    pose.resize(skeleton.getNodesCount());
+    skeleton.getBindPose(pose.data());
+    return pose.data();
+}
+
+ModelInstance::ModelInstance(Model &model) : model(model), layers(1) {
+    if (const Skeleton *skeleton = model.getSkeleton()) {
+        computePalette(poseBuffer(*skeleton));
+    }
+}
+
+void ModelInstance::computePalette(const Affine3x4 *nodeTransforms) {
+    const Skeleton *skeleton = model.getSkeleton();
+    paletteFormat = model.getJointPaletteFormat();
+    palette.resize(skeleton->getBonesCount() * jointPaletteTexels(paletteFormat));
+    skeleton->computeJoints(nodeTransforms, paletteFormat, palette.data());
+}
+
+void ModelInstance::play(uint32_t newAnimID, uint32_t layer) {
+    AnimationLayer &l = layers[layer];
+    l.animID = newAnimID;
+    l.elapsed = 0;
+    l.cursors.clear();
+    l.fade = 1.0f;
+    l.fadeSpeed = 0.0f;
+}
+
+void ModelInstance::crossfade(uint32_t newAnimID, double duration, uint32_t layer) {
+    if (duration <= 0) {
+        play(newAnimID, layer);
+        return;
+    }
+    
+    AnimationLayer &l = layers[layer];
+    l.previousAnimID = l.animID;
+    l.previousElapsed = l.elapsed;
+    std::swap(l.previousCursors, l.cursors);
+    
+    l.animID = newAnimID;
+    l.elapsed = 0;
+    l.cursors.clear();
+    l.fade = 0.0f;
+    l.fadeSpeed = (float)(1.0 / duration);
+}
+
+uint32_t ModelInstance::addLayer(uint32_t newAnimID, PoseBlendMode mode, float weight, const BoneMask *mask) {
+    layers.emplace_back();
+    
+    AnimationLayer &l = layers.back();
+    l.animID = newAnimID;
+    l.mode = mode;
+    l.weight = l.targetWeight = weight;
+    l.mask = mask;
+    return (uint32_t)layers.size() - 1;
+}
+
+void ModelInstance::removeLayer(uint32_t layer) {
+    if (layer > 0 && layer < layers.size()) {
+        layers.erase(layers.begin() + layer);
+    }
+}
+
+void ModelInstance::setLayerWeight(uint32_t layer, float weight, double duration) {
+    AnimationLayer &l = layers[layer];
+    l.targetWeight = weight;
+    if (duration > 0) {
+        l.weightSpeed = (float)(fabs(weight - l.weight) / duration);
+    } else {
+        l.weight = weight;
+        l.weightSpeed = 0.0f;
+    }
+}
+
+/*!
+ \brief Moves \c value towards \c target by \c step at most.
+ */
+static inline float approach(float value, float target, float step) {
+    return value < target ? fminf(value + step, target) : fmaxf(value - step, target);
+}
+
+/*!
+ \brief Advances a clip of a layer and blends it into the pose, unless its weight is 0.
+ \note The clip is requested right before it is sampled: requesting another clip may unload it if the model has an animation budget.
+ */
+static void sampleClip(Model &model, uint32_t animID, double &elapsed, std::vector<KeyFrame> &cursors, double dt, Pose &pose, float weight, const AnimationLayer &layer) {
+    elapsed += dt;
+    if (weight <= 0) {
+        return;
+    }
+    
+    Animation *anim = model.getAnimation(animID);
+    if (!anim) {
+        return;
+    }
+    
+    if (cursors.size() != anim->getKeyChannelsCount()) {
+        cursors.assign(anim->getKeyChannelsCount(), KeyFrame());
+    }
+    
+    double duration = anim->getTotalDuration();
+    anim->sample(duration > 0 ? fmod(elapsed, duration) : 0.0, cursors.data(), pose, weight, layer.mode, layer.mask);
+}
+
+void ModelInstance::update(double dt) {
+    const Skeleton *skeleton = model.getSkeleton();
+    if (!skeleton) {
+        return; // static model
+    }
+    
+    Affine3x4 *nodeTransforms = poseBuffer(*skeleton);
+    
+    static thread_local Pose pose;
+    if (pose.getCount() != skeleton->getNodesCount()) {
+        pose.resize(skeleton->getNodesCount());
+    } else {
+        pose.clear();
+    }
+    pose.setBindPose(&skeleton->getBindTransforms());
+    
+    for (AnimationLayer &layer : layers) {
+        layer.weight = approach(layer.weight, layer.targetWeight, layer.weightSpeed * (float)dt);
+        
+        bool fading = layer.fade < 1.0f;
+        if (fading) {
+            layer.fade = fminf(layer.fade + layer.fadeSpeed * (float)dt, 1.0f);
+        }
+        
+        float w = layer.weight, f = layer.fade;
+        if (!fading) {
+            sampleClip(model, layer.animID, layer.elapsed, layer.cursors, dt, pose, w, layer);
+            continue;
+        }
+        
+        // The two clips blend as lerp(previous, clip, f) applied with weight w: the previous clip is blended first, with the weight leaving w * (1 - f) of it once the clip is blended with w * f.
+        float previousWeight;
+        switch (layer.mode) {
+            case PoseBlendOverride:
+                previousWeight = w * f < 1.0f ? w * (1.0f - f) / (1.0f - w * f) : 0.0f;
+                break;
+            default:
+                previousWeight = w * (1.0f - f);
+                break;
+        }
+        
+        sampleClip(model, layer.previousAnimID, layer.previousElapsed, layer.previousCursors, dt, pose, previousWeight, layer);
+        sampleClip(model, layer.animID, layer.elapsed, layer.cursors, dt, pose, w * f, layer);
+    }
+    
+    pose.toAffine(nodeTransforms);
+    computePalette(nodeTransforms);
+}
+
+void ModelInstance::streamJoints(StreamBuffer &palettes) {
+    size_t size = palette.size() * sizeof(glm::vec4);
+    memcpy(palettes.allocate(size, sizeof(glm::vec4), paletteOffset), palette.data(), size);
+}
+
+void ModelInstance::draw(const StreamBuffer &palettes, GLint paletteOffsetUniform, GLint positionDequantizationUniform) const {
+    glUniform1i(paletteOffsetUniform, (GLint)((palettes.getRegionOffset() + paletteOffset) / sizeof(glm::vec4)));
+    
+    model.drawMeshes(positionDequantizationUniform);
+}
+
+void InstanceBatch::stream(StreamBuffer &palettes, ModelInstance *const *instances, const glm::mat4 *modelMatrices, uint32_t count) {
+    instanceCount = count;
+    if (count == 0) {
+        return;
+    }
+    
+    for (uint32_t i = 0; i < count; i++) {
+        assert(&instances[i]->getModel() == &model);
+        instances[i]->streamJoints(palettes);
+    }
+    
+    // Allocated after the palettes, since allocations invalidate the pointers returned before.
+    glm::vec4 *records = (glm::vec4 *)palettes.allocate(count * RecordTexels * sizeof(glm::vec4), sizeof(glm::vec4), recordsOffset);
+    for (uint32_t i = 0; i < count; i++) {
+        glm::vec4 *record = records + i * RecordTexels;
+        Affine3x4 transform;
+        affineFromMat4(modelMatrices[i], transform);
+        memcpy(record, transform.rows, sizeof(transform.rows));
+        
+        ptrdiff_t paletteTexel = ((ptrdiff_t)instances[i]->getPaletteOffset() - (ptrdiff_t)recordsOffset) / (ptrdiff_t)sizeof(glm::vec4);
+        record[3] = glm::vec4((float)paletteTexel, 0.0f, 0.0f, 0.0f);
+    }
+}
+
+void InstanceBatch::draw(const StreamBuffer &palettes, GLint instanceOffsetUniform, GLint positionDequantizationUniform) const {
+    if (instanceCount == 0) {
+        return;
+    }
+    
+    glUniform1i(instanceOffsetUniform, getInstanceOffset(palettes));
+    
+    model.drawMeshesInstanced((GLsizei)instanceCount, positionDequantizationUniform);
+}
+
+size_t ModelInstance::getMemorySize() const {
+    size_t size = sizeof(ModelInstance) + layers.capacity() * sizeof(AnimationLayer) + palette.capacity() * sizeof(glm::vec4);
+    for (const AnimationLayer &layer : layers) {
+        size += (layer.cursors.capacity() + layer.previousCursors.capacity()) * sizeof(KeyFrame);
+    }
+    return size;
+}
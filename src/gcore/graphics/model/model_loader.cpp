@@ -0,0 +1,108 @@
+//
+// => gcore/graphics/model/model_loader.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <gcore/graphics/model/model_loader.h>
+
+#include <chrono>
+
+using namespace gcore;
+
+Model *ModelRequest::takeModel() {
+    if (getState() != ModelRequestReady) {
+        return nullptr;
+    }
+    
+    Model *taken = model;
+    model = nullptr;
+    return taken;
+}
+
+std::shared_ptr<ModelRequest> ModelLoader::load(const char *fileName, const ModelLoadOptions &options) {
+    std::shared_ptr<ModelRequest> request = std::make_shared<ModelRequest>(fileName, options);
+    std::shared_ptr<UploadQueue> queue = uploads;
+    ThreadPool *decodePool = &pool;
+    
+    pool.submit([request, queue, decodePool]() {
+        BinaryInputStream *stream = new BinaryInputStream(request->fileName.c_str(), BinaryInputStreamMapped);
+        Model *model = Model::decode(*stream, request->options, decodePool);
+        
+        if (!model) {
+            delete stream;
+            request->state.store(ModelRequestFailed, std::memory_order_release);
+            return;
+        }
+        
+        request->stream = stream;
+        request->model = model;
+        request->state.store(ModelRequestUploading, std::memory_order_release);
+        
+        std::lock_guard<std::mutex> lock(queue->mutex);
+        queue->requests.push_back(request);
+    });
+    
+    return request;
+}
+
+size_t ModelLoader::processUploads(double budgetSeconds) {
+    typedef std::chrono::steady_clock clock;
+    clock::time_point start = clock::now();
+    
+    size_t uploaded = 0;
+    do {
+        if (!current) {
+            std::lock_guard<std::mutex> lock(uploads->mutex);
+            if (uploads->requests.empty()) {
+                break;
+            }
+            current = uploads->requests.front();
+            uploads->requests.pop_front();
+        }
+        
+        Model *model = current->model;
+        if (!model->isUploaded()) {
+            model->uploadNextMesh();
+            uploaded++;
+        }
+        
+        if (model->isUploaded()) {
+            model->adoptAnimationSource(current->stream);
+            current->stream = nullptr;
+            current->state.store(ModelRequestReady, std::memory_order_release);
+            current.reset();
+        }
+    } while (std::chrono::duration<double>(clock::now() - start).count() < budgetSeconds);
+    
+    return uploaded;
+}
+
+bool ModelLoader::hasPendingUploads() const {
+    if (current) {
+        return true;
+    }
+    
+    std::lock_guard<std::mutex> lock(uploads->mutex);
+    return !uploads->requests.empty();
+}
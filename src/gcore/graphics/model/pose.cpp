@@ -0,0 +1,186 @@
+//
+// => gcore/graphics/model/pose.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <gcore/graphics/model/pose.h>
+#include <gcore/graphics/model/skeleton.h>
+
+#include <math.h>
+
+#include <algorithm>
+
+using namespace gcore;
+
+void BoneMask::setSubtree(const SkeletonBone &node, float weight) {
+    weights[node.getBoneID()] = weight;
+    for (uint32_t i = 0; i < node.getChildrenCount(); i++) {
+        setSubtree(*node.getChild(i), weight);
+    }
+}
+
+void Pose::resize(uint32_t newCount) {
+    count = newCount;
+    stride = (newCount + 7) & ~7u;
+    components.assign((size_t)stride * ComponentCount, 0.0f);
+    weights.assign(newCount, 0.0f);
+}
+
+void Pose::clear() {
+    std::fill(weights.begin(), weights.end(), 0.0f);
+}
+
+void Pose::setTransform(uint32_t node, const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale) {
+    float *c = components.data() + node;
+    c[TranslationX * stride] = translation.x;
+    c[TranslationY * stride] = translation.y;
+    c[TranslationZ * stride] = translation.z;
+    c[RotationX * stride] = rotation.x;
+    c[RotationY * stride] = rotation.y;
+    c[RotationZ * stride] = rotation.z;
+    c[RotationW * stride] = rotation.w;
+    c[ScaleX * stride] = scale.x;
+    c[ScaleY * stride] = scale.y;
+    c[ScaleZ * stride] = scale.z;
+    weights[node] = 1.0f;
+}
+
+void Pose::settle(uint32_t node) {
+    float weight = weights[node];
+    if (!bindPose || weight >= 1.0f) {
+        return;
+    }
+    weights[node] = 1.0f;
+    
+    const float *b = bindPose->components.data() + node;
+    uint32_t bindStride = bindPose->stride;
+    float *c = components.data() + node;
+    if (weight <= 0) {
+        for (uint32_t i = 0; i < ComponentCount; i++) {
+            c[i * stride] = b[i * bindStride];
+        }
+        return;
+    }
+    
+    for (uint32_t i : { TranslationX, TranslationY, TranslationZ, ScaleX, ScaleY, ScaleZ }) {
+        c[i * stride] = b[i * bindStride] + (c[i * stride] - b[i * bindStride]) * weight;
+    }
+    
+    float dot = 0.0f;
+    for (uint32_t i = RotationX; i <= RotationW; i++) {
+        dot += c[i * stride] * b[i * bindStride];
+    }
+    float sign = dot < 0 ? -weight : weight;
+    float q[4], length = 0.0f;
+    for (uint32_t i = 0; i < 4; i++) {
+        q[i] = b[(RotationX + i) * bindStride] * (1.0f - weight) + c[(RotationX + i) * stride] * sign;
+        length += q[i] * q[i];
+    }
+    float inverse = length > 0 ? 1.0f / sqrtf(length) : 0.0f;
+    for (uint32_t i = 0; i < 4; i++) {
+        c[(RotationX + i) * stride] = q[i] * inverse;
+    }
+}
+
+void Pose::blendTransform(uint32_t node, const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale, float weight, PoseBlendMode mode) {
+    if (weight <= 0 || (weights[node] <= 0 && mode == PoseBlendAdditive)) {
+        return;
+    }
+    // Weighted transforms are averaged first, and lerped from the bind pose by their total weight once another mode blends on top of them.
+    if (mode != PoseBlendWeighted) {
+        settle(node);
+    }
+    
+    float current = weights[node];
+    if (current <= 0) {
+        setTransform(node, translation, rotation, scale);
+        weights[node] = mode == PoseBlendWeighted ? weight : 1.0f;
+        return;
+    }
+    
+    float *c = components.data() + node;
+    float &tx = c[TranslationX * stride], &ty = c[TranslationY * stride], &tz = c[TranslationZ * stride];
+    float &qx = c[RotationX * stride], &qy = c[RotationY * stride], &qz = c[RotationZ * stride], &qw = c[RotationW * stride];
+    float &sx = c[ScaleX * stride], &sy = c[ScaleY * stride], &sz = c[ScaleZ * stride];
+    
+    float x, y, z, w;
+    if (mode == PoseBlendAdditive) {
+        tx += translation.x * weight;
+        ty += translation.y * weight;
+        tz += translation.z * weight;
+        sx *= 1.0f + (scale.x - 1.0f) * weight;
+        sy *= 1.0f + (scale.y - 1.0f) * weight;
+        sz *= 1.0f + (scale.z - 1.0f) * weight;
+        
+        // The difference is scaled by a normalized lerp from the identity, and composed as current * difference.
+        float sign = rotation.w < 0 ? -1.0f : 1.0f;
+        float dx = rotation.x * sign * weight, dy = rotation.y * sign * weight, dz = rotation.z * sign * weight;
+        float dw = 1.0f + (rotation.w * sign - 1.0f) * weight;
+        
+        x = qw * dx + qx * dw + qy * dz - qz * dy;
+        y = qw * dy - qx * dz + qy * dw + qz * dx;
+        z = qw * dz + qx * dy - qy * dx + qz * dw;
+        w = qw * dw - qx * dx - qy * dy - qz * dz;
+    } else {
+        float f;
+        if (mode == PoseBlendWeighted) {
+            f = weight / (current + weight);
+            weights[node] = current + weight;
+        } else {
+            f = fminf(weight, 1.0f);
+            weights[node] = fmaxf(current, 1.0f);
+        }
+        
+        tx += (translation.x - tx) * f;
+        ty += (translation.y - ty) * f;
+        tz += (translation.z - tz) * f;
+        sx += (scale.x - sx) * f;
+        sy += (scale.y - sy) * f;
+        sz += (scale.z - sz) * f;
+        
+        float sign = qx * rotation.x + qy * rotation.y + qz * rotation.z + qw * rotation.w < 0 ? -f : f;
+        x = qx + (rotation.x * sign - qx * f);
+        y = qy + (rotation.y * sign - qy * f);
+        z = qz + (rotation.z * sign - qz * f);
+        w = qw + (rotation.w * sign - qw * f);
+    }
+    
+    float length = sqrtf(x * x + y * y + z * z + w * w);
+    float inverse = length > 0 ? 1.0f / length : 0.0f;
+    qx = x * inverse;
+    qy = y * inverse;
+    qz = z * inverse;
+    qw = w * inverse;
+}
+
+void Pose::toAffine(Affine3x4 *nodeTransforms) {
+    if (bindPose) {
+        for (uint32_t node = 0; node < count; node++) {
+            if (weights[node] > 0) {
+                settle(node);
+            }
+        }
+    }
+    composeTRSBatch(components.data(), stride, weights.data(), count, nodeTransforms);
+}
@@ -26,26 +26,119 @@
 
 #include <gcore/graphics/model/skeleton.h>
 
+#include <algorithm>
+#include <cmath>
 #include <cstdint>
+#include <vector>
 
 #include <iostream>
 
 using namespace gcore;
 
-void Skeleton::resetJoint(uint32_t boneID) {
-    SkeletonBone *bone = bones[boneID];
+/*!
+ \brief Returns the arena size holding the nodes of a skeleton, the table of nodes, the children of each node (every node but the root is a child), the sorted node and parent IDs, the bind poses and the offset matrices.
+ */
+static inline size_t skeletonArenaSize(uint32_t bonesCount, uint32_t nodesCount) {
+    return nodesCount * (sizeof(SkeletonBone) + alignof(SkeletonBone)) + nodesCount * 2 * (sizeof(SkeletonBone *) + alignof(SkeletonBone *))
+           + nodesCount * 2 * sizeof(uint32_t) + 2 * alignof(uint32_t) + (nodesCount + bonesCount) * sizeof(Affine3x4) + 2 * alignof(Affine3x4);
+}
+
+Skeleton::Skeleton(uint32_t bonesCount, uint32_t nodesCount) : bonesCount(bonesCount), nodesCount(nodesCount), arena(skeletonArenaSize(bonesCount, nodesCount)) {
+    bones = arena.allocateArray<SkeletonBone *>(nodesCount);
+    std::fill(bones, bones + nodesCount, nullptr);
+}
+
+void Skeleton::getBindPose(Affine3x4 *nodeTransforms) const {
+    std::copy(bindPoses, bindPoses + nodesCount, nodeTransforms);
+}
+
+void Skeleton::sortNodes() {
+    if (!sortedNodes) {
+        sortedNodes = arena.allocateArray<uint32_t>(nodesCount);
+        sortedParents = arena.allocateArray<uint32_t>(nodesCount);
+        bindPoses = arena.allocateArray<Affine3x4>(nodesCount);
+        offsetMatrices = arena.allocateArray<Affine3x4>(bonesCount);
+    }
     
-    glm::mat4 joint = bone->getNodeTransform() * bone->getOffsetMatrix();
+    sortedCount = 0;
+    if (rootBone) {
+        sortedNodes[sortedCount] = rootBone->getBoneID();
+        sortedParents[sortedCount++] = NoParent;
+    }
     
-    while ((bone = bone->getParent())) {
-        joint = bone->getNodeTransform() * joint;
+    // Breadth first: the sorted nodes are the queue.
+    for (uint32_t k = 0; k < sortedCount; k++) {
+        SkeletonBone *node = bones[sortedNodes[k]];
+        for (uint32_t i = 0; i < node->getChildrenCount(); i++) {
+            sortedNodes[sortedCount] = node->getChild(i)->getBoneID();
+            sortedParents[sortedCount++] = sortedNodes[k];
+        }
     }
     
-    joints[boneID] = finalTransform * joint;
+    for (uint32_t i = 0; i < nodesCount; i++) {
+        affineFromMat4(bones[i] ? bones[i]->getBindPose() : glm::mat4(1.0f), bindPoses[i]);
+    }
+    for (uint32_t i = 0; i < bonesCount; i++) {
+        affineFromMat4(bones[i] ? bones[i]->getOffsetMatrix() : glm::mat4(1.0f), offsetMatrices[i]);
+    }
+    
+    bindTransforms.resize(nodesCount);
+    for (uint32_t i = 0; i < nodesCount; i++) {
+        const Affine3x4 &a = bindPoses[i];
+        glm::vec3 scale;
+        for (int c = 0; c < 3; c++) {
+            scale[c] = sqrtf(a.rows[0][c] * a.rows[0][c] + a.rows[1][c] * a.rows[1][c] + a.rows[2][c] * a.rows[2][c]);
+        }
+        bindTransforms.setTransform(i, glm::vec3(a.rows[0][3], a.rows[1][3], a.rows[2][3]), affineRotation(a), scale);
+    }
 }
 
-void Skeleton::resetAllJoints() {
+const Affine3x4 *Skeleton::computeModelTransforms(const Affine3x4 *nodeTransforms) const {
+    static thread_local std::vector<Affine3x4> modelTransforms;
+    modelTransforms.resize(nodesCount);
+    Affine3x4 *model = modelTransforms.data();
+    
+    Affine3x4 root;
+    affineFromMat4(finalTransform, root);
+    
+    // The final transform is applied at the root, so that it is carried down to every node.
+    for (uint32_t k = 0; k < sortedCount; k++) {
+        uint32_t node = sortedNodes[k], parent = sortedParents[k];
+        multiplyAffine(parent == NoParent ? root : model[parent], nodeTransforms[node], model[node]);
+    }
+    
+    return model;
+}
+
+void Skeleton::computeJoints(const Affine3x4 *nodeTransforms, glm::mat4 *joints) const {
+    multiplyAffineBatch(computeModelTransforms(nodeTransforms), offsetMatrices, bonesCount, joints);
+}
+
+void Skeleton::computeJoints(const Affine3x4 *nodeTransforms, Affine3x4 *joints) const {
+    multiplyAffineBatch(computeModelTransforms(nodeTransforms), offsetMatrices, bonesCount, joints);
+}
+
+void Skeleton::computeJoints(const Affine3x4 *nodeTransforms, DualQuaternion *joints) const {
+    const Affine3x4 *model = computeModelTransforms(nodeTransforms);
+    
+    Affine3x4 joint;
     for (uint32_t i = 0; i < bonesCount; i++) {
-        resetJoint(i);
+        multiplyAffine(model[i], offsetMatrices[i], joint);
+        affineToDualQuaternion(joint, joints[i]);
+    }
+}
+
+void Skeleton::computeJoints(const Affine3x4 *nodeTransforms, JointPaletteFormat format, glm::vec4 *palette) const {
+    // The joints of every format are a whole number of vec4.
+    switch (format) {
+        case JointPaletteAffine:
+            computeJoints(nodeTransforms, reinterpret_cast<Affine3x4 *>(palette));
+            break;
+        case JointPaletteDualQuaternion:
+            computeJoints(nodeTransforms, reinterpret_cast<DualQuaternion *>(palette));
+            break;
+        default:
+            computeJoints(nodeTransforms, reinterpret_cast<glm::mat4 *>(palette));
+            break;
     }
 }
@@ -36,4 +36,14 @@ GLuint gcore::loadTexture(std::string imgPath) {
 
 Texture::Texture(const char *texPath) {
     _texid = SOIL_load_OGL_texture(texPath, SOIL_LOAD_AUTO, SOIL_CREATE_NEW_ID, 0);
+    
+    if (_texid) {
+        GLint width = 0, height = 0;
+        glBindTexture(GL_TEXTURE_2D, _texid);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_WIDTH, &width);
+        glGetTexLevelParameteriv(GL_TEXTURE_2D, 0, GL_TEXTURE_HEIGHT, &height);
+        glBindTexture(GL_TEXTURE_2D, 0);
+        
+        memorySize = (size_t)width * height * 4;
+    }
 }
@@ -0,0 +1,175 @@
+//
+// => gcore/graphics/model/vertex_packing.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <gcore/graphics/model/vertex_packing.h>
+
+#include <algorithm>
+#include <cmath>
+#include <cstring>
+
+using namespace gcore;
+
+uint16_t gcore::floatToHalf(float x) {
+    uint32_t bits;
+    memcpy(&bits, &x, 4);
+    
+    uint16_t sign = (uint16_t)((bits >> 16) & 0x8000);
+    uint32_t exponent = (bits >> 23) & 0xFF;
+    uint32_t mantissa = bits & 0x7FFFFF;
+    
+    if (exponent == 0xFF) { // infinity or NaN
+        return sign | 0x7C00 | (mantissa ? 0x200 : 0);
+    }
+    
+    int32_t halfExponent = (int32_t)exponent - 127 + 15;
+    if (halfExponent >= 31) { // too large, infinity
+        return sign | 0x7C00;
+    }
+    
+    if (halfExponent <= 0) { // subnormal or zero
+        if (halfExponent < -10) {
+            return sign;
+        }
+        mantissa |= 0x800000;
+        uint32_t shift = (uint32_t)(14 - halfExponent);
+        uint32_t half = mantissa >> shift;
+        uint32_t rest = mantissa & ((1u << shift) - 1);
+        uint32_t halfway = 1u << (shift - 1);
+        if (rest > halfway || (rest == halfway && (half & 1))) {
+            half++;
+        }
+        return sign | (uint16_t)half;
+    }
+    
+    uint32_t half = ((uint32_t)halfExponent << 10) | (mantissa >> 13);
+    uint32_t rest = mantissa & 0x1FFF;
+    if (rest > 0x1000 || (rest == 0x1000 && (half & 1))) {
+        half++; // may carry into the exponent, which is still the correct rounding
+    }
+    return sign | (uint16_t)half;
+}
+
+float gcore::halfToFloat(uint16_t h) {
+    uint32_t sign = (uint32_t)(h & 0x8000) << 16;
+    uint32_t exponent = (h >> 10) & 0x1F;
+    uint32_t mantissa = h & 0x3FF;
+    uint32_t bits;
+    
+    if (exponent == 0x1F) {
+        bits = sign | 0x7F800000 | (mantissa << 13);
+    } else if (exponent == 0) {
+        float value = std::ldexp((float)mantissa, -24);
+        return sign ? -value : value;
+    } else {
+        bits = sign | ((exponent - 15 + 127) << 23) | (mantissa << 13);
+    }
+    
+    float x;
+    memcpy(&x, &bits, 4);
+    return x;
+}
+
+int16_t gcore::packSNorm16(float x) {
+    return (int16_t)std::lround(std::min(std::max(x, -1.0f), 1.0f) * 32767.0f);
+}
+
+float gcore::unpackSNorm16(int16_t x) {
+    return std::max(x / 32767.0f, -1.0f);
+}
+
+uint16_t gcore::packUNorm16(float x) {
+    return (uint16_t)std::lround(std::min(std::max(x, 0.0f), 1.0f) * 65535.0f);
+}
+
+float gcore::unpackUNorm16(uint16_t x) {
+    return x / 65535.0f;
+}
+
+uint32_t gcore::packSNorm2_10_10_10(float x, float y, float z, float w) {
+    auto pack = [](float v, float max, uint32_t mask) {
+        return (uint32_t)(int32_t)std::lround(std::min(std::max(v, -1.0f), 1.0f) * max) & mask;
+    };
+    return pack(x, 511.0f, 0x3FF) | (pack(y, 511.0f, 0x3FF) << 10) | (pack(z, 511.0f, 0x3FF) << 20) | (pack(w, 1.0f, 0x3) << 30);
+}
+
+void gcore::unpackSNorm2_10_10_10(uint32_t packed, float *out) {
+    // Sign extension of each field.
+    int32_t x = (int32_t)(packed << 22) >> 22;
+    int32_t y = (int32_t)(packed << 12) >> 22;
+    int32_t z = (int32_t)(packed << 2) >> 22;
+    int32_t w = (int32_t)packed >> 30;
+    
+    out[0] = std::max(x / 511.0f, -1.0f);
+    out[1] = std::max(y / 511.0f, -1.0f);
+    out[2] = std::max(z / 511.0f, -1.0f);
+    out[3] = std::max((float)w, -1.0f);
+}
+
+void gcore::computeQuantizationRange(const float *values, size_t count, size_t components, float *offset, float *scale) {
+    for (size_t c = 0; c < components; c++) {
+        float min = count > 0 ? values[c] : 0.0f;
+        float max = min;
+        for (size_t i = 1; i < count; i++) {
+            min = std::min(min, values[i * components + c]);
+            max = std::max(max, values[i * components + c]);
+        }
+        
+        offset[c] = (min + max) * 0.5f;
+        scale[c] = (max - min) * 0.5f;
+        if (scale[c] <= 0.0f) {
+            scale[c] = 1.0f; // flat along this axis, any scale maps it to 0
+        }
+    }
+}
+
+void gcore::packBoneWeights(uint8_t *dst, const float *weights, size_t count, size_t components) {
+    for (size_t i = 0; i < count; i++) {
+        const float *w = weights + i * components;
+        uint8_t *out = dst + i * components;
+        
+        float sum = 0.0f;
+        for (size_t c = 0; c < components; c++) {
+            sum += std::max(w[c], 0.0f);
+        }
+        
+        if (sum <= 0.0f) {
+            memset(out, 0, components);
+            continue;
+        }
+        
+        // Round each weight, then give the rounding error to the largest one so that the sum is 255.
+        int total = 0;
+        size_t largest = 0;
+        for (size_t c = 0; c < components; c++) {
+            out[c] = (uint8_t)std::lround(std::max(w[c], 0.0f) / sum * 255.0f);
+            total += out[c];
+            if (w[c] > w[largest]) {
+                largest = c;
+            }
+        }
+        out[largest] = (uint8_t)(out[largest] + 255 - total);
+    }
+}
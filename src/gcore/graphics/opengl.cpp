@@ -26,8 +26,42 @@
 
 #include <gcore/graphics/opengl.h>
 
+#include <algorithm>
+
 using namespace gcore;
 
+GLuint gcore::glTypeSize(GLenum type) {
+    switch (type) {
+        case GL_BYTE:
+        case GL_UNSIGNED_BYTE:
+            return 1;
+        case GL_SHORT:
+        case GL_UNSIGNED_SHORT:
+        case GL_HALF_FLOAT:
+            return 2;
+        default:
+            return 4;
+    }
+}
+
+GLuint gcore::glAttribSize(GLint components, GLenum type) {
+    switch (type) {
+        case GL_INT_2_10_10_10_REV:
+        case GL_UNSIGNED_INT_2_10_10_10_REV:
+            return 4;
+        default:
+            return components * glTypeSize(type);
+    }
+}
+
+VertexLayout &VertexLayout::add(GLuint location, GLint components, GLenum type, GLboolean normalized, bool integer) {
+    GLuint offset = (stride + 3) & ~3u;
+    
+    attribs.push_back({ location, components, type, normalized, integer, offset });
+    stride = (offset + glAttribSize(components, type) + 3) & ~3u;
+    return *this;
+}
+
 GLuint VertexArrayObject::createBuffer() {
     GLuint ret;
     glGenBuffers(1, &ret);
@@ -35,7 +69,22 @@ GLuint VertexArrayObject::createBuffer() {
     return ret;
 }
 
-void VertexArrayObject::bindPositions(GLfloat *data) {
+void VertexArrayObject::bindInterleaved(const void *data, const VertexLayout &layout) {
+    GLuint buffer = createBuffer();
+    glBindBuffer(GL_ARRAY_BUFFER, buffer);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * layout.getStride(), data, GL_STATIC_DRAW);
+    
+    for (const VertexAttribFormat &attrib : layout.getAttribs()) {
+        glEnableVertexAttribArray(attrib.location);
+        if (attrib.integer) {
+            glVertexAttribIPointer(attrib.location, attrib.components, attrib.type, layout.getStride(), BUFFER_OFFSET((size_t)attrib.offset));
+        } else {
+            glVertexAttribPointer(attrib.location, attrib.components, attrib.type, attrib.normalized, layout.getStride(), BUFFER_OFFSET((size_t)attrib.offset));
+        }
+    }
+}
+
+void VertexArrayObject::bindPositions(const GLfloat *data) {
     GLuint posBuffer = createBuffer();
     glBindBuffer(GL_ARRAY_BUFFER, posBuffer);
     glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(GLfloat) * 3, data, GL_STATIC_DRAW);
@@ -44,7 +93,7 @@ void VertexArrayObject::bindPositions(GLfloat *data) {
     glVertexAttribPointer(OGLVertexAttribPosition, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
 }
 
-void VertexArrayObject::bindNormals(GLfloat *data) {
+void VertexArrayObject::bindNormals(const GLfloat *data) {
     GLuint normBuffer = createBuffer();
     glBindBuffer(GL_ARRAY_BUFFER, normBuffer);
     glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(GLfloat) * 3, data, GL_STATIC_DRAW);
@@ -53,7 +102,7 @@ void VertexArrayObject::bindNormals(GLfloat *data) {
     glVertexAttribPointer(OGLVertexAttribNormal, 3, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
 }
 
-void VertexArrayObject::bindTexCoords2D(GLfloat *data) {
+void VertexArrayObject::bindTexCoords2D(const GLfloat *data) {
     GLuint texCoordsBuffer = createBuffer();
     glBindBuffer(GL_ARRAY_BUFFER, texCoordsBuffer);
     glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(GLfloat) * 2, data, GL_STATIC_DRAW);
@@ -62,7 +111,7 @@ void VertexArrayObject::bindTexCoords2D(GLfloat *data) {
     glVertexAttribPointer(OGLVertexAttribTexCoord2, 2, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
 }
 
-void VertexArrayObject::bindBoneIDs(GLuint *data, GLint weightsPerVertex) {
+void VertexArrayObject::bindBoneIDs(const GLuint *data, GLint weightsPerVertex) {
     GLuint boneIDBuffer = createBuffer();
     glBindBuffer(GL_ARRAY_BUFFER, boneIDBuffer);
     glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(GLuint) * weightsPerVertex, data, GL_STATIC_DRAW);
@@ -70,3 +119,156 @@ void VertexArrayObject::bindBoneIDs(GLuint *data, GLint weightsPerVertex) {
     glEnableVertexAttribArray(OGLVertexAttribBoneID);
     glVertexAttribIPointer(OGLVertexAttribBoneID, weightsPerVertex, GL_UNSIGNED_INT, 0, BUFFER_OFFSET(0));
 }
+
+void VertexArrayObject::bindBoneWeights(const GLfloat *data, GLint weightsPerVertex) {
+    GLuint boneWeightBuffer = createBuffer();
+    glBindBuffer(GL_ARRAY_BUFFER, boneWeightBuffer);
+    glBufferData(GL_ARRAY_BUFFER, vertexCount * sizeof(GLfloat) * weightsPerVertex, data, GL_STATIC_DRAW);
+    
+    glEnableVertexAttribArray(OGLVertexAttribBoneWeight);
+    glVertexAttribPointer(OGLVertexAttribBoneWeight, weightsPerVertex, GL_FLOAT, GL_FALSE, 0, BUFFER_OFFSET(0));
+}
+
+void VertexArrayObject::bindIndices(const void *data, size_t count, GLenum type) {
+    GLuint indexBuffer = createBuffer();
+    glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, indexBuffer); // recorded in the bound VAO
+    glBufferData(GL_ELEMENT_ARRAY_BUFFER, count * (type == GL_UNSIGNED_SHORT ? sizeof(GLushort) : sizeof(GLuint)), data, GL_STATIC_DRAW);
+    
+    indexCount = count;
+    indexType = type;
+}
+
+StreamBuffer::StreamBuffer(GLenum target, size_t regionSize, uint32_t regionCount, GLenum textureFormat) : target(target), textureFormat(textureFormat), regionSize(0), regionCount(regionCount), fences(regionCount, nullptr) {
+    persistent = GLEW_ARB_buffer_storage;
+    
+    if (target == GL_UNIFORM_BUFFER) {
+        GLint alignment;
+        glGetIntegerv(GL_UNIFORM_BUFFER_OFFSET_ALIGNMENT, &alignment);
+        minAlignment = std::max(minAlignment, (size_t)alignment);
+    }
+    
+    if (textureFormat != GL_NONE) {
+        glGenTextures(1, &textureID);
+    }
+    
+    resize((std::max(regionSize, minAlignment) + minAlignment - 1) / minAlignment * minAlignment);
+}
+
+StreamBuffer::~StreamBuffer() {
+    for (GLsync fence : fences) {
+        if (fence) {
+            glDeleteSync(fence);
+        }
+    }
+    glDeleteBuffers(1, &bufferID); // unmaps the buffer
+    glDeleteTextures(1, &textureID);
+}
+
+void StreamBuffer::resize(size_t newRegionSize) {
+    flush();
+    
+    GLuint oldBuffer = bufferID;
+    size_t oldRegionOffset = getRegionOffset();
+    
+    regionSize = newRegionSize;
+    size_t size = regionSize * regionCount;
+    
+    glGenBuffers(1, &bufferID);
+    glBindBuffer(target, bufferID);
+    if (persistent) {
+        GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_PERSISTENT_BIT | GL_MAP_COHERENT_BIT;
+        glBufferStorage(target, (GLsizeiptr)size, nullptr, flags);
+        storage = (uint8_t *)glMapBufferRange(target, 0, (GLsizeiptr)size, flags);
+    } else {
+        glBufferData(target, (GLsizeiptr)size, nullptr, GL_STREAM_DRAW);
+    }
+    
+    if (oldBuffer) {
+        // The old buffer lives on until the GPU is done with it, so its regions need no fence anymore.
+        if (head > 0) {
+            glBindBuffer(GL_COPY_READ_BUFFER, oldBuffer);
+            glBindBuffer(GL_COPY_WRITE_BUFFER, bufferID);
+            glCopyBufferSubData(GL_COPY_READ_BUFFER, GL_COPY_WRITE_BUFFER, (GLintptr)oldRegionOffset, (GLintptr)getRegionOffset(), (GLsizeiptr)head);
+        }
+        glDeleteBuffers(1, &oldBuffer);
+        
+        for (GLsync &fence : fences) {
+            if (fence) {
+                glDeleteSync(fence);
+                fence = nullptr;
+            }
+        }
+    }
+    
+    if (persistent) {
+        mapping = storage + getRegionOffset();
+    } else {
+        mapRegion(head);
+    }
+    
+    if (textureID) {
+        glBindTexture(GL_TEXTURE_BUFFER, textureID);
+        glTexBuffer(GL_TEXTURE_BUFFER, textureFormat, bufferID);
+    }
+}
+
+void StreamBuffer::mapRegion(size_t from) {
+    glBindBuffer(target, bufferID);
+    
+    // Nothing reads the region past the data of the frame, which the fence of the region makes safe to write unsynchronized.
+    GLbitfield flags = GL_MAP_WRITE_BIT | GL_MAP_INVALIDATE_RANGE_BIT | GL_MAP_UNSYNCHRONIZED_BIT | GL_MAP_FLUSH_EXPLICIT_BIT;
+    uint8_t *p = (uint8_t *)glMapBufferRange(target, (GLintptr)(getRegionOffset() + from), (GLsizeiptr)(regionSize - from), flags);
+    mapping = p - from;
+    mappedFrom = from;
+}
+
+void StreamBuffer::beginFrame() {
+    flush();
+    
+    region = (region + 1) % regionCount;
+    head = 0;
+    
+    if (GLsync fence = fences[region]) {
+        while (glClientWaitSync(fence, GL_SYNC_FLUSH_COMMANDS_BIT, 1000000000) == GL_TIMEOUT_EXPIRED) {  }
+        glDeleteSync(fence);
+        fences[region] = nullptr;
+    }
+    
+    if (persistent) {
+        mapping = storage + getRegionOffset();
+    } else {
+        mapRegion(0);
+    }
+}
+
+void *StreamBuffer::allocate(size_t size, size_t alignment, size_t &offset) {
+    alignment = std::max(alignment, minAlignment);
+    offset = (head + alignment - 1) / alignment * alignment;
+    
+    if (offset + size > regionSize) {
+        resize(std::max(regionSize * 2, (offset + size + minAlignment - 1) / minAlignment * minAlignment));
+    } else if (!mapping) {
+        mapRegion(offset);
+    }
+    
+    head = offset + size;
+    return mapping + offset;
+}
+
+void StreamBuffer::flush() {
+    if (persistent || !mapping) {
+        return; // the persistent mapping is coherent
+    }
+    
+    glBindBuffer(target, bufferID);
+    if (head > mappedFrom) {
+        glFlushMappedBufferRange(target, 0, (GLsizeiptr)(head - mappedFrom));
+    }
+    glUnmapBuffer(target);
+    mapping = nullptr;
+}
+
+void StreamBuffer::endFrame() {
+    flush();
+    fences[region] = glFenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+}
@@ -0,0 +1,161 @@
+//
+// => gcore/graphics/render_queue.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+
+#include <gcore/graphics/render_queue.h>
+
+#include <algorithm>
+#include <cstring>
+
+using namespace gcore;
+
+uint64_t RenderQueue::makeKey(const RenderItem &item, float depth) {
+    uint64_t program = item.program ? item.program->getProgramID() & ((1u << ProgramBits) - 1) : 0;
+    uint64_t texture = item.texture & ((1u << TextureBits) - 1);
+    uint64_t vertexArray = item.vao ? item.vao->getID() & ((1u << VertexArrayBits) - 1) : 0;
+    
+    // The bits of a non-negative float grow with its value, and the sign bit is 0.
+    uint32_t depthBits;
+    depth = std::max(depth, 0.0f);
+    memcpy(&depthBits, &depth, sizeof(depthBits));
+    depthBits >>= 31 - DepthBits;
+    
+    return (program << (TextureBits + VertexArrayBits + DepthBits)) | (texture << (VertexArrayBits + DepthBits)) | (vertexArray << DepthBits) | depthBits;
+}
+
+void RenderQueue::clear() {
+    items.clear();
+    keys.clear();
+}
+
+void RenderQueue::add(const RenderItem &item, float depth) {
+    items.push_back(item);
+    keys.push_back(makeKey(item, depth));
+}
+
+void RenderQueue::sort() {
+    uint32_t count = (uint32_t)items.size();
+    order.resize(count);
+    orderScratch.resize(count);
+    sortedKeys.resize(count);
+    keyScratch.resize(count);
+    for (uint32_t i = 0; i < count; i++) {
+        order[i] = i;
+    }
+    if (count < 2) {
+        return;
+    }
+    
+    // The histograms of all the bytes are counted in a single pass over the keys.
+    uint32_t histograms[8][256] = {  };
+    for (uint64_t key : keys) {
+        for (uint32_t b = 0; b < 8; b++) {
+            histograms[b][(key >> (b * 8)) & 0xFF]++;
+        }
+    }
+    
+    // The keys stay aligned with the items, so the first pass reads them and the others ping-pong between the scratch buffers.
+    const uint64_t *srcKeys = keys.data();
+    uint64_t *dstKeys = sortedKeys.data();
+    uint64_t *otherKeys = keyScratch.data();
+    uint32_t *src = order.data();
+    uint32_t *dst = orderScratch.data();
+    
+    for (uint32_t b = 0; b < 8; b++) {
+        uint32_t *histogram = histograms[b];
+        uint32_t shift = b * 8;
+        if (histogram[(srcKeys[0] >> shift) & 0xFF] == count) {
+            continue; // all the keys share this byte
+        }
+        
+        uint32_t offset = 0;
+        for (uint32_t digit = 0; digit < 256; digit++) {
+            uint32_t digitCount = histogram[digit];
+            histogram[digit] = offset;
+            offset += digitCount;
+        }
+        
+        for (uint32_t i = 0; i < count; i++) {
+            uint32_t position = histogram[(srcKeys[i] >> shift) & 0xFF]++;
+            dstKeys[position] = srcKeys[i];
+            dst[position] = src[i];
+        }
+        
+        srcKeys = dstKeys;
+        std::swap(dstKeys, otherKeys);
+        std::swap(src, dst);
+    }
+    
+    if (src != order.data()) {
+        order.swap(orderScratch);
+    }
+}
+
+void RenderQueue::submit() {
+    sort();
+    
+    stats = RenderQueueStats();
+    stats.itemCount = (uint32_t)items.size();
+    
+    const ShaderProgram *program = nullptr;
+    const VertexArrayObject *vao = nullptr;
+    GLuint texture = 0;
+    bool textureBound = false;
+    
+    glActiveTexture(GL_TEXTURE0);
+    
+    for (uint32_t i : order) {
+        const RenderItem &item = items[i];
+        
+        if (item.program != program) {
+            item.program->use();
+            program = item.program;
+            stats.programChanges++;
+        }
+        if (!textureBound || item.texture != texture) {
+            glBindTexture(GL_TEXTURE_2D, item.texture);
+            texture = item.texture;
+            textureBound = true;
+            stats.textureChanges++;
+        }
+        if (item.vao != vao) {
+            item.vao->bind();
+            vao = item.vao;
+            stats.vertexArrayChanges++;
+        }
+        
+        if (item.setUniforms) {
+            item.setUniforms(item);
+        }
+        
+        if (item.instanceCount > 0) {
+            item.vao->drawTrianglesInstanced(item.instanceCount);
+        } else {
+            item.vao->drawTriangles();
+        }
+        stats.drawCalls++;
+    }
+}
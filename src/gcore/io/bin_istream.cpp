@@ -25,5 +25,417 @@
 //
 
 #include <gcore/io/bin_istream.h>
+#include <gcore/io/byte_order.h>
+
+#include <chrono>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+
+#include <sys/types.h>
+#include <sys/stat.h>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#endif
 
 using namespace gcore;
+
+typedef std::chrono::steady_clock stall_clock;
+
+static inline double secondsSince(stall_clock::time_point start) {
+    return std::chrono::duration<double>(stall_clock::now() - start).count();
+}
+
+namespace gcore {
+    
+    /*!
+     \brief Background reader that fills a ring of buffers from a C file pointer ahead of the consumer.
+     */
+    class BinaryInputPrefetcher {
+        
+        struct Slot {
+            byte_t *data;
+            size_t length = 0;
+            bool filled = false;
+            bool last = false;
+        };
+        
+        FILE *fp;
+        
+        size_t slotSize;
+        uint32_t slotCount;
+        Slot *slots;
+        
+        /*!
+         \brief The slot the consumer is copying from, and the offset of the next byte to copy in it.
+         */
+        uint32_t readSlot = 0;
+        size_t readOffset = 0;
+        
+        bool finished = false;
+        bool stopping = false;
+        
+        std::mutex mutex;
+        std::condition_variable slotFilled;
+        std::condition_variable slotFreed;
+        
+        std::thread worker;
+        
+        void run() {
+            uint32_t writeSlot = 0;
+            
+            while (true) {
+                Slot &slot = slots[writeSlot];
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    slotFreed.wait(lock, [&]{ return stopping || !slot.filled; });
+                    if (stopping) {
+                        return;
+                    }
+                }
+                
+                size_t length = fread(slot.data, sizeof(byte_t), slotSize, fp);
+                bool last = length < slotSize;
+                
+                {
+                    std::lock_guard<std::mutex> lock(mutex);
+                    slot.length = length;
+                    slot.last = last;
+                    slot.filled = true;
+                }
+                slotFilled.notify_one();
+                
+                if (last) {
+                    return;
+                }
+                writeSlot = (writeSlot + 1) % slotCount;
+            }
+        }
+        
+    public:
+        BinaryInputPrefetcher(FILE *fp, size_t slotSize, uint32_t slotCount) : fp(fp), slotSize(slotSize), slotCount(slotCount) {
+            slots = new Slot[slotCount];
+            for (uint32_t i = 0; i < slotCount; i++) {
+                slots[i].data = new byte_t[slotSize];
+            }
+            worker = std::thread(&BinaryInputPrefetcher::run, this);
+        }
+        
+        ~BinaryInputPrefetcher() {
+            {
+                std::lock_guard<std::mutex> lock(mutex);
+                stopping = true;
+            }
+            slotFreed.notify_one();
+            worker.join();
+            
+            for (uint32_t i = 0; i < slotCount; i++) {
+                delete[] slots[i].data;
+            }
+            delete[] slots;
+        }
+        
+        /*!
+         \brief Returns the number of buffers in the ring.
+         */
+        inline uint32_t getBufferCount() const {
+            return slotCount;
+        }
+        
+        /*!
+         \brief Returns whether the consumer has drained every byte of the source.
+         */
+        inline bool eof() const {
+            return finished;
+        }
+        
+        /*!
+         \brief Copies up to \c bytes bytes from the ring into \c dst , waiting for the background thread if no filled buffer is ready.
+         \return The number of bytes copied, which is less than \c bytes only if the source ran out of bytes.
+         */
+        size_t fetch(byte_t *dst, size_t bytes, double &stallTime) {
+            size_t copied = 0;
+            
+            while (copied < bytes && !finished) {
+                Slot &slot = slots[readSlot];
+                
+                {
+                    std::unique_lock<std::mutex> lock(mutex);
+                    if (!slot.filled) {
+                        stall_clock::time_point start = stall_clock::now();
+                        slotFilled.wait(lock, [&]{ return slot.filled; });
+                        stallTime += secondsSince(start);
+                    }
+                }
+                
+                size_t chunk = slot.length - readOffset;
+                if (chunk > bytes - copied) {
+                    chunk = bytes - copied;
+                }
+                memcpy(dst + copied, slot.data + readOffset, chunk);
+                copied += chunk;
+                readOffset += chunk;
+                
+                if (readOffset == slot.length) {
+                    if (slot.last) {
+                        finished = true;
+                        break;
+                    }
+                    
+                    {
+                        std::lock_guard<std::mutex> lock(mutex);
+                        slot.filled = false;
+                    }
+                    slotFreed.notify_one();
+                    
+                    readSlot = (readSlot + 1) % slotCount;
+                    readOffset = 0;
+                }
+            }
+            
+            return copied;
+        }
+        
+    };
+    
+}
+
+BinaryInputStream::BinaryInputStream(const char *filename, const BinaryInputStreamOptions &options) {
+    if (options.mode == BinaryInputStreamMapped && map(filename)) {
+        return;
+    }
+    
+    // Buffered or prefetched stream, or fallback if the file could not be mapped.
+    if (!(fp = fopen(filename, "rb"))) {
+        return;
+    }
+    
+    bufSize = options.bufferSize > 0 ? options.bufferSize : MAX_BUFF_SIZE;
+    buf = bufptr = new byte_t[bufSize];
+    sourceSize = fileSize(fp);
+    
+    if (options.mode == BinaryInputStreamPrefetched) {
+        setvbuf(fp, nullptr, _IONBF, 0); // the ring buffers are filled straight from the file
+        
+        mode = BinaryInputStreamPrefetched;
+        prefetcher = new BinaryInputPrefetcher(fp, bufSize, options.bufferCount > 1 ? options.bufferCount : 2);
+    }
+}
+
+BinaryInputStream::~BinaryInputStream() {
+    if (mode == BinaryInputStreamMapped) {
+        unmap();
+        return;
+    }
+    
+    if (prefetcher) {
+        delete prefetcher;
+    }
+    if (fp) {
+        fclose(fp);
+    }
+    if (buf) {
+        delete[] buf;
+    }
+}
+
+uint64_t BinaryInputStream::fileSize(FILE *fp) {
+#ifdef _WIN32
+    struct _stat64 st;
+    if (_fstat64(_fileno(fp), &st) == 0 && (st.st_mode & _S_IFREG)) {
+        return (uint64_t)st.st_size;
+    }
+#else
+    struct stat st;
+    if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode)) {
+        return (uint64_t)st.st_size;
+    }
+#endif
+    return UINT64_MAX;
+}
+
+bool BinaryInputStream::map(const char *filename) {
+#ifdef _WIN32
+    return false;
+#else
+    int fd = open(filename, O_RDONLY);
+    if (fd < 0) {
+        return false;
+    }
+    
+    struct stat st;
+    if (fstat(fd, &st) < 0 || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+    
+    void *mapping = mmap(nullptr, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd); // the mapping keeps its own reference to the file
+    
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    
+    madvise(mapping, (size_t)st.st_size, MADV_SEQUENTIAL);
+    
+    mode = BinaryInputStreamMapped;
+    sourceSize = bufSize = (size_t)st.st_size;
+    buf = bufptr = (byte_t *)mapping;
+    leftBytes = bufSize;
+    return true;
+#endif
+}
+
+void BinaryInputStream::unmap() {
+#ifndef _WIN32
+    if (buf && !borrowed) {
+        munmap(buf, bufSize);
+    }
+#endif
+    buf = bufptr = nullptr;
+    leftBytes = bufSize = 0;
+}
+
+void BinaryInputStream::setFailed() {
+    failed = true;
+    bufptr += leftBytes;
+    leftBytes = 0;
+}
+
+void BinaryInputStream::load() {
+    if (mode == BinaryInputStreamMapped || failed) {
+        return;
+    }
+    
+    bufOffset += bufptr - buf;
+    
+    if (leftBytes > 0) {
+        memmove(buf, bufptr, sizeof(byte_t) * leftBytes);
+    }
+    
+    if (prefetcher) {
+        leftBytes += prefetcher->fetch(buf + leftBytes, bufSize - leftBytes, stallTime);
+    } else {
+        stall_clock::time_point start = stall_clock::now();
+        leftBytes += fread(buf + leftBytes, sizeof(byte_t), bufSize - leftBytes, fp);
+        stallTime += secondsSince(start);
+    }
+    bufptr = buf;
+}
+
+bool BinaryInputStream::seek(uint64_t offset) {
+    uint64_t end = tell() + leftBytes;
+    
+    if (offset >= bufOffset && offset <= end) {
+        bufptr = buf + (offset - bufOffset);
+        leftBytes = (size_t)(end - offset);
+        return true;
+    }
+    
+    if (mode == BinaryInputStreamMapped || !fp) {
+        setFailed();
+        return false;
+    }
+    
+    uint32_t prefetchBuffers = 0;
+    if (prefetcher) {
+        prefetchBuffers = prefetcher->getBufferCount();
+        delete prefetcher;
+        prefetcher = nullptr;
+    }
+    
+#ifdef _WIN32
+    bool moved = _fseeki64(fp, (__int64)offset, SEEK_SET) == 0;
+#else
+    bool moved = fseeko(fp, (off_t)offset, SEEK_SET) == 0;
+#endif
+    
+    if (prefetchBuffers) {
+        prefetcher = new BinaryInputPrefetcher(fp, bufSize, prefetchBuffers);
+    }
+    
+    if (!moved) {
+        setFailed();
+        return false;
+    }
+    
+    bufOffset = offset;
+    bufptr = buf;
+    leftBytes = 0;
+    return true;
+}
+
+size_t BinaryInputStream::readBytes(void *dst, size_t bytes) {
+    byte_t *out = (byte_t *)dst;
+    size_t copied = 0;
+    
+    while (copied < bytes) {
+        if (!leftBytes) {
+            load();
+            if (!leftBytes) {
+                setFailed(); // the source ran out of bytes
+                break;
+            }
+        }
+        
+        size_t chunk = leftBytes < bytes - copied ? leftBytes : bytes - copied;
+        memcpy(out + copied, bufptr, chunk);
+        
+        bufptr += chunk;
+        leftBytes -= chunk;
+        copied += chunk;
+    }
+    
+    return copied;
+}
+
+bool BinaryInputStream::eof() const {
+    if (mode == BinaryInputStreamMapped) {
+        return !leftBytes;
+    }
+    if (prefetcher) {
+        return prefetcher->eof() && !leftBytes;
+    }
+    return feof(fp) && !leftBytes;
+}
+
+void BinaryInputStream::readArray(void *dst, size_t count, size_t wordSize) {
+    byte_t *out = (byte_t *)dst;
+    
+    while (count > 0) {
+        size_t available = leftBytes / wordSize;
+        if (!available) {
+            load();
+            if (!(available = leftBytes / wordSize)) {
+                memset(out, 0, count * wordSize); // the source ran out of bytes
+                setFailed();
+                return;
+            }
+        }
+        
+        size_t chunk = available < count ? available : count;
+        size_t chunkBytes = chunk * wordSize;
+        
+        if (wordSize == 4) {
+            bigEndianToHost32(out, bufptr, chunk);
+        } else {
+            bigEndianToHost16(out, bufptr, chunk);
+        }
+        
+        bufptr += chunkBytes;
+        leftBytes -= chunkBytes;
+        out += chunkBytes;
+        count -= chunk;
+    }
+}
+
+void BinaryInputStream::readInt16Array(uint16_t *dst, size_t count) {
+    readArray(dst, count, 2);
+}
+
+void BinaryInputStream::readInt32Array(uint32_t *dst, size_t count) {
+    readArray(dst, count, 4);
+}
@@ -0,0 +1,281 @@
+//
+// => gcore/io/bin_ostream.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <gcore/io/bin_ostream.h>
+#include <gcore/io/byte_order.h>
+
+#ifndef _WIN32
+#include <sys/mman.h>
+#include <sys/uio.h>
+#include <unistd.h>
+#endif
+
+using namespace gcore;
+
+#ifndef _WIN32
+/*!
+ \brief Writes all the given buffers to the file descriptor, retrying on partial writes.
+ \return \c true if every byte has been written, \c false otherwise.
+ */
+static bool writevAll(int fd, struct iovec *iov, int iovcnt) {
+    while (iovcnt > 0) {
+        ssize_t written = writev(fd, iov, iovcnt);
+        if (written < 0) {
+            return false;
+        }
+        
+        while (iovcnt > 0 && (size_t)written >= iov->iov_len) {
+            written -= iov->iov_len;
+            iov++;
+            iovcnt--;
+        }
+        if (iovcnt > 0) {
+            iov->iov_base = (byte_t *)iov->iov_base + written;
+            iov->iov_len -= written;
+        }
+    }
+    return true;
+}
+#endif
+
+BinaryOutputStream::BinaryOutputStream(const char *filename, const BinaryOutputStreamOptions &options) {
+    // A shared writable mapping needs the file to be open for reading as well.
+    if (!(fp = fopen(filename, options.mode == BinaryOutputStreamMapped ? "w+b" : "wb"))) {
+        return;
+    }
+    
+    bufSize = options.bufferSize > 0 ? options.bufferSize : MAX_WRITE_BUFF_SIZE;
+    
+    if (options.mode == BinaryOutputStreamMapped && map(bufSize)) {
+        return;
+    }
+    
+#ifndef _WIN32
+    if (options.mode == BinaryOutputStreamVectored) {
+        mode = BinaryOutputStreamVectored;
+    }
+#endif
+    
+    setvbuf(fp, nullptr, _IONBF, 0); // the stream has its own buffer
+    
+    buf = bufptr = new byte_t[bufSize];
+    freeBytes = bufSize;
+}
+
+bool BinaryOutputStream::map(size_t size) {
+#ifdef _WIN32
+    return false;
+#else
+    int fd = fileno(fp);
+    if (ftruncate(fd, (off_t)size) < 0) {
+        return false;
+    }
+    
+    void *mapping = mmap(nullptr, size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (mapping == MAP_FAILED) {
+        return false;
+    }
+    
+    size_t used = bufptr - buf;
+    
+    mode = BinaryOutputStreamMapped;
+    bufSize = size;
+    buf = (byte_t *)mapping;
+    bufptr = buf + used;
+    freeBytes = bufSize - used;
+    return true;
+#endif
+}
+
+void BinaryOutputStream::reserve(size_t bytes) {
+    if (mode != BinaryOutputStreamMapped) {
+        flush();
+        return;
+    }
+    
+#ifndef _WIN32
+    size_t used = bufptr - buf;
+    size_t newSize = bufSize + (bytes > bufSize ? bytes : bufSize); // grow geometrically
+    
+    munmap(buf, bufSize);
+    buf = bufptr = nullptr;
+    
+    if (!map(newSize)) {
+        // Nothing more can be written: keep the stream in a consistent (failed) state.
+        failed = true;
+        fclose(fp);
+        fp = nullptr;
+        bufSize = freeBytes = 0;
+        flushedBytes += used;
+        return;
+    }
+    bufptr = buf + used;
+    freeBytes = bufSize - used;
+#endif
+}
+
+void BinaryOutputStream::flush() {
+    if (mode == BinaryOutputStreamMapped || !buf) {
+        return;
+    }
+    
+    size_t pending = bufptr - buf;
+    if (!pending) {
+        return;
+    }
+    
+#ifndef _WIN32
+    if (mode == BinaryOutputStreamVectored) {
+        struct iovec iov = { buf, pending };
+        failed |= !writevAll(fileno(fp), &iov, 1);
+    } else
+#endif
+    {
+        failed |= fwrite(buf, sizeof(byte_t), pending, fp) != pending;
+    }
+    
+    flushedBytes += pending;
+    bufptr = buf;
+    freeBytes = bufSize;
+}
+
+bool BinaryOutputStream::close() {
+    if (!fp) {
+        return !failed;
+    }
+    
+    if (mode == BinaryOutputStreamMapped) {
+#ifndef _WIN32
+        size_t used = bufptr - buf;
+        munmap(buf, bufSize);
+        failed |= ftruncate(fileno(fp), (off_t)used) < 0;
+        flushedBytes += used;
+#endif
+    } else {
+        flush();
+        delete[] buf;
+    }
+    
+    failed |= fclose(fp) != 0;
+    fp = nullptr;
+    buf = bufptr = nullptr;
+    bufSize = freeBytes = 0;
+    
+    return !failed;
+}
+
+void BinaryOutputStream::write(const void *data, size_t bytes) {
+    if (bytes <= freeBytes) {
+        memcpy(bufptr, data, bytes);
+        bufptr += bytes;
+        freeBytes -= bytes;
+        return;
+    }
+    
+    if (!buf) {
+        return;
+    }
+    
+    if (mode == BinaryOutputStreamMapped) {
+        reserve(bytes);
+        if (bytes <= freeBytes) {
+            write(data, bytes);
+        }
+        return;
+    }
+    
+    if (bytes < bufSize) {
+        flush();
+        write(data, bytes);
+        return;
+    }
+    
+    // The block is larger than the buffer: write it from the caller memory without copying.
+    size_t pending = bufptr - buf;
+    
+#ifndef _WIN32
+    if (mode == BinaryOutputStreamVectored) {
+        struct iovec iov[2] = { { buf, pending }, { (void *)data, bytes } };
+        failed |= !writevAll(fileno(fp), pending ? iov : iov + 1, pending ? 2 : 1);
+        
+        flushedBytes += pending + bytes;
+        bufptr = buf;
+        freeBytes = bufSize;
+        return;
+    }
+#endif
+    
+    flush();
+    failed |= fwrite(data, sizeof(byte_t), bytes, fp) != bytes;
+    flushedBytes += bytes;
+}
+
+void BinaryOutputStream::align(size_t alignment) {
+    static const byte_t zeros[64] = { 0 };
+    
+    size_t padding = (size_t)((alignment - tell() % alignment) % alignment);
+    while (padding > 0) {
+        size_t chunk = padding < sizeof(zeros) ? padding : sizeof(zeros);
+        write(zeros, chunk);
+        padding -= chunk;
+    }
+}
+
+void BinaryOutputStream::writeArray(const void *src, size_t count, size_t wordSize) {
+    const byte_t *in = (const byte_t *)src;
+    
+    while (count > 0) {
+        if (freeBytes < wordSize) {
+            reserve(mode == BinaryOutputStreamMapped ? count * wordSize : wordSize);
+            if (freeBytes < wordSize) {
+                return; // the stream failed
+            }
+        }
+        
+        size_t available = freeBytes / wordSize;
+        size_t chunk = available < count ? available : count;
+        size_t chunkBytes = chunk * wordSize;
+        
+        if (wordSize == 4) {
+            hostToBigEndian32(bufptr, in, chunk);
+        } else {
+            hostToBigEndian16(bufptr, in, chunk);
+        }
+        
+        bufptr += chunkBytes;
+        freeBytes -= chunkBytes;
+        in += chunkBytes;
+        count -= chunk;
+    }
+}
+
+void BinaryOutputStream::writeInt16Array(const uint16_t *src, size_t count) {
+    writeArray(src, count, 2);
+}
+
+void BinaryOutputStream::writeInt32Array(const uint32_t *src, size_t count) {
+    writeArray(src, count, 4);
+}
@@ -0,0 +1,120 @@
+//
+// => gcore/io/byte_order.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <gcore/io/byte_order.h>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#elif defined(__SSSE3__)
+#include <tmmintrin.h>
+#elif defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GCORE_BYTE_ORDER_SSE2
+#elif defined(__ARM_NEON)
+#include <arm_neon.h>
+#endif
+
+using namespace gcore;
+
+void gcore::swapBytes16(void *dst, const void *src, size_t count) {
+    uint8_t *out = (uint8_t *)dst;
+    const uint8_t *in = (const uint8_t *)src;
+    size_t i = 0;
+    
+#if defined(__AVX2__)
+    const __m256i mask = _mm256_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14,
+                                          1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    for (; i + 16 <= count; i += 16) {
+        __m256i x = _mm256_loadu_si256((const __m256i *)(in + i * 2));
+        _mm256_storeu_si256((__m256i *)(out + i * 2), _mm256_shuffle_epi8(x, mask));
+    }
+#elif defined(__SSSE3__)
+    const __m128i mask = _mm_setr_epi8(1, 0, 3, 2, 5, 4, 7, 6, 9, 8, 11, 10, 13, 12, 15, 14);
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i * 2));
+        _mm_storeu_si128((__m128i *)(out + i * 2), _mm_shuffle_epi8(x, mask));
+    }
+#elif defined(GCORE_BYTE_ORDER_SSE2)
+    for (; i + 8 <= count; i += 8) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i * 2));
+        x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8));
+        _mm_storeu_si128((__m128i *)(out + i * 2), x);
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 8 <= count; i += 8) {
+        vst1q_u8(out + i * 2, vrev16q_u8(vld1q_u8(in + i * 2)));
+    }
+#endif
+    
+    for (; i < count; i++) {
+        uint16_t x;
+        memcpy(&x, in + i * 2, 2);
+        x = byteSwap16(x);
+        memcpy(out + i * 2, &x, 2);
+    }
+}
+
+void gcore::swapBytes32(void *dst, const void *src, size_t count) {
+    uint8_t *out = (uint8_t *)dst;
+    const uint8_t *in = (const uint8_t *)src;
+    size_t i = 0;
+    
+#if defined(__AVX2__)
+    const __m256i mask = _mm256_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12,
+                                          3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    for (; i + 16 <= count; i += 16) {
+        __m256i x0 = _mm256_loadu_si256((const __m256i *)(in + i * 4));
+        __m256i x1 = _mm256_loadu_si256((const __m256i *)(in + i * 4 + 32));
+        _mm256_storeu_si256((__m256i *)(out + i * 4), _mm256_shuffle_epi8(x0, mask));
+        _mm256_storeu_si256((__m256i *)(out + i * 4 + 32), _mm256_shuffle_epi8(x1, mask));
+    }
+#elif defined(__SSSE3__)
+    const __m128i mask = _mm_setr_epi8(3, 2, 1, 0, 7, 6, 5, 4, 11, 10, 9, 8, 15, 14, 13, 12);
+    for (; i + 4 <= count; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i * 4));
+        _mm_storeu_si128((__m128i *)(out + i * 4), _mm_shuffle_epi8(x, mask));
+    }
+#elif defined(GCORE_BYTE_ORDER_SSE2)
+    for (; i + 4 <= count; i += 4) {
+        __m128i x = _mm_loadu_si128((const __m128i *)(in + i * 4));
+        x = _mm_or_si128(_mm_slli_epi16(x, 8), _mm_srli_epi16(x, 8)); // swap the bytes of each half
+        x = _mm_shufflelo_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));          // then swap the halves
+        x = _mm_shufflehi_epi16(x, _MM_SHUFFLE(2, 3, 0, 1));
+        _mm_storeu_si128((__m128i *)(out + i * 4), x);
+    }
+#elif defined(__ARM_NEON)
+    for (; i + 4 <= count; i += 4) {
+        vst1q_u8(out + i * 4, vrev32q_u8(vld1q_u8(in + i * 4)));
+    }
+#endif
+    
+    for (; i < count; i++) {
+        uint32_t x;
+        memcpy(&x, in + i * 4, 4);
+        x = byteSwap32(x);
+        memcpy(out + i * 4, &x, 4);
+    }
+}
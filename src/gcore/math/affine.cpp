@@ -0,0 +1,237 @@
+//
+// => gcore/math/affine.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <gcore/math/affine.h>
+#include <gcore/math/simd_lanes.h>
+
+#if defined(__SSE2__) || defined(_M_X64)
+#include <emmintrin.h>
+#define GCORE_AFFINE_SSE
+#elif defined(__ARM_NEON) && defined(__aarch64__)
+#include <arm_neon.h>
+#define GCORE_AFFINE_NEON
+#endif
+
+using namespace gcore;
+
+glm::mat3 gcore::quaternionToMat3(const glm::quat &q) {
+    float xx = q.x * q.x, yy = q.y * q.y, zz = q.z * q.z;
+    float xy = q.x * q.y, xz = q.x * q.z, yz = q.y * q.z;
+    float wx = q.w * q.x, wy = q.w * q.y, wz = q.w * q.z;
+    
+    glm::mat3 m;
+    m[0][0] = 1.0f - 2.0f * (yy + zz);
+    m[0][1] = 2.0f * (xy + wz);
+    m[0][2] = 2.0f * (xz - wy);
+    
+    m[1][0] = 2.0f * (xy - wz);
+    m[1][1] = 1.0f - 2.0f * (xx + zz);
+    m[1][2] = 2.0f * (yz + wx);
+    
+    m[2][0] = 2.0f * (xz + wy);
+    m[2][1] = 2.0f * (yz - wx);
+    m[2][2] = 1.0f - 2.0f * (xx + yy);
+    return m;
+}
+
+void gcore::affineFromMat4(const glm::mat4 &m, Affine3x4 &out) {
+    for (int r = 0; r < 3; r++) {
+        for (int c = 0; c < 4; c++) {
+            out.rows[r][c] = m[c][r];
+        }
+    }
+}
+
+glm::mat4 gcore::affineToMat4(const Affine3x4 &a) {
+    glm::mat4 m;
+    for (int c = 0; c < 4; c++) {
+        m[c][0] = a.rows[0][c];
+        m[c][1] = a.rows[1][c];
+        m[c][2] = a.rows[2][c];
+        m[c][3] = c == 3 ? 1.0f : 0.0f;
+    }
+    return m;
+}
+
+void gcore::composeTRS(const glm::vec3 &translation, const glm::quat &rotation, const glm::vec3 &scale, Affine3x4 &out) {
+    glm::mat3 r = quaternionToMat3(rotation);
+    for (int i = 0; i < 3; i++) {
+        out.rows[i][0] = r[0][i] * scale.x;
+        out.rows[i][1] = r[1][i] * scale.y;
+        out.rows[i][2] = r[2][i] * scale.z;
+        out.rows[i][3] = translation[i];
+    }
+}
+
+void gcore::multiplyAffine(const Affine3x4 &a, const Affine3x4 &b, Affine3x4 &out) {
+#if defined(GCORE_AFFINE_SSE)
+    // Each row of the product combines the rows of b by the coefficients of a row of a, whose translation only adds to the last lane.
+    const __m128 wMask = _mm_castsi128_ps(_mm_set_epi32(-1, 0, 0, 0));
+    __m128 b0 = _mm_loadu_ps(b.rows[0]), b1 = _mm_loadu_ps(b.rows[1]), b2 = _mm_loadu_ps(b.rows[2]);
+    __m128 r[3];
+    for (int i = 0; i < 3; i++) {
+        __m128 ai = _mm_loadu_ps(a.rows[i]);
+        __m128 x = _mm_mul_ps(_mm_shuffle_ps(ai, ai, _MM_SHUFFLE(0, 0, 0, 0)), b0);
+        x = _mm_add_ps(x, _mm_mul_ps(_mm_shuffle_ps(ai, ai, _MM_SHUFFLE(1, 1, 1, 1)), b1));
+        x = _mm_add_ps(x, _mm_mul_ps(_mm_shuffle_ps(ai, ai, _MM_SHUFFLE(2, 2, 2, 2)), b2));
+        r[i] = _mm_add_ps(x, _mm_and_ps(ai, wMask));
+    }
+    _mm_storeu_ps(out.rows[0], r[0]);
+    _mm_storeu_ps(out.rows[1], r[1]);
+    _mm_storeu_ps(out.rows[2], r[2]);
+#elif defined(GCORE_AFFINE_NEON)
+    static const uint32_t wBits[4] = { 0, 0, 0, 0xFFFFFFFF };
+    const uint32x4_t wMask = vld1q_u32(wBits);
+    float32x4_t b0 = vld1q_f32(b.rows[0]), b1 = vld1q_f32(b.rows[1]), b2 = vld1q_f32(b.rows[2]);
+    float32x4_t r[3];
+    for (int i = 0; i < 3; i++) {
+        float32x4_t ai = vld1q_f32(a.rows[i]);
+        float32x4_t x = vmulq_laneq_f32(b0, ai, 0);
+        x = vfmaq_laneq_f32(x, b1, ai, 1);
+        x = vfmaq_laneq_f32(x, b2, ai, 2);
+        r[i] = vaddq_f32(x, vreinterpretq_f32_u32(vandq_u32(vreinterpretq_u32_f32(ai), wMask)));
+    }
+    vst1q_f32(out.rows[0], r[0]);
+    vst1q_f32(out.rows[1], r[1]);
+    vst1q_f32(out.rows[2], r[2]);
+#else
+    Affine3x4 r;
+    for (int i = 0; i < 3; i++) {
+        for (int j = 0; j < 4; j++) {
+            r.rows[i][j] = a.rows[i][0] * b.rows[0][j] + a.rows[i][1] * b.rows[1][j] + a.rows[i][2] * b.rows[2][j];
+        }
+        r.rows[i][3] += a.rows[i][3];
+    }
+    out = r;
+#endif
+}
+
+void gcore::composeTRSBatch(const float *components, uint32_t stride, const float *weights, uint32_t count, Affine3x4 *out) {
+    const float *tx = components, *ty = tx + stride, *tz = ty + stride;
+    const float *qx = tz + stride, *qy = qx + stride, *qz = qy + stride, *qw = qz + stride;
+    const float *sx = qw + stride, *sy = sx + stride, *sz = sy + stride;
+    
+    const Lanes one = lanesSet(1.0f), two = lanesSet(2.0f);
+    float rows[12][GCORE_LANE_COUNT];
+    
+    for (uint32_t i = 0; i < count; i += GCORE_LANE_COUNT) {
+        Lanes x = lanesLoad(qx + i), y = lanesLoad(qy + i), z = lanesLoad(qz + i), w = lanesLoad(qw + i);
+        Lanes x2 = lanesMul(x, two), y2 = lanesMul(y, two), z2 = lanesMul(z, two);
+        Lanes xx = lanesMul(x, x2), yy = lanesMul(y, y2), zz = lanesMul(z, z2);
+        Lanes xy = lanesMul(x, y2), xz = lanesMul(x, z2), yz = lanesMul(y, z2);
+        Lanes wx = lanesMul(w, x2), wy = lanesMul(w, y2), wz = lanesMul(w, z2);
+        Lanes scaleX = lanesLoad(sx + i), scaleY = lanesLoad(sy + i), scaleZ = lanesLoad(sz + i);
+        
+        lanesStore(rows[0], lanesMul(lanesSub(one, lanesAdd(yy, zz)), scaleX));
+        lanesStore(rows[1], lanesMul(lanesSub(xy, wz), scaleY));
+        lanesStore(rows[2], lanesMul(lanesAdd(xz, wy), scaleZ));
+        lanesStore(rows[3], lanesLoad(tx + i));
+        
+        lanesStore(rows[4], lanesMul(lanesAdd(xy, wz), scaleX));
+        lanesStore(rows[5], lanesMul(lanesSub(one, lanesAdd(xx, zz)), scaleY));
+        lanesStore(rows[6], lanesMul(lanesSub(yz, wx), scaleZ));
+        lanesStore(rows[7], lanesLoad(ty + i));
+        
+        lanesStore(rows[8], lanesMul(lanesSub(xz, wy), scaleX));
+        lanesStore(rows[9], lanesMul(lanesAdd(yz, wx), scaleY));
+        lanesStore(rows[10], lanesMul(lanesSub(one, lanesAdd(xx, yy)), scaleZ));
+        lanesStore(rows[11], lanesLoad(tz + i));
+        
+        // Scatter the lanes to the nodes, skipping the padding and the nodes without a transform.
+        uint32_t lanes = count - i < GCORE_LANE_COUNT ? count - i : GCORE_LANE_COUNT;
+#if defined(GCORE_AFFINE_SSE) && GCORE_LANE_COUNT >= 4
+        // Transposing four lanes of the four values of a row gives that row for four nodes.
+        for (uint32_t h = 0; h < lanes; h += 4) {
+            __m128 r[3][4];
+            for (int k = 0; k < 3; k++) {
+                __m128 c0 = _mm_loadu_ps(rows[4 * k] + h), c1 = _mm_loadu_ps(rows[4 * k + 1] + h);
+                __m128 c2 = _mm_loadu_ps(rows[4 * k + 2] + h), c3 = _mm_loadu_ps(rows[4 * k + 3] + h);
+                _MM_TRANSPOSE4_PS(c0, c1, c2, c3);
+                r[k][0] = c0; r[k][1] = c1; r[k][2] = c2; r[k][3] = c3;
+            }
+            for (uint32_t l = h; l < h + 4 && l < lanes; l++) {
+                if (weights && weights[i + l] <= 0) {
+                    continue;
+                }
+                _mm_storeu_ps(out[i + l].rows[0], r[0][l - h]);
+                _mm_storeu_ps(out[i + l].rows[1], r[1][l - h]);
+                _mm_storeu_ps(out[i + l].rows[2], r[2][l - h]);
+            }
+        }
+#else
+        for (uint32_t l = 0; l < lanes; l++) {
+            if (weights && weights[i + l] <= 0) {
+                continue;
+            }
+            float *m = &out[i + l].rows[0][0];
+            for (int k = 0; k < 12; k++) {
+                m[k] = rows[k][l];
+            }
+        }
+#endif
+    }
+}
+
+void gcore::multiplyAffineBatch(const Affine3x4 *a, const Affine3x4 *b, uint32_t count, glm::mat4 *out) {
+#if defined(GCORE_AFFINE_SSE)
+    // The rows of each product are transposed to the columns of a 4x4 matrix.
+    Affine3x4 product;
+    for (uint32_t i = 0; i < count; i++) {
+        multiplyAffine(a[i], b[i], product);
+        __m128 r0 = _mm_loadu_ps(product.rows[0]), r1 = _mm_loadu_ps(product.rows[1]), r2 = _mm_loadu_ps(product.rows[2]);
+        __m128 r3 = _mm_set_ps(1.0f, 0.0f, 0.0f, 0.0f);
+        _MM_TRANSPOSE4_PS(r0, r1, r2, r3);
+        float *m = &out[i][0][0];
+        _mm_storeu_ps(m, r0);
+        _mm_storeu_ps(m + 4, r1);
+        _mm_storeu_ps(m + 8, r2);
+        _mm_storeu_ps(m + 12, r3);
+    }
+#elif defined(GCORE_AFFINE_NEON)
+    Affine3x4 product;
+    for (uint32_t i = 0; i < count; i++) {
+        multiplyAffine(a[i], b[i], product);
+        float32x4x4_t rows;
+        rows.val[0] = vld1q_f32(product.rows[0]);
+        rows.val[1] = vld1q_f32(product.rows[1]);
+        rows.val[2] = vld1q_f32(product.rows[2]);
+        rows.val[3] = vsetq_lane_f32(1.0f, vdupq_n_f32(0.0f), 3);
+        vst4q_f32(&out[i][0][0], rows); // interleaving the rows stores the columns
+    }
+#else
+    Affine3x4 product;
+    for (uint32_t i = 0; i < count; i++) {
+        multiplyAffine(a[i], b[i], product);
+        out[i] = affineToMat4(product);
+    }
+#endif
+}
+
+void gcore::multiplyAffineBatch(const Affine3x4 *a, const Affine3x4 *b, uint32_t count, Affine3x4 *out) {
+    for (uint32_t i = 0; i < count; i++) {
+        multiplyAffine(a[i], b[i], out[i]);
+    }
+}
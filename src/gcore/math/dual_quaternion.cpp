@@ -0,0 +1,101 @@
+//
+// => gcore/math/dual_quaternion.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <gcore/math/dual_quaternion.h>
+
+#include <math.h>
+
+using namespace gcore;
+
+glm::quat gcore::affineRotation(const Affine3x4 &a) {
+    float m[3][3];
+    for (int c = 0; c < 3; c++) {
+        float length = sqrtf(a.rows[0][c] * a.rows[0][c] + a.rows[1][c] * a.rows[1][c] + a.rows[2][c] * a.rows[2][c]);
+        float inverse = length > 0 ? 1.0f / length : 0.0f;
+        for (int r = 0; r < 3; r++) {
+            m[r][c] = a.rows[r][c] * inverse;
+        }
+    }
+    
+    // Shepperd's method: the largest of the four components is found from the diagonal, then the others from it.
+    float trace = m[0][0] + m[1][1] + m[2][2];
+    float x, y, z, w;
+    if (trace > 0) {
+        float s = sqrtf(trace + 1.0f) * 2.0f, r = 1.0f / s;
+        w = 0.25f * s;
+        x = (m[2][1] - m[1][2]) * r;
+        y = (m[0][2] - m[2][0]) * r;
+        z = (m[1][0] - m[0][1]) * r;
+    } else if (m[0][0] > m[1][1] && m[0][0] > m[2][2]) {
+        float s = sqrtf(1.0f + m[0][0] - m[1][1] - m[2][2]) * 2.0f, r = 1.0f / s;
+        w = (m[2][1] - m[1][2]) * r;
+        x = 0.25f * s;
+        y = (m[0][1] + m[1][0]) * r;
+        z = (m[0][2] + m[2][0]) * r;
+    } else if (m[1][1] > m[2][2]) {
+        float s = sqrtf(1.0f + m[1][1] - m[0][0] - m[2][2]) * 2.0f, r = 1.0f / s;
+        w = (m[0][2] - m[2][0]) * r;
+        x = (m[0][1] + m[1][0]) * r;
+        y = 0.25f * s;
+        z = (m[1][2] + m[2][1]) * r;
+    } else {
+        float s = sqrtf(1.0f + m[2][2] - m[0][0] - m[1][1]) * 2.0f, r = 1.0f / s;
+        w = (m[1][0] - m[0][1]) * r;
+        x = (m[0][2] + m[2][0]) * r;
+        y = (m[1][2] + m[2][1]) * r;
+        z = 0.25f * s;
+    }
+    
+    float inverse = 1.0f / sqrtf(x * x + y * y + z * z + w * w);
+    return glm::quat(w * inverse, x * inverse, y * inverse, z * inverse);
+}
+
+void gcore::affineToDualQuaternion(const Affine3x4 &a, DualQuaternion &out) {
+    glm::quat q = affineRotation(a);
+    float tx = a.rows[0][3], ty = a.rows[1][3], tz = a.rows[2][3];
+    
+    out.real[0] = q.x;
+    out.real[1] = q.y;
+    out.real[2] = q.z;
+    out.real[3] = q.w;
+    
+    // dual = (0, t) * real / 2
+    out.dual[0] = 0.5f * (tx * q.w + ty * q.z - tz * q.y);
+    out.dual[1] = 0.5f * (ty * q.w + tz * q.x - tx * q.z);
+    out.dual[2] = 0.5f * (tz * q.w + tx * q.y - ty * q.x);
+    out.dual[3] = -0.5f * (tx * q.x + ty * q.y + tz * q.z);
+}
+
+void gcore::dualQuaternionToAffine(const DualQuaternion &dq, Affine3x4 &out) {
+    const float *r = dq.real, *d = dq.dual;
+    
+    // t = 2 * dual * conjugate(real)
+    float tx = 2.0f * (r[3] * d[0] - d[3] * r[0] + r[1] * d[2] - r[2] * d[1]);
+    float ty = 2.0f * (r[3] * d[1] - d[3] * r[1] + r[2] * d[0] - r[0] * d[2]);
+    float tz = 2.0f * (r[3] * d[2] - d[3] * r[2] + r[0] * d[1] - r[1] * d[0]);
+    
+    composeTRS(glm::vec3(tx, ty, tz), glm::quat(r[3], r[0], r[1], r[2]), glm::vec3(1.0f), out);
+}
@@ -0,0 +1,97 @@
+//
+// => gcore/util/arena.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <gcore/util/arena.h>
+
+#include <algorithm>
+#include <cstdlib>
+
+using namespace gcore;
+
+Arena::Arena(size_t initialSize, size_t growSize) : growSize(growSize) {
+    if (initialSize) {
+        addBlock(initialSize);
+    }
+}
+
+Arena::Arena(Arena &&other) : head(other.head), cursor(other.cursor), end(other.end), capacity(other.capacity), used(other.used), growSize(other.growSize) {
+    other.head = nullptr;
+    other.cursor = other.end = nullptr;
+    other.capacity = other.used = 0;
+}
+
+Arena &Arena::operator=(Arena &&other) {
+    if (this != &other) {
+        release();
+        std::swap(head, other.head);
+        std::swap(cursor, other.cursor);
+        std::swap(end, other.end);
+        std::swap(capacity, other.capacity);
+        std::swap(used, other.used);
+        growSize = other.growSize;
+    }
+    return *this;
+}
+
+void Arena::addBlock(size_t size) {
+    // The header is padded so that the memory of the block starts at the maximum alignment.
+    const size_t headerSize = (sizeof(Block) + alignof(std::max_align_t) - 1) & ~(alignof(std::max_align_t) - 1);
+    
+    Block *block = (Block *)malloc(headerSize + size);
+    if (!block) {
+        throw std::bad_alloc();
+    }
+    block->next = head;
+    block->size = size;
+    head = block;
+    
+    cursor = (uint8_t *)block + headerSize;
+    end = cursor + size;
+    capacity += size;
+}
+
+void *Arena::allocate(size_t size, size_t alignment) {
+    uintptr_t address = ((uintptr_t)cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    
+    if (!cursor || address + size > (uintptr_t)end) {
+        addBlock(std::max(size + alignment, growSize));
+        address = ((uintptr_t)cursor + alignment - 1) & ~(uintptr_t)(alignment - 1);
+    }
+    
+    used += (address + size) - (uintptr_t)cursor;
+    cursor = (uint8_t *)(address + size);
+    return (void *)address;
+}
+
+void Arena::release() {
+    while (head) {
+        Block *next = head->next;
+        free(head);
+        head = next;
+    }
+    cursor = end = nullptr;
+    capacity = used = 0;
+}
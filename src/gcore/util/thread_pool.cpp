@@ -0,0 +1,133 @@
+//
+// => gcore/util/thread_pool.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+#include <gcore/util/thread_pool.h>
+
+#include <algorithm>
+#include <atomic>
+#include <memory>
+
+using namespace gcore;
+
+ThreadPool::ThreadPool(unsigned threadCount) {
+    if (threadCount == 0) {
+        unsigned hardwareThreads = std::thread::hardware_concurrency();
+        threadCount = hardwareThreads > 1 ? hardwareThreads - 1 : 1;
+    }
+    
+    for (unsigned i = 0; i < threadCount; i++) {
+        workers.emplace_back(&ThreadPool::work, this);
+    }
+}
+
+ThreadPool::~ThreadPool() {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = true;
+    }
+    taskAvailable.notify_all();
+    
+    for (std::thread &worker : workers) {
+        worker.join();
+    }
+}
+
+void ThreadPool::work() {
+    while (true) {
+        std::function<void()> task;
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            taskAvailable.wait(lock, [this] { return stopping || !tasks.empty(); });
+            
+            if (tasks.empty()) {
+                return; // stopping and nothing left to run
+            }
+            task = std::move(tasks.front());
+            tasks.pop_front();
+        }
+        task();
+    }
+}
+
+void ThreadPool::submit(std::function<void()> task) {
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        tasks.push_back(std::move(task));
+    }
+    taskAvailable.notify_one();
+}
+
+/*!
+ \brief The progress of a \c ThreadPool::parallelFor() call, shared by all the threads taking part in it.
+ */
+struct ParallelForState {
+    std::atomic<size_t> next { 0 };
+    size_t count;
+    size_t completed = 0;
+    
+    std::mutex mutex;
+    std::condition_variable allCompleted;
+    
+    explicit ParallelForState(size_t count) : count(count) {  }
+    
+    /*!
+     \brief Runs the indices left until there are none.
+     */
+    void run(const std::function<void(size_t)> &body) {
+        size_t done = 0;
+        for (size_t i; (i = next.fetch_add(1)) < count; done++) {
+            body(i);
+        }
+        
+        if (done > 0) {
+            std::lock_guard<std::mutex> lock(mutex);
+            if ((completed += done) == count) {
+                allCompleted.notify_all();
+            }
+        }
+    }
+};
+
+void ThreadPool::parallelFor(size_t count, const std::function<void(size_t)> &body) {
+    if (count == 0) {
+        return;
+    }
+    
+    std::shared_ptr<ParallelForState> state = std::make_shared<ParallelForState>(count);
+    
+    // Helpers that start late find no index left and return at once, so they never call body after this call returned.
+    size_t helpers = std::min(count - 1, workers.size());
+    for (size_t i = 0; i < helpers; i++) {
+        submit([state, &body] {
+            state->run(body);
+        });
+    }
+    
+    state->run(body);
+    
+    std::unique_lock<std::mutex> lock(state->mutex);
+    state->allCompleted.wait(lock, [&state] { return state->completed == state->count; });
+}
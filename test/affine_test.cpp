@@ -0,0 +1,206 @@
+//
+// => test/affine_test.cpp
+//
+//                                 GraphCore
+//
+// Copyright (c) 2018 Lorenzo Laneve
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+//
+
+// Checks the affine kernels against the glm mat4 path on random TRS transforms.
+
+#include <gcore/math/affine.h>
+#include <gcore/math/simd_lanes.h>
+
+#include <glm/gtc/matrix_transform.hpp>
+
+#include <cmath>
+#include <cstdio>
+#include <random>
+#include <vector>
+
+using namespace gcore;
+
+namespace {
+    
+    struct TRS {
+        glm::vec3 translation;
+        glm::quat rotation;
+        glm::vec3 scale;
+    };
+    
+    /*!
+     \brief The number of transforms of the batches, which leaves a partial group of lanes at the end for every lane count above 1.
+     */
+    constexpr uint32_t BatchCount = 4 * GCORE_LANE_COUNT + (GCORE_LANE_COUNT > 1 ? GCORE_LANE_COUNT - 1 : 0);
+    
+    constexpr float Tolerance = 1e-5f;
+    
+    std::mt19937 rng(2018);
+    int failures = 0;
+    
+    float randomFloat(float min, float max) {
+        return std::uniform_real_distribution<float>(min, max)(rng);
+    }
+    
+    TRS randomTRS() {
+        TRS trs;
+        trs.translation = glm::vec3(randomFloat(-10.0f, 10.0f), randomFloat(-10.0f, 10.0f), randomFloat(-10.0f, 10.0f));
+        trs.rotation = glm::normalize(glm::quat(randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f), randomFloat(-1.0f, 1.0f)));
+        trs.scale = glm::vec3(randomFloat(0.5f, 2.0f), randomFloat(0.5f, 2.0f), randomFloat(0.5f, 2.0f));
+        return trs;
+    }
+    
+    glm::mat4 referenceMatrix(const TRS &trs) {
+        return glm::translate(glm::mat4(1.0f), trs.translation) * glm::mat4_cast(trs.rotation) * glm::scale(glm::mat4(1.0f), trs.scale);
+    }
+    
+    /*!
+     \brief Reports the first coefficient of \c actual that differs from \c expected by more than the tolerance, relative to its magnitude.
+     */
+    bool check(const char *kernel, uint32_t index, const glm::mat4 &actual, const glm::mat4 &expected) {
+        for (int c = 0; c < 4; c++) {
+            for (int r = 0; r < 4; r++) {
+                if (std::fabs(actual[c][r] - expected[c][r]) > Tolerance * (1.0f + std::fabs(expected[c][r]))) {
+                    std::printf("%s: transform %u differs at [%d][%d]: %f, expected %f\n", kernel, index, c, r, actual[c][r], expected[c][r]);
+                    failures++;
+                    return false;
+                }
+            }
+        }
+        return true;
+    }
+    
+    void testComposeTRS() {
+        for (uint32_t i = 0; i < 1000; i++) {
+            TRS trs = randomTRS();
+            Affine3x4 a;
+            composeTRS(trs.translation, trs.rotation, trs.scale, a);
+            if (!check("composeTRS", i, affineToMat4(a), referenceMatrix(trs))) {
+                return;
+            }
+        }
+    }
+    
+    void testMultiplyAffine() {
+        for (uint32_t i = 0; i < 1000; i++) {
+            glm::mat4 ma = referenceMatrix(randomTRS()), mb = referenceMatrix(randomTRS());
+            Affine3x4 a, b, product;
+            affineFromMat4(ma, a);
+            affineFromMat4(mb, b);
+            
+            multiplyAffine(a, b, product);
+            if (!check("multiplyAffine", i, affineToMat4(product), ma * mb)) {
+                return;
+            }
+            
+            // The output may be either operand.
+            multiplyAffine(a, b, a);
+            if (!check("multiplyAffine in place", i, affineToMat4(a), ma * mb)) {
+                return;
+            }
+        }
+    }
+    
+    void testComposeTRSBatch() {
+        uint32_t stride = (BatchCount + GCORE_LANE_COUNT - 1) / GCORE_LANE_COUNT * GCORE_LANE_COUNT;
+        std::vector<float> components(stride * 10, 0.0f);
+        std::vector<float> weights(stride, 0.0f);
+        std::vector<TRS> transforms(BatchCount);
+        
+        for (uint32_t i = 0; i < BatchCount; i++) {
+            TRS &trs = transforms[i];
+            trs = randomTRS();
+            const float values[10] = {
+                trs.translation.x, trs.translation.y, trs.translation.z,
+                trs.rotation.x, trs.rotation.y, trs.rotation.z, trs.rotation.w,
+                trs.scale.x, trs.scale.y, trs.scale.z
+            };
+            for (int k = 0; k < 10; k++) {
+                components[k * stride + i] = values[k];
+            }
+            weights[i] = i % 3 ? 1.0f : 0.0f;
+        }
+        
+        std::vector<Affine3x4> out(BatchCount);
+        composeTRSBatch(components.data(), stride, nullptr, BatchCount, out.data());
+        for (uint32_t i = 0; i < BatchCount; i++) {
+            if (!check("composeTRSBatch", i, affineToMat4(out[i]), referenceMatrix(transforms[i]))) {
+                return;
+            }
+        }
+        
+        // The nodes without weight must be left untouched.
+        const glm::mat4 untouched = glm::scale(glm::mat4(1.0f), glm::vec3(3.0f, 3.0f, 3.0f));
+        for (Affine3x4 &a : out) {
+            affineFromMat4(untouched, a);
+        }
+        composeTRSBatch(components.data(), stride, weights.data(), BatchCount, out.data());
+        for (uint32_t i = 0; i < BatchCount; i++) {
+            if (!check("composeTRSBatch with weights", i, affineToMat4(out[i]), weights[i] > 0.0f ? referenceMatrix(transforms[i]) : untouched)) {
+                return;
+            }
+        }
+    }
+    
+    void testMultiplyAffineBatch() {
+        std::vector<glm::mat4> ma(BatchCount), mb(BatchCount);
+        std::vector<Affine3x4> a(BatchCount), b(BatchCount);
+        for (uint32_t i = 0; i < BatchCount; i++) {
+            ma[i] = referenceMatrix(randomTRS());
+            mb[i] = referenceMatrix(randomTRS());
+            affineFromMat4(ma[i], a[i]);
+            affineFromMat4(mb[i], b[i]);
+        }
+        
+        std::vector<glm::mat4> matrices(BatchCount);
+        multiplyAffineBatch(a.data(), b.data(), BatchCount, matrices.data());
+        for (uint32_t i = 0; i < BatchCount; i++) {
+            if (!check("multiplyAffineBatch to mat4", i, matrices[i], ma[i] * mb[i])) {
+                break;
+            }
+        }
+        
+        std::vector<Affine3x4> affines(BatchCount);
+        multiplyAffineBatch(a.data(), b.data(), BatchCount, affines.data());
+        for (uint32_t i = 0; i < BatchCount; i++) {
+            if (!check("multiplyAffineBatch to Affine3x4", i, affineToMat4(affines[i]), ma[i] * mb[i])) {
+                break;
+            }
+        }
+    }
+    
+}
+
+int main() {
+    std::printf("Testing affine kernels with %d lanes, %u transforms per batch.\n", GCORE_LANE_COUNT, BatchCount);
+    
+    testComposeTRS();
+    testMultiplyAffine();
+    testComposeTRSBatch();
+    testMultiplyAffineBatch();
+    
+    if (failures) {
+        std::printf("%d kernels failed.\n", failures);
+        return 1;
+    }
+    std::printf("All kernels match.\n");
+    return 0;
+}